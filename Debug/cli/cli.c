@@ -318,7 +318,14 @@ void CLI_commandLookup()
 			{
 				// Run the specified command function pointer
 				//   argPtr is already pointing at the first character of the arguments
+				// Command output (e.g. help) may not fit into the print buffer, but should not be dropped
+#if defined(PrintBuffered)
+				printFlushOnFull = 1;
+#endif
 				(*(void (*)(char*))CLIDict[dict][cmd].function)( argPtr );
+#if defined(PrintBuffered)
+				printFlushOnFull = 0;
+#endif
 
 				return;
 			}
@@ -556,7 +563,7 @@ void cliFunc_version( char* args )
 	print( " \033[1mCPU:\033[0m           " CLI_CPU            NL );
 	print( " \033[1mDevice:\033[0m        " CLI_Device         NL );
 	print( " \033[1mModules:\033[0m       " CLI_Modules        NL );
-#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_)
 	print( " \033[1mUnique Id:\033[0m     " );
 	printHex32_op( SIM_UIDH, 8 );
 	printHex32_op( SIM_UIDMH, 8 );
@@ -22,5 +22,6 @@ set ( Module_SRCS
 set ( ModuleCompatibility
 	arm
 	avr
+	host
 )
 
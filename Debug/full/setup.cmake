@@ -13,7 +13,9 @@
 
 AddModule ( Debug cli )
 AddModule ( Debug led )
+AddModule ( Debug perf )
 AddModule ( Debug print )
+AddModule ( Debug trace )
 
 
 ###
@@ -22,5 +24,6 @@ AddModule ( Debug print )
 set ( ModuleCompatibility
 	arm
 	avr
+	host
 )
 
@@ -67,8 +67,8 @@ inline void init_errorLED()
 	// Setup pin - A19 - See Lib/pin_map.mchck for more details on pins
 	PORTA_PCR19 = PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(1);
 
-// Kiibohd-dfu
-#elif defined(_mk20dx256vlh7_)
+// Kiibohd-dfu / Host (simulated A5)
+#elif defined(_mk20dx256vlh7_) || defined(_host_)
 	// Kiibohd-dfu
 	// Enable pin
 	GPIOA_PDDR |= (1<<5);
@@ -128,8 +128,8 @@ inline void errorLED( uint8_t on )
 		GPIOA_PCOR |= (1<<19);
 	}
 
-// Kiibohd-dfu
-#elif defined(_mk20dx256vlh7_)
+// Kiibohd-dfu / Host (simulated A5)
+#elif defined(_mk20dx256vlh7_) || defined(_host_)
 	// Kiibohd-dfu
 	// Error LED On (A5)
 	if ( on ) {
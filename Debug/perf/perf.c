@@ -0,0 +1,178 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <string.h>
+
+// Project Includes
+#include <cli.h>
+#include <print.h>
+
+// Local Includes
+#include "perf.h"
+
+
+
+// ----- Function Declarations -----
+
+void cliFunc_perf( char* args );
+
+
+
+// ----- Variables -----
+
+// Perf Module command dictionary
+CLIDict_Entry( perf, "Shows count, min/avg/max cycles of each profiled section." NL "\t\tIf argument \033[35mr\033[0m is given, resets the counters." );
+
+CLIDict_Def( perfCLIDict, "Performance Counter Commands" ) = {
+	CLIDict_Item( perf ),
+	{ 0, 0, 0 } // Null entry for dictionary end
+};
+
+// Registered counter groups
+PerfGroup Perf_groups[ PerfMaxGroups ];
+uint8_t   Perf_groupsUsed = 0;
+
+
+
+// ----- Functions -----
+
+// Must be called before any module registers a group
+void Perf_setup()
+{
+	// Register Perf CLI dictionary
+	CLI_registerDictionary( perfCLIDict, perfCLIDictName );
+
+	Perf_groupsUsed = 0;
+
+#if defined(Perf_Enabled) && !defined(_host_)
+	// Start the DWT cycle counter
+	ARM_DEMCR    |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+
+// Adds a measurement to a counter
+void Perf_add( PerfCounter *counter, uint32_t cycles )
+{
+	if ( counter->count == 0 || cycles < counter->min )
+		counter->min = cycles;
+	if ( cycles > counter->max )
+		counter->max = cycles;
+
+	counter->count++;
+	counter->total += cycles;
+}
+
+
+// Adds a group of counters to the perf command
+// The counters are reset
+void Perf_registerGroup( const char *name, const char *const *labels, PerfCounter *counters, uint16_t num )
+{
+	// Make sure this group can be added
+	if ( Perf_groupsUsed >= PerfMaxGroups )
+	{
+		erro_print("Max number of perf groups reached...");
+		return;
+	}
+
+	PerfGroup *group = &Perf_groups[ Perf_groupsUsed++ ];
+	group->name     = name;
+	group->labels   = labels;
+	group->counters = counters;
+	group->num      = num;
+
+	memset( counters, 0, sizeof( PerfCounter ) * num );
+}
+
+
+// Resets the counters of every group
+void Perf_reset()
+{
+	for ( uint8_t g = 0; g < Perf_groupsUsed; g++ )
+		memset( Perf_groups[ g ].counters, 0, sizeof( PerfCounter ) * Perf_groups[ g ].num );
+}
+
+
+
+// ----- CLI Command Functions -----
+
+void cliFunc_perf( char* args )
+{
+	// Parse argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Reset counters
+	if ( *arg1Ptr == 'r' )
+	{
+		Perf_reset();
+		return;
+	}
+
+#if !defined(Perf_Enabled)
+	print( NL );
+	warn_print("No cycle counter on this target");
+#endif
+
+	// Each group, only counters that have been used are shown
+	for ( uint8_t g = 0; g < Perf_groupsUsed; g++ )
+	{
+		PerfGroup *group = &Perf_groups[ g ];
+
+		print( NL );
+		info_msg("");
+		_print( group->name );
+		print(" - count min/avg/max (cycles)");
+
+		for ( uint16_t c = 0; c < group->num; c++ )
+		{
+			PerfCounter *counter = &group->counters[ c ];
+			if ( counter->count == 0 )
+				continue;
+
+			print( NL "\t" );
+			if ( group->labels )
+			{
+				_print( group->labels[ c ] );
+			}
+			else
+			{
+				print("0x");
+				printHex_op( c, 2 );
+			}
+			print("\t");
+			printInt32( counter->count );
+			print(" ");
+			printInt32( counter->min );
+			print("/");
+			printInt32( (uint32_t)( counter->total / counter->count ) );
+			print("/");
+			printInt32( counter->max );
+		}
+	}
+}
+
@@ -0,0 +1,112 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Cycle counting profiler
+// Modules register groups of counters, which are shown by the perf command.
+// ARM builds count with the DWT cycle counter, host builds scale the host clock to F_CPU.
+// AVR builds have no cycle counter, Perf_start/Perf_stop/Perf_lap compile to nothing.
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/MainLib.h>
+
+
+
+// ----- Defines -----
+
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_)
+#define Perf_Enabled
+#endif
+
+// Maximum number of registered counter groups
+#define PerfMaxGroups 8
+
+
+
+// ----- Macros -----
+
+#if defined(Perf_Enabled)
+// Starts timing a section, var holds the start cycle count
+#define Perf_start( var ) \
+	uint32_t var = Perf_cycles()
+
+// Adds the cycles since Perf_start to counter
+#define Perf_stop( counter, var ) \
+	Perf_add( counter, Perf_cycles() - var )
+
+// Adds the cycles since Perf_start (or the previous lap) to counter, then starts timing the next section
+#define Perf_lap( counter, var ) \
+	do { \
+		uint32_t perf_now = Perf_cycles(); \
+		Perf_add( counter, perf_now - var ); \
+		var = perf_now; \
+	} while ( 0 )
+#else
+#define Perf_start( var )
+#define Perf_stop( counter, var )
+#define Perf_lap( counter, var )
+#endif
+
+
+
+// ----- Structs -----
+
+// Cycle statistics of a profiled section
+typedef struct PerfCounter {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+} PerfCounter;
+
+// Counters shown together by the perf command
+// labels may be 0, counters are then shown by index
+typedef struct PerfGroup {
+	const char        *name;
+	const char *const *labels;
+	PerfCounter       *counters;
+	uint16_t           num;
+} PerfGroup;
+
+
+
+// ----- Functions -----
+
+#if defined(Perf_Enabled)
+static inline uint32_t Perf_cycles() __attribute__((always_inline, unused));
+static inline uint32_t Perf_cycles()
+{
+#if defined(_host_)
+	return Host_cycles();
+#else
+	return ARM_DWT_CYCCNT;
+#endif
+}
+#endif
+
+void Perf_setup();
+void Perf_add( PerfCounter *counter, uint32_t cycles );
+void Perf_registerGroup( const char *name, const char *const *labels, PerfCounter *counters, uint16_t num );
+void Perf_reset();
+
@@ -0,0 +1,27 @@
+###| CMake Kiibohd Controller Debug Module |###
+#
+# Written by agent in 2026 for the Kiibohd Controller
+#
+# Released into the Public Domain
+#
+###
+
+
+###
+# Module C files
+#
+
+set ( Module_SRCS
+	perf.c
+)
+
+
+###
+# Compiler Family Compatibility
+#
+set ( ModuleCompatibility
+	arm
+	avr
+	host
+)
+
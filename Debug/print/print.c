@@ -25,12 +25,157 @@
 #include <stdarg.h>
 
 // Project Includes
+#include <Lib/MainLib.h>
 #include "print.h"
 
 
 
+// ----- Defines -----
+
+#if defined(PrintBuffered)
+// Must be a power of two
+#define PrintBufferSize 1024
+
+// Bytes handed to the Output Module at once (one USB serial packet) and per printFlush call
+#define PrintFlushChunk 64
+#define PrintFlushMax   128
+#endif
+
+
+
+// ----- Variables -----
+
+#if defined(PrintBuffered)
+// Output waiting for printFlush
+// Only the main loop appends (head) and drains (tail), interrupt handlers bypass the buffer
+static char printBuffer[ PrintBufferSize ];
+static uint16_t printBufferHead = 0;
+static uint16_t printBufferTail = 0;
+
+// Bytes dropped because the buffer was full
+uint32_t printBufferOverflow = 0;
+static uint32_t printBufferOverflowShown = 0;
+
+// If set, a full buffer is drained (waiting on the Output Module) instead of dropping output
+uint8_t printFlushOnFull = 0;
+#endif
+
+
+
 // ----- Functions -----
 
+#if defined(PrintBuffered)
+// Non-zero when called from an interrupt handler
+static inline uint8_t printInInterrupt()
+{
+#if defined(_host_)
+	return Host_isrActive;
+#else
+	uint32_t ipsr;
+	asm volatile( "mrs %0, ipsr" : "=r" (ipsr) );
+	return ipsr != 0;
+#endif
+}
+
+
+// Hands up to max bytes to the Output Module, in chunks of one USB serial packet
+static void printBufferDrain( uint16_t max )
+{
+	char chunk[ PrintFlushChunk + 1 ];
+	uint16_t sent = 0;
+
+	while ( printBufferTail != printBufferHead && sent < max )
+	{
+		uint16_t tail = printBufferTail;
+		uint8_t len = 0;
+		while ( tail != printBufferHead && len < PrintFlushChunk )
+		{
+			chunk[ len++ ] = printBuffer[ tail ];
+			tail = ( tail + 1 ) & ( PrintBufferSize - 1 );
+		}
+		chunk[ len ] = '\0';
+
+		// Release the space before the (possibly slow) write
+		printBufferTail = tail;
+		Output_putstr( chunk );
+		sent += len;
+	}
+}
+
+
+// Appends a string, the part that does not fit is dropped (unless printFlushOnFull is set)
+static void printBufferAppend( const char *s )
+{
+	uint16_t head = printBufferHead;
+	uint16_t free = ( printBufferTail - head - 1 ) & ( PrintBufferSize - 1 );
+
+	for ( ; *s != '\0'; s++ )
+	{
+		if ( free == 0 && printFlushOnFull )
+		{
+			printBufferHead = head;
+			printBufferDrain( PrintBufferSize );
+			free = PrintBufferSize - 1;
+		}
+
+		if ( free == 0 )
+		{
+			while ( *s++ != '\0' )
+				printBufferOverflow++;
+			break;
+		}
+
+		printBuffer[ head ] = *s;
+		head = ( head + 1 ) & ( PrintBufferSize - 1 );
+		free--;
+	}
+
+	printBufferHead = head;
+}
+#endif
+
+
+// Print a string from RAM
+// Buffered on ARM, see printFlush
+void _printStr( const char* s )
+{
+#if defined(PrintBuffered)
+	// Interrupt handlers may preempt an append, their output goes straight out (ahead of anything buffered)
+	if ( printInInterrupt() )
+	{
+		Output_putstr( (char*)s );
+		return;
+	}
+
+	printBufferAppend( s );
+#else
+	Output_putstr( (char*)s );
+#endif
+}
+
+
+// Hands buffered output to the Output Module, called from the main loop
+// At most PrintFlushMax bytes are sent per call, so large dumps do not stall the loop
+void printFlush()
+{
+#if defined(PrintBuffered)
+	printBufferDrain( PrintFlushMax );
+
+	// Show how much was lost, once the buffer has drained
+	if ( printBufferTail == printBufferHead && printBufferOverflow != printBufferOverflowShown )
+	{
+		char count[11];
+		int32ToStr( printBufferOverflow - printBufferOverflowShown, count );
+		printBufferOverflowShown = printBufferOverflow;
+
+		Output_putstr( NL "\033[1;33mWARNING\033[0m - Print buffer overflow, bytes dropped: " );
+		Output_putstr( count );
+		Output_putstr( NL );
+	}
+#endif
+}
+
+
 // Multiple string Output
 void printstrs( char* first, ... )
 {
@@ -45,7 +190,7 @@ void printstrs( char* first, ... )
 	while ( !( cur[0] == '\0' && cur[1] == '\0' && cur[2] == '\0' ) )
 	{
 		// Print out the given string
-		Output_putstr( cur );
+		_printStr( cur );
 
 		// Get the next argument ready
 		cur = va_arg( ap, char* );
@@ -64,8 +209,8 @@ void _print( const char* s )
 	{
 		Output_putchar( c );
 	}
-#elif defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) // ARM
-	Output_putstr( (char*)s );
+#elif defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_) // ARM
+	_printStr( s );
 #endif
 }
 
@@ -36,6 +36,11 @@
 // ----- Defines -----
 #define NL "\r\n"
 
+// ARM output is buffered, see printFlush
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_)
+#define PrintBuffered
+#endif
+
 
 
 // ----- Functions and Corresponding Function Aliases -----
@@ -45,8 +50,8 @@
  */
 
 // Function Aliases
-#define dPrint(c)         Output_putstr(c)
-#define dPrintStr(c)      Output_putstr(c)
+#define dPrint(c)         _printStr(c)
+#define dPrintStr(c)      _printStr(c)
 #define dPrintStrs(...)   printstrs(__VA_ARGS__, "\0\0\0")      // Convenience Variadic Macro
 #define dPrintStrNL(c)    dPrintStrs       (c, NL)              // Appends New Line Macro
 #define dPrintStrsNL(...) printstrs(__VA_ARGS__, NL, "\0\0\0")  // Appends New Line Macro
@@ -88,8 +93,16 @@
 #endif
 
 void _print( const char *s );
+void _printStr( const char *s );
 void printstrs( char* first, ... );
 
+void printFlush();
+
+#if defined(PrintBuffered)
+extern uint32_t printBufferOverflow; // Bytes dropped because the print buffer was full
+extern uint8_t  printFlushOnFull;    // Set to wait for the Output Module instead of dropping output
+#endif
+
 
 // Printing numbers
 #define printHex(hex)   printHex_op(hex, 1)
@@ -0,0 +1,130 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/MainLib.h>
+
+// Project Includes
+#include <cli.h>
+#include <print.h>
+
+// Local Includes
+#include "trace.h"
+
+
+
+// ----- Function Declarations -----
+
+void cliFunc_trace    ( char* args );
+void cliFunc_traceMode( char* args );
+
+
+
+// ----- Variables -----
+
+// Trace Module command dictionary
+CLIDict_Entry( trace,     "Dumps the binary trace log, decode it with TraceDecode." NL "\t\tIf argument \033[35mr\033[0m is given, clears the log." );
+CLIDict_Entry( traceMode, "Toggles tracing of hot path diagnostics, instead of printing them." );
+
+CLIDict_Def( traceCLIDict, "Trace Module Commands" ) = {
+	CLIDict_Item( trace ),
+	CLIDict_Item( traceMode ),
+	{ 0, 0, 0 } // Null entry for dictionary end
+};
+
+#if defined(Trace_Enabled)
+uint8_t     traceMode = 0;
+uint32_t    Trace_head = 0;
+TraceRecord Trace_buffer[ TraceBufferSize ];
+#endif
+
+
+
+// ----- Functions -----
+
+void Trace_setup()
+{
+	// Register Trace CLI dictionary
+	CLI_registerDictionary( traceCLIDict, traceCLIDictName );
+}
+
+
+
+// ----- CLI Command Functions -----
+
+void cliFunc_trace( char* args )
+{
+	// Parse argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+#if defined(Trace_Enabled)
+	// Clear log
+	if ( *arg1Ptr == 'r' )
+	{
+		Trace_head = 0;
+		return;
+	}
+
+	// Only the newest TraceBufferSize events are still in the buffer
+	uint32_t first = Trace_head > TraceBufferSize ? Trace_head - TraceBufferSize : 0;
+
+	print( NL );
+	info_msg("Trace events: ");
+	printInt32( Trace_head - first );
+	print(" overwritten: ");
+	printInt32( first );
+
+	// One record per line, @<time:8><id:2><arg0:2><arg1:4>
+	for ( uint32_t event = first; event < Trace_head; event++ )
+	{
+		TraceRecord *record = &Trace_buffer[ event & ( TraceBufferSize - 1 ) ];
+
+		print( NL "@" );
+		printHex32_op( record->time, 8 );
+		printHex_op( record->id, 2 );
+		printHex_op( record->arg0, 2 );
+		printHex_op( record->arg1, 4 );
+	}
+#else
+	print( NL );
+	warn_print("No trace buffer on this target");
+#endif
+}
+
+void cliFunc_traceMode( char* args )
+{
+#if defined(Trace_Enabled)
+	traceMode = !traceMode;
+
+	print( NL );
+	info_msg("Trace Mode: ");
+	printInt8( traceMode );
+#else
+	print( NL );
+	warn_print("No trace buffer on this target");
+#endif
+}
+
@@ -0,0 +1,105 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Binary trace log
+// Hot path diagnostics store an event id and raw arguments into a ring buffer instead of formatting text.
+// The trace command dumps the buffer as hex records, which TraceDecode turns back into messages.
+// Only the main loop may add events, interrupt handlers would need the buffer locked.
+// AVR builds have no trace buffer, Trace_on() is always 0 and sites keep printing.
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/MainLib.h>
+
+// Project Includes
+#include <Lib/delay.h>
+
+
+
+// ----- Defines -----
+
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_)
+#define Trace_Enabled
+#endif
+
+// Number of records kept, the oldest are overwritten, must be a power of two
+#define TraceBufferSize 128
+
+
+
+// ----- Enumerations -----
+
+typedef enum TraceEventId {
+#define TraceEvent( name, message ) TraceEvent_##name,
+#include "trace_events.h"
+#undef TraceEvent
+	TraceEvent_Num,
+} TraceEventId;
+
+
+
+// ----- Structs -----
+
+// One event, 8 bytes
+typedef struct TraceRecord {
+	uint32_t time; // systick_millis_count
+	uint8_t  id;   // TraceEventId
+	uint8_t  arg0;
+	uint16_t arg1;
+} TraceRecord;
+
+
+
+// ----- Variables -----
+
+#if defined(Trace_Enabled)
+extern uint8_t     traceMode;
+extern uint32_t    Trace_head; // Total number of events added
+extern TraceRecord Trace_buffer[ TraceBufferSize ];
+#endif
+
+
+
+// ----- Functions -----
+
+#if defined(Trace_Enabled)
+// Non-zero if hot path diagnostics should be traced instead of printed
+#define Trace_on() ( traceMode )
+
+// Adds an event, a macro so it can be used in (non-static) inline functions
+#define Trace_event( eventId, eventArg0, eventArg1 ) \
+	do { \
+		TraceRecord *trace_record = &Trace_buffer[ Trace_head++ & ( TraceBufferSize - 1 ) ]; \
+		trace_record->time = systick_millis_count; \
+		trace_record->id   = eventId; \
+		trace_record->arg0 = eventArg0; \
+		trace_record->arg1 = eventArg1; \
+	} while ( 0 )
+#else
+#define Trace_on() ( 0 )
+#define Trace_event( id, arg0, arg1 )
+#endif
+
+void Trace_setup();
+
@@ -0,0 +1,31 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Binary trace event table
+// Shared by the firmware (event ids) and TraceDecode (messages), add new events at the end to keep old logs decodable.
+// TraceEvent( name, message ) - message is a printf format given arg0 and arg1 (as unsigned int)
+
+TraceEvent( MacroNoTrigger,      "Scan Code has no defined Trigger Macro: 0x%02X" )
+TraceEvent( MacroScanCodeKey,    "ScanCode is out of range/not defined: 0x%02X state 0x%02X" )
+TraceEvent( MacroScanCodeAnalog, "ScanCode is out of range/not defined: 0x%02X analog 0x%02X" )
+TraceEvent( MatrixPress,         "Matrix press 0x%02X" )
+TraceEvent( MatrixState,         "Matrix 0x%02X state %u (1 Press, 2 Hold, 3 Release, 4 Invalid)" )
+
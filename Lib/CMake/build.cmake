@@ -106,12 +106,15 @@ add_custom_command( TARGET ${TARGET_ELF} POST_BUILD
 #
 
 #| After Changes Size Information
-add_custom_target( SizeAfter ALL
-	COMMAND ${CMAKE_SOURCE_DIR}/Lib/CMake/sizeCalculator ${CMAKE_SIZE} ram   ${TARGET_ELF} ${SIZE_RAM}   " SRAM"
-	COMMAND ${CMAKE_SOURCE_DIR}/Lib/CMake/sizeCalculator ${CMAKE_SIZE} flash ${TARGET_ELF} ${SIZE_FLASH} "Flash"
-	DEPENDS ${TARGET_ELF}
-	COMMENT "Chip usage for ${CHIP}"
-)
+#| Host builds have no flash/ram budget to check against
+if ( NOT "${COMPILER_FAMILY}" MATCHES "host" )
+	add_custom_target( SizeAfter ALL
+		COMMAND ${CMAKE_SOURCE_DIR}/Lib/CMake/sizeCalculator ${CMAKE_SIZE} ram   ${TARGET_ELF} ${SIZE_RAM}   " SRAM"
+		COMMAND ${CMAKE_SOURCE_DIR}/Lib/CMake/sizeCalculator ${CMAKE_SIZE} flash ${TARGET_ELF} ${SIZE_FLASH} "Flash"
+		DEPENDS ${TARGET_ELF}
+		COMMENT "Chip usage for ${CHIP}"
+	)
+endif ()
 
 
 
@@ -0,0 +1,121 @@
+###| CMAKE Kiibohd Controller |###
+#
+# Written by agent in 2026 for the Kiibohd Controller
+#
+# Released into the Public Domain
+#
+# Native Host CMake Build Configuration
+#  Builds the firmware as a regular process, mk20dx peripherals are simulated (see Lib/host.c)
+#
+###
+
+
+###
+# Compiler Check
+#
+
+message( STATUS "Compiler Selected:" )
+if ( "${COMPILER}" MATCHES "gcc" )
+	set( CMAKE_C_COMPILER gcc )
+	set( _CMAKE_TOOLCHAIN_PREFIX "" )
+	message( "gcc" )
+elseif ( "${COMPILER}" MATCHES "clang" )
+	set( CMAKE_C_COMPILER clang )
+	set( _CMAKE_TOOLCHAIN_PREFIX "" )
+	message( "clang" )
+else ()
+	message( AUTHOR_WARNING "COMPILER: ${COMPILER} - Unknown compiler selection" )
+endif ()
+
+
+
+###
+# Host Defines and Linker Options
+#
+
+message( STATUS "Chip Selected:" )
+message( "${CHIP}" )
+set( MCU "${CHIP}" ) # For loading script compatibility
+
+
+#| Chip Size and CPU Frequency Database
+#| Host builds emulate a 72 MHz mk20dx256vlh7, size limits are informational only
+set( SIZE_RAM    65536 )
+set( SIZE_FLASH 253952 )
+set( F_CPU "72000000" )
+
+
+#| Chip Base Type
+set( CHIP_FAMILY "host" )
+message( STATUS "Chip Family:" )
+message( "${CHIP_FAMILY}" )
+
+
+#| CPU Type
+set( CPU "host" )
+
+message( STATUS "CPU Selected:" )
+message( "${CPU}" )
+
+
+#| Extra Compiler Sources
+#| Simulated peripherals, systick and interrupt masking
+set( COMPILER_SRCS
+	Lib/${CHIP_FAMILY}.c
+	Lib/delay.c
+)
+
+message( STATUS "Compiler Source Files:" )
+message( "${COMPILER_SRCS}" )
+
+
+#| USB Defines
+#| Host builds have no bootloader, only used for the USB descriptors
+set( VENDOR_ID       "0x1C11" )
+set( PRODUCT_ID      "0xB04D" )
+
+
+#| Compiler flag to set the C Standard level.
+set( CSTANDARD "-std=gnu11" )
+
+
+#| Warning Options
+#|  -Wall...:     warning level
+set( WARN "-Wall -ggdb3" )
+
+
+#| Tuning Options
+#|  -f...:        tuning, see GCC manual
+#| NOTE: -fcommon is needed as several headers declare (tentative) global variables
+#| NOTE: -fno-pie keeps static buffers below 4 GB, simulated DMA descriptors hold 32 bit addresses
+set( TUNING "-fcommon -fno-strict-aliasing -fno-pie" )
+
+
+#| Optimization level, can be [0, 1, 2, 3, s].
+set( OPT "2" )
+
+
+#| Dependency Files
+#| Compiler flags to generate dependency files.
+set( GENDEPFLAGS "-MMD" )
+
+
+#| Compiler Flags
+add_definitions( "-DF_CPU=${F_CPU} -D_${CHIP}_=1 -O${OPT} ${TUNING} ${WARN} ${CSTANDARD} ${GENDEPFLAGS}" )
+
+
+#| Linker Flags
+set( LINKER_FLAGS "${TUNING} -no-pie -Wl,-Map=link.map" )
+
+
+#| Hex Flags (XXX, CMake seems to have issues if you quote the arguments for the custom commands...)
+set( HEX_FLAGS -O ihex )
+
+
+#| Binary Flags
+set( BIN_FLAGS -O binary )
+
+
+#| Lss Flags
+set( LSS_FLAGS -h -S -z )
+
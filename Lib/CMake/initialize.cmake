@@ -29,6 +29,10 @@ if ( "${CHIP}" MATCHES "^at90usb.*$" OR "${CHIP}" MATCHES "^atmega.*$" )
 elseif ( "${CHIP}" MATCHES "^mk20dx.*$" )
 	set( COMPILER_FAMILY "arm" )
 
+#| host match
+elseif ( "${CHIP}" MATCHES "^host$" )
+	set( COMPILER_FAMILY "host" )
+
 #| Invalid CHIP
 else ()
 	message( FATAL_ERROR "CHIP: ${CHIP} - Unknown chip, could not choose compiler..." )
@@ -49,6 +49,9 @@ void yield(void) {};
 
 uint32_t micros(void)
 {
+#if defined(_host_)
+	return Host_micros();
+#else
 	uint32_t count, current, istatus;
 
 	__disable_irq();
@@ -59,6 +62,7 @@ uint32_t micros(void)
 	if ((istatus & SCB_ICSR_PENDSTSET) && current > ((F_CPU / 1000) - 50)) count++;
 	current = ((F_CPU / 1000) - 1) - current;
 	return count * 1000 + current / (F_CPU / 1000000);
+#endif
 }
 
 void delay(uint32_t ms)
@@ -57,9 +57,16 @@ static inline uint32_t millis(void)
 }
 
 
+uint32_t micros(void);
+
 static inline void delayMicroseconds(uint32_t) __attribute__((always_inline, unused));
 static inline void delayMicroseconds(uint32_t usec)
 {
+#if defined(_host_)
+	// No cycle-accurate loop on host, spin on the simulated clock instead
+	uint32_t start = micros();
+	while ( micros() - start < usec );
+#else
 #if F_CPU == 96000000
 	uint32_t n = usec << 5;
 #elif F_CPU == 72000000
@@ -75,12 +82,11 @@ static inline void delayMicroseconds(uint32_t usec)
 		"bne    L_%=_delayMicroseconds"         "\n"
 		: "+r" (n) :
 	);
+#endif
 }
 
 
 void yield(void) __attribute__ ((weak));
 
-uint32_t micros(void);
-
 void delay(uint32_t ms);
 
@@ -0,0 +1,783 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- System Includes -----
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+
+// Local Includes
+#include "mk20dx.h"
+
+
+
+// ----- Defines -----
+
+// Older kernels/libcs do not have MAP_FIXED_NOREPLACE, the address is checked after mapping instead
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0
+#endif
+
+// Register layout, see Lib/mk20dx.h
+#define HOST_GPIO_BASE   0x400FF000
+#define HOST_GPIO_STRIDE 0x40
+#define HOST_PORT_BASE   0x40049000
+#define HOST_PORT_STRIDE 0x1000
+
+#define HOST_GPIO_PDOR 0
+#define HOST_GPIO_PSOR 1
+#define HOST_GPIO_PCOR 2
+#define HOST_GPIO_PTOR 3
+#define HOST_GPIO_PDIR 4
+#define HOST_GPIO_PDDR 5
+
+#define HOST_PORT_ISFR 40 // 0xA0, after the pin control registers
+
+// PIT channel registers are 0x10 apart, DMA TCDs 0x20
+#define Host_pitReg(ch,reg) ( (volatile uint32_t*)(uintptr_t)( 0x40037100 + (ch) * 0x10 ) + (reg) )
+#define Host_dmaTCD(ch)     ( (volatile Host_DMATCD*)(uintptr_t)( 0x40009000 + (ch) * 0x20 ) )
+
+#define HOST_PIT_LDVAL 0
+#define HOST_PIT_TCTRL 2
+#define HOST_PIT_TFLG  3
+
+// Channels run per DMA request, a chain of links longer than this is a loop
+#define HOST_DMA_MAX_LINKS 8
+
+// UART registers are 0x1000 apart
+#define Host_uartReg(uart,reg) ( (volatile uint8_t*)(uintptr_t)( 0x4006A000 + (uart) * 0x1000 ) + (reg) )
+
+#define HOST_UART_D  0x07
+#define HOST_UART_C5 0x0B
+
+#define Host_gpioReg(port,reg) ( (volatile uint32_t*)(uintptr_t)( HOST_GPIO_BASE + (port) * HOST_GPIO_STRIDE ) + (reg) )
+#define Host_portPCR(port,pin) ( (volatile uint32_t*)(uintptr_t)( HOST_PORT_BASE + (port) * HOST_PORT_STRIDE ) + (pin) )
+
+
+
+// ----- Structs -----
+
+// eDMA transfer control descriptor (32 bit addresses), see Lib/mk20dx.h
+typedef struct Host_DMATCD {
+	uint32_t saddr;
+	int16_t  soff;
+	uint16_t attr;
+	uint32_t nbytes;
+	int32_t  slast;
+	uint32_t daddr;
+	int16_t  doff;
+	uint16_t citer;
+	int32_t  dlastsga;
+	uint16_t csr;
+	uint16_t biter;
+} __attribute__((packed)) Host_DMATCD;
+
+
+
+// ----- Variables -----
+
+// Simulated switches
+// For each strobe pin, a mask of the sense pins (per port) it is currently connected to
+static uint32_t Host_switches[ HOST_GPIO_PORTS ][ 32 ][ HOST_GPIO_PORTS ];
+
+// Strobe pins with at least one closed switch (per port)
+static uint32_t Host_switchStrobes[ HOST_GPIO_PORTS ];
+
+// Input levels seen by the previous update, and latched pin interrupt flags (per port)
+static uint32_t Host_portLevels[ HOST_GPIO_PORTS ];
+static uint32_t Host_portFlags[ HOST_GPIO_PORTS ];
+
+// Monotonic time of the last systick, used to interpolate micros()
+static volatile uint64_t Host_lastTickNs;
+
+// Interrupt mask used for cli()/sei()
+static sigset_t Host_irqMask;
+
+// Set while a simulated interrupt handler runs
+volatile uint8_t Host_isrActive = 0;
+
+// Skips Host_gpioUpdate while set
+uint8_t Host_gpioHold = 0;
+
+// Simulated I2C slave
+uint8_t Host_i2cSlaveAddr = 0xE8;
+uint8_t Host_i2cRegs[ 256 ];
+uint8_t Host_i2cNaks = 0;
+
+Host_I2CTransfer Host_i2cLog[ HOST_I2C_LOG ];
+uint32_t Host_i2cLogCount = 0;
+
+// Bus state
+static uint8_t Host_i2cActive;  // START seen, no STOP yet
+static uint8_t Host_i2cAcked;   // Slave acknowledged its address
+static uint8_t Host_i2cRegSet;  // First byte of a write sets the register pointer
+static uint8_t Host_i2cReg;     // Register pointer
+static volatile uint8_t Host_i2cPending; // Interrupt pending
+
+// Bus cycles counted by each PIT channel since it last expired
+static uint32_t Host_pitCycles[ HOST_PIT_CHANNELS ];
+
+// Simulated UART wiring, Tx of each UART is connected to the Rx of the given UART (-1 not connected)
+int8_t Host_uartLoop[ HOST_UARTS ] = { -1, -1, -1 };
+
+
+
+// ----- Functions -----
+
+static uint64_t Host_nanos()
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+// NVIC - SysTick ISR
+extern volatile uint32_t systick_millis_count;
+void systick_default_isr()
+{
+	systick_millis_count++;
+}
+
+void systick_isr() __attribute__ ((weak, alias("systick_default_isr")));
+
+
+// I2C interrupt, only if a driver is compiled in
+void i2c0_isr() __attribute__ ((weak));
+
+// PIT and DMA interrupts, only if a driver is compiled in
+void pit0_isr() __attribute__ ((weak));
+void pit1_isr() __attribute__ ((weak));
+void pit2_isr() __attribute__ ((weak));
+void pit3_isr() __attribute__ ((weak));
+void dma_ch0_isr() __attribute__ ((weak));
+void dma_ch1_isr() __attribute__ ((weak));
+void dma_ch2_isr() __attribute__ ((weak));
+void dma_ch3_isr() __attribute__ ((weak));
+
+static void (*const Host_pitIsr[ HOST_PIT_CHANNELS ])() = { pit0_isr, pit1_isr, pit2_isr, pit3_isr };
+static void (*const Host_dmaIsr[ HOST_DMA_CHANNELS ])() = { dma_ch0_isr, dma_ch1_isr, dma_ch2_isr, dma_ch3_isr };
+
+// Pin interrupts, only if a driver is compiled in
+void porta_isr() __attribute__ ((weak));
+void portb_isr() __attribute__ ((weak));
+void portc_isr() __attribute__ ((weak));
+void portd_isr() __attribute__ ((weak));
+void porte_isr() __attribute__ ((weak));
+
+static void (*const Host_portIsr[ HOST_GPIO_PORTS ])() = { porta_isr, portb_isr, portc_isr, portd_isr, porte_isr };
+
+
+// SIGALRM is the simulated systick interrupt (1 kHz)
+static void Host_systickHandler( int signum )
+{
+	Host_isrActive = 1;
+
+	// PITs count the time since the previous tick, at most 10 ms if the process was stalled
+	uint64_t now = Host_nanos();
+	uint64_t elapsed = now - Host_lastTickNs;
+	if ( elapsed > 10000000 )
+		elapsed = 10000000;
+	Host_lastTickNs = now;
+
+	systick_isr();
+	Host_i2cDeliver( HOST_I2C_PER_TICK );
+	Host_pitDeliver( (uint32_t)( elapsed * ( F_BUS / 1000000 ) / 1000 ) );
+	Host_uartDeliver( HOST_UART_PER_TICK );
+
+	// Pin interrupts latched by Host_gpioUpdate
+	for ( uint8_t port = 0; port < HOST_GPIO_PORTS; port++ )
+	{
+		if ( Host_portFlags[ port ] && Host_portIsr[ port ] )
+			Host_portIsr[ port ]();
+	}
+
+	Host_isrActive = 0;
+}
+
+
+// Maps a peripheral window at its real address
+static void Host_mapWindow( uintptr_t base )
+{
+	void *addr = mmap(
+		(void*)base,
+		HOST_WINDOW_SIZE,
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+		-1,
+		0
+	);
+
+	if ( addr != (void*)base )
+	{
+		fprintf( stderr, "Host: Could not map peripheral window at 0x%08lx\n", (unsigned long)base );
+		exit( 1 );
+	}
+}
+
+
+// Runs before main(), registers must be accessible before any module setup
+__attribute__ ((constructor))
+static void Host_init()
+{
+	Host_mapWindow( HOST_PERIPH_BASE );
+	Host_mapWindow( HOST_SCS_BASE );
+
+	// Transmitters are always idle
+	UART0_S1 = UART_S1_TDRE | UART_S1_TC;
+	UART1_S1 = UART_S1_TDRE | UART_S1_TC;
+	UART2_S1 = UART_S1_TDRE | UART_S1_TC;
+	I2C0_S   = I2C_S_TCF;
+	SPI0_SR  = SPI_SR_TCF | SPI_SR_TFFF; // Tx FIFO always empty
+
+	// DMA command registers read back as NOP until written, see Host_dmaUpdate
+	DMA_SERQ = DMA_SERQ_NOP;
+	DMA_CERQ = DMA_CERQ_NOP;
+	DMA_CINT = DMA_CINT_NOP;
+	DMA_CDNE = DMA_CDNE_NOP;
+
+	// Systick
+	sigemptyset( &Host_irqMask );
+	sigaddset( &Host_irqMask, SIGALRM );
+
+	struct sigaction action;
+	memset( &action, 0, sizeof( action ) );
+	action.sa_handler = Host_systickHandler;
+	action.sa_flags = SA_RESTART;
+	sigaction( SIGALRM, &action, NULL );
+
+	Host_lastTickNs = Host_nanos();
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000;
+	timer.it_value = timer.it_interval;
+	setitimer( ITIMER_REAL, &timer, NULL );
+}
+
+
+// Interrupt masking, the only asynchronous source on host is the systick
+void Host_disableIrq()
+{
+	sigprocmask( SIG_BLOCK, &Host_irqMask, NULL );
+}
+
+void Host_enableIrq()
+{
+	sigprocmask( SIG_UNBLOCK, &Host_irqMask, NULL );
+}
+
+// Sleeps until the next interrupt (WFI), even if interrupts are disabled
+// Unlike the hardware, the interrupt (systick) is handled before returning
+void Host_waitForIrq()
+{
+	sigset_t mask;
+	sigprocmask( SIG_BLOCK, NULL, &mask );
+	sigdelset( &mask, SIGALRM );
+	sigsuspend( &mask );
+}
+
+
+// Microseconds since startup, consistent with systick_millis_count
+uint32_t Host_micros()
+{
+	uint32_t count;
+	uint64_t last;
+
+	// Re-read if a tick occurred in between
+	do {
+		count = systick_millis_count;
+		last = Host_lastTickNs;
+	} while ( count != systick_millis_count );
+
+	uint64_t elapsed = ( Host_nanos() - last ) / 1000;
+	if ( elapsed > 999 )
+		elapsed = 999;
+
+	return count * 1000 + (uint32_t)elapsed;
+}
+
+
+// Host clock scaled to F_CPU, stands in for the DWT cycle counter
+uint32_t Host_cycles()
+{
+	return (uint32_t)( Host_nanos() * ( F_CPU / 1000000 ) / 1000 );
+}
+
+
+// Applies pending GPIO writes and recomputes input levels
+// Must be called before sampling PDIR (MatrixARM does this in Matrix_pin)
+void Host_gpioUpdate()
+{
+	if ( Host_gpioHold )
+		return;
+
+	uint32_t high[ HOST_GPIO_PORTS ] = { 0 };
+	uint32_t low[ HOST_GPIO_PORTS ] = { 0 };
+
+	// Fold set/clear/toggle registers into the output register
+	for ( uint8_t port = 0; port < HOST_GPIO_PORTS; port++ )
+	{
+		volatile uint32_t *pdor = Host_gpioReg( port, HOST_GPIO_PDOR );
+		volatile uint32_t *psor = Host_gpioReg( port, HOST_GPIO_PSOR );
+		volatile uint32_t *pcor = Host_gpioReg( port, HOST_GPIO_PCOR );
+		volatile uint32_t *ptor = Host_gpioReg( port, HOST_GPIO_PTOR );
+
+		*pdor = ( ( *pdor | *psor ) & ~*pcor ) ^ *ptor;
+		*psor = 0;
+		*pcor = 0;
+		*ptor = 0;
+	}
+
+	// Closed switches carry driven strobe levels to their sense pins
+	for ( uint8_t port = 0; port < HOST_GPIO_PORTS; port++ )
+	{
+		uint32_t strobes = Host_switchStrobes[ port ] & *Host_gpioReg( port, HOST_GPIO_PDDR );
+		uint32_t pdor = *Host_gpioReg( port, HOST_GPIO_PDOR );
+
+		while ( strobes )
+		{
+			uint8_t pin = __builtin_ctz( strobes );
+			strobes &= strobes - 1;
+
+			uint32_t *target = pdor & (1u << pin) ? high : low;
+			for ( uint8_t sense = 0; sense < HOST_GPIO_PORTS; sense++ )
+			{
+				target[ sense ] |= Host_switches[ port ][ pin ][ sense ];
+			}
+		}
+	}
+
+	// Compute input register, outputs read back their own level
+	// Undriven inputs follow their pull resistor (low if none), a driven high wins over a driven low
+	for ( uint8_t port = 0; port < HOST_GPIO_PORTS; port++ )
+	{
+		uint32_t pddr = *Host_gpioReg( port, HOST_GPIO_PDDR );
+		uint32_t pull = 0;
+
+		for ( uint8_t pin = 0; pin < 32; pin++ )
+		{
+			uint32_t pcr = *Host_portPCR( port, pin );
+			if ( ( pcr & PORT_PCR_PE ) && ( pcr & PORT_PCR_PS ) )
+				pull |= (1u << pin);
+		}
+
+		uint32_t input = high[ port ] | ( pull & ~low[ port ] );
+		uint32_t level = ( *Host_gpioReg( port, HOST_GPIO_PDOR ) & pddr ) | ( input & ~pddr );
+		*Host_gpioReg( port, HOST_GPIO_PDIR ) = level;
+
+		// Pin interrupts (IRQC), flags are latched until the pin interrupt is disabled
+		// Writes to ISFR are ignored, hardware drivers clear flags with a write of 1 which cannot be told apart here
+		uint32_t rising  = level & ~Host_portLevels[ port ];
+		uint32_t falling = ~level & Host_portLevels[ port ];
+		Host_portLevels[ port ] = level;
+
+		uint32_t armed = 0;
+		uint32_t flags = 0;
+		for ( uint8_t pin = 0; pin < 32; pin++ )
+		{
+			uint32_t bit = 1u << pin;
+			switch ( ( *Host_portPCR( port, pin ) & PORT_PCR_IRQC_MASK ) >> 16 )
+			{
+			case 0x8: flags |= ~level & bit;               break; // Logic 0
+			case 0x9: flags |= rising & bit;               break;
+			case 0xA: flags |= falling & bit;              break;
+			case 0xB: flags |= ( rising | falling ) & bit; break;
+			case 0xC: flags |= level & bit;                break; // Logic 1
+			default: continue;
+			}
+			armed |= bit;
+		}
+
+		Host_portFlags[ port ] = ( Host_portFlags[ port ] & armed ) | flags;
+		*Host_portPCR( port, HOST_PORT_ISFR ) = Host_portFlags[ port ];
+	}
+}
+
+
+// Opens/closes a simulated switch between a strobe and a sense pin
+void Host_switch( uint8_t strobePort, uint8_t strobePin, uint8_t sensePort, uint8_t sensePin, uint8_t closed )
+{
+	if ( strobePort >= HOST_GPIO_PORTS || sensePort >= HOST_GPIO_PORTS || strobePin > 31 || sensePin > 31 )
+		return;
+
+	if ( closed )
+		Host_switches[ strobePort ][ strobePin ][ sensePort ] |= (1u << sensePin);
+	else
+		Host_switches[ strobePort ][ strobePin ][ sensePort ] &= ~(1u << sensePin);
+
+	// Update strobe summary
+	uint32_t any = 0;
+	for ( uint8_t port = 0; port < HOST_GPIO_PORTS; port++ )
+		any |= Host_switches[ strobePort ][ strobePin ][ port ];
+
+	if ( any )
+		Host_switchStrobes[ strobePort ] |= (1u << strobePin);
+	else
+		Host_switchStrobes[ strobePort ] &= ~(1u << strobePin);
+}
+
+void Host_switchClearAll()
+{
+	memset( Host_switches, 0, sizeof( Host_switches ) );
+	memset( Host_switchStrobes, 0, sizeof( Host_switchStrobes ) );
+}
+
+
+// Current log entry
+static Host_I2CTransfer *Host_i2cTransfer()
+{
+	return &Host_i2cLog[ ( Host_i2cLogCount - 1 ) % HOST_I2C_LOG ];
+}
+
+static void Host_i2cLogByte( uint8_t byte )
+{
+	Host_I2CTransfer *transfer = Host_i2cTransfer();
+	if ( transfer->len < HOST_I2C_LOG_DATA )
+		transfer->data[ transfer->len ] = byte;
+	transfer->len++;
+}
+
+// Byte transfer finished, raise the interrupt
+static void Host_i2cComplete( uint8_t nak )
+{
+	I2C0_S = I2C_S_TCF | I2C_S_BUSY | I2C_S_IICIF | ( nak ? I2C_S_RXAK : 0 );
+
+	if ( I2C0_C1 & I2C_C1_IICIE )
+		Host_i2cPending = 1;
+}
+
+// I2C0_D was written in master transmit mode
+// The byte is an address if this is the first byte after a START or repeated START
+void Host_i2cWrite()
+{
+	uint8_t c1 = I2C0_C1;
+	uint8_t byte = I2C0_D;
+
+	if ( !( c1 & I2C_C1_MST ) || !( c1 & I2C_C1_TX ) )
+		return;
+
+	// START/repeated START (RSTA is self-clearing)
+	if ( !Host_i2cActive || ( c1 & I2C_C1_RSTA ) )
+	{
+		I2C0_C1 = c1 & ~I2C_C1_RSTA;
+		Host_i2cActive = 1;
+		Host_i2cRegSet = 0;
+
+		Host_I2CTransfer *transfer = &Host_i2cLog[ Host_i2cLogCount++ % HOST_I2C_LOG ];
+		transfer->addr = byte;
+		transfer->nak = 0;
+		transfer->len = 0;
+
+		Host_i2cAcked = ( byte & 0xFE ) == Host_i2cSlaveAddr;
+		if ( Host_i2cAcked && Host_i2cNaks > 0 )
+		{
+			Host_i2cNaks--;
+			Host_i2cAcked = 0;
+		}
+		transfer->nak = !Host_i2cAcked;
+
+		// Read, the first byte is clocked in by the dummy read of I2C0_D
+		Host_i2cComplete( !Host_i2cAcked );
+		return;
+	}
+
+	// Data byte
+	Host_i2cLogByte( byte );
+	if ( !Host_i2cAcked )
+	{
+		Host_i2cComplete( 1 );
+		return;
+	}
+
+	if ( !Host_i2cRegSet )
+	{
+		Host_i2cReg = byte;
+		Host_i2cRegSet = 1;
+	}
+	else
+	{
+		Host_i2cRegs[ Host_i2cReg++ ] = byte;
+	}
+	Host_i2cComplete( 0 );
+}
+
+// I2C0_D was read in master receive mode, the next byte is received
+void Host_i2cRead()
+{
+	uint8_t c1 = I2C0_C1;
+	if ( !( c1 & I2C_C1_MST ) || ( c1 & I2C_C1_TX ) || !Host_i2cActive )
+		return;
+
+	uint8_t byte = Host_i2cAcked ? Host_i2cRegs[ Host_i2cReg++ ] : 0xFF;
+	I2C0_D = byte;
+	Host_i2cLogByte( byte );
+	Host_i2cComplete( 0 );
+}
+
+// Master mode was left, STOP is sent immediately
+void Host_i2cStop()
+{
+	if ( I2C0_C1 & I2C_C1_MST )
+		return;
+
+	Host_i2cActive = 0;
+	Host_i2cPending = 0;
+	I2C0_S &= ~I2C_S_BUSY;
+}
+
+// Runs the I2C interrupt for up to the given number of byte transfers
+// Called from the systick, or directly when SIGALRM is blocked (i.e. tests)
+// Returns the number of transfers
+uint16_t Host_i2cDeliver( uint16_t bytes )
+{
+	uint16_t count = 0;
+	while ( count < bytes && Host_i2cPending && i2c0_isr )
+	{
+		Host_i2cPending = 0;
+		i2c0_isr();
+		count++;
+	}
+
+	return count;
+}
+
+
+// Applies writes to the DMA command registers (set/clear enable request, clear interrupt/done)
+static void Host_dmaUpdate()
+{
+	uint8_t serq = DMA_SERQ;
+	uint8_t cerq = DMA_CERQ;
+	uint8_t cint = DMA_CINT;
+	uint8_t cdne = DMA_CDNE;
+
+	if ( !( serq & DMA_SERQ_NOP ) )
+		DMA_ERQ |= serq & DMA_SERQ_SAER ? 0xFFFFFFFF : 1u << ( serq & 0xF );
+	if ( !( cerq & DMA_CERQ_NOP ) )
+		DMA_ERQ &= cerq & DMA_CERQ_CAER ? 0 : ~( 1u << ( cerq & 0xF ) );
+	if ( !( cint & DMA_CINT_NOP ) )
+		DMA_INT &= cint & DMA_CINT_CAIR ? 0 : ~( 1u << ( cint & 0xF ) );
+	if ( !( cdne & DMA_CDNE_NOP ) )
+	{
+		for ( uint8_t ch = 0; ch < HOST_DMA_CHANNELS; ch++ )
+		{
+			if ( cdne & DMA_CDNE_CADN || ( cdne & 0xF ) == ch )
+				Host_dmaTCD( ch )->csr &= ~DMA_TCD_CSR_DONE;
+		}
+	}
+
+	DMA_SERQ = DMA_SERQ_NOP;
+	DMA_CERQ = DMA_CERQ_NOP;
+	DMA_CINT = DMA_CINT_NOP;
+	DMA_CDNE = DMA_CDNE_NOP;
+}
+
+
+// Runs a DMA request of a channel, one minor loop, then any linked channels
+// Only transfers with equal source and destination sizes (up to 32 bits) are supported
+// The minor loop offset is also applied on the last minor loop, followed by SLAST/DLASTSGA
+static void Host_dmaRequest( uint8_t ch )
+{
+	for ( uint8_t links = 0; links < HOST_DMA_MAX_LINKS && ch < HOST_DMA_CHANNELS; links++ )
+	{
+		volatile Host_DMATCD *tcd = Host_dmaTCD( ch );
+
+		// Minor loop byte count and offset
+		uint32_t nbytes = tcd->nbytes;
+		int32_t mloff = 0;
+		uint8_t smloe = 0;
+		uint8_t dmloe = 0;
+		if ( DMA_CR & DMA_CR_EMLM )
+		{
+			smloe = nbytes & DMA_TCD_NBYTES_SMLOE ? 1 : 0;
+			dmloe = nbytes & DMA_TCD_NBYTES_DMLOE ? 1 : 0;
+			if ( smloe || dmloe )
+			{
+				mloff = (int32_t)( nbytes << 2 ) >> 12; // Sign extend bits 10-29
+				nbytes &= 0x3FF;
+			}
+			else
+			{
+				nbytes &= 0x3FFFFFFF;
+			}
+		}
+
+		// Reads see the current pin levels, writes are applied afterwards
+		Host_gpioUpdate();
+
+		uint32_t size = 1 << ( tcd->attr & 0x7 );
+		uint32_t saddr = tcd->saddr;
+		uint32_t daddr = tcd->daddr;
+		for ( uint32_t byte = 0; byte < nbytes && size <= 4; byte += size )
+		{
+			memcpy( (void*)(uintptr_t)daddr, (const void*)(uintptr_t)saddr, size );
+			saddr += tcd->soff;
+			daddr += tcd->doff;
+		}
+		Host_gpioUpdate();
+
+		if ( smloe )
+			saddr += mloff;
+		if ( dmloe )
+			daddr += mloff;
+
+		// Major loop count, with channel linking the count is only 9 bits
+		uint16_t citer = tcd->citer;
+		uint8_t elink = citer & DMA_TCD_CITER_ELINK ? 1 : 0;
+		uint16_t count = ( citer & ( elink ? 0x1FF : 0x7FFF ) ) - 1;
+		int8_t next = -1;
+
+		if ( count == 0 )
+		{
+			// Major loop done, addresses are updated first as the interrupt may start a new transfer
+			tcd->saddr = saddr + tcd->slast;
+			tcd->daddr = daddr + tcd->dlastsga;
+			tcd->citer = tcd->biter;
+			tcd->csr |= DMA_TCD_CSR_DONE;
+
+			if ( tcd->csr & DMA_TCD_CSR_DREQ )
+				DMA_ERQ &= ~(1 << ch);
+
+			if ( tcd->csr & DMA_TCD_CSR_MAJORELINK )
+				next = ( tcd->csr >> 8 ) & 0xF;
+
+			if ( tcd->csr & DMA_TCD_CSR_INTMAJOR )
+			{
+				DMA_INT |= (1 << ch);
+				if ( Host_dmaIsr[ ch ] )
+				{
+					Host_dmaIsr[ ch ]();
+					Host_dmaUpdate();
+				}
+			}
+		}
+		else
+		{
+			// Minor loop link, not done on the last minor loop
+			tcd->citer = ( citer & ~( elink ? 0x1FF : 0x7FFF ) ) | count;
+			if ( elink )
+				next = ( citer >> 9 ) & 0xF;
+
+			tcd->saddr = saddr;
+			tcd->daddr = daddr;
+		}
+
+		if ( next < 0 )
+			break;
+		ch = next;
+	}
+}
+
+
+// Advances the PIT channels by the given number of bus cycles
+// Expired channels set their flag, run their interrupt and trigger their DMA channel (DMAMUX periodic trigger)
+// Called from the systick, or directly when SIGALRM is blocked (i.e. tests)
+void Host_pitDeliver( uint32_t cycles )
+{
+	Host_dmaUpdate();
+
+	if ( PIT_MCR & PIT_MCR_MDIS )
+		return;
+
+	for ( uint8_t ch = 0; ch < HOST_PIT_CHANNELS; ch++ )
+	{
+		uint32_t tctrl = *Host_pitReg( ch, HOST_PIT_TCTRL );
+		if ( !( tctrl & PIT_TCTRL_TEN ) )
+		{
+			Host_pitCycles[ ch ] = 0;
+			continue;
+		}
+
+		uint64_t period = (uint64_t)*Host_pitReg( ch, HOST_PIT_LDVAL ) + 1;
+		uint64_t total = Host_pitCycles[ ch ] + (uint64_t)cycles;
+		uint64_t expired = total / period;
+		Host_pitCycles[ ch ] = total % period;
+
+		volatile uint8_t *chcfg = &DMAMUX0_CHCFG0 + ch;
+		for ( uint64_t n = 0; n < expired; n++ )
+		{
+			*Host_pitReg( ch, HOST_PIT_TFLG ) = PIT_TFLG_TIF;
+
+			if ( ( *chcfg & ( DMAMUX_ENABLE | DMAMUX_TRIG ) ) == ( DMAMUX_ENABLE | DMAMUX_TRIG ) && DMA_ERQ & (1 << ch) )
+				Host_dmaRequest( ch );
+
+			if ( tctrl & PIT_TCTRL_TIE && Host_pitIsr[ ch ] )
+				Host_pitIsr[ ch ]();
+		}
+	}
+}
+
+
+// Enabled eDMA channel the DMAMUX routes a peripheral request source to, -1 if there is none
+static int8_t Host_dmaSource( uint8_t source )
+{
+	for ( uint8_t ch = 0; ch < HOST_DMA_CHANNELS; ch++ )
+	{
+		uint8_t chcfg = *( &DMAMUX0_CHCFG0 + ch );
+		if ( ( chcfg & ( DMAMUX_ENABLE | DMAMUX_TRIG | 0x3F ) ) == ( DMAMUX_ENABLE | source ) && DMA_ERQ & (1 << ch) )
+			return ch;
+	}
+
+	return -1;
+}
+
+
+// Sends up to the given number of bytes from each UART with a Tx DMA request pending
+// Each byte is received by the UART it is looped to (Host_uartLoop), through its Rx DMA channel
+// Bytes of unconnected UARTs, or UARTs without Rx DMA, are dropped
+// Returns the number of bytes sent
+// Called from the systick, or directly when SIGALRM is blocked (i.e. tests)
+uint16_t Host_uartDeliver( uint16_t bytes )
+{
+	uint16_t sent = 0;
+
+	Host_dmaUpdate();
+
+	for ( uint8_t uart = 0; uart < HOST_UARTS; uart++ )
+	{
+		for ( uint16_t byte = 0; byte < bytes; byte++ )
+		{
+			int8_t tx = Host_dmaSource( DMAMUX_SOURCE_UART0_TX + uart * 2 );
+			if ( tx < 0 || !( *Host_uartReg( uart, HOST_UART_C5 ) & UART_C5_TDMAS ) )
+				break;
+
+			// Moves the next byte into the data register, runs the Tx DMA interrupt after the last one
+			Host_dmaRequest( tx );
+			sent++;
+
+			int8_t to = Host_uartLoop[ uart ];
+			if ( to < 0 || to >= HOST_UARTS )
+				continue;
+
+			*Host_uartReg( to, HOST_UART_D ) = *Host_uartReg( uart, HOST_UART_D );
+
+			int8_t rx = Host_dmaSource( DMAMUX_SOURCE_UART0_RX + to * 2 );
+			if ( rx >= 0 && *Host_uartReg( to, HOST_UART_C5 ) & UART_C5_RDMAS )
+				Host_dmaRequest( rx );
+		}
+	}
+
+	return sent;
+}
@@ -0,0 +1,129 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Native host HAL
+// The mk20dx peripheral address ranges are mapped into process memory at their real addresses,
+// so Lib/mk20dx.h register macros work unchanged. Register side-effects the firmware depends on
+// (GPIO set/clear/toggle, input levels) are simulated by Host_gpioUpdate.
+// I2C0 is connected to a simulated register based slave, drivers report data register accesses
+// with Host_i2cWrite/Host_i2cRead/Host_i2cStop and i2c0_isr is run from the systick signal.
+// PIT channels count from the systick signal as well. Their DMA triggers (DMAMUX periodic trigger)
+// run the matching eDMA channel, with channel linking, major loop interrupts (dma_chN_isr) and 32 bit
+// TCD addresses, so only buffers below 4 GB can be used (host builds are not position independent).
+// Pin interrupts (PORTx_PCRn IRQC) latch their flag on the simulated input levels, the port interrupt
+// is then run from the systick signal until the pin interrupt is disabled. WFI waits for the next signal.
+// UART Tx DMA requests (DMAMUX UART sources) are served from the systick signal, each byte can be looped
+// into the Rx DMA channel of another UART (Host_uartLoop). Otherwise it is dropped.
+
+#pragma once
+
+// ----- System Includes -----
+
+#include <stdint.h>
+#include <string.h>
+
+
+
+// ----- Defines -----
+
+// Peripheral windows mapped at startup (see Lib/host.c)
+#define HOST_PERIPH_BASE 0x40000000 // AIPS0/AIPS1 + GPIO
+#define HOST_SCS_BASE    0xE0000000 // Private peripheral bus (SCB, SysTick, NVIC, DWT)
+#define HOST_WINDOW_SIZE 0x00100000
+
+// Number of simulated GPIO ports (A..E)
+#define HOST_GPIO_PORTS 5
+
+// Simulated I2C, transactions kept in the log and bytes transferred per systick (~400 kHz)
+#define HOST_I2C_LOG      16
+#define HOST_I2C_LOG_DATA 256
+#define HOST_I2C_PER_TICK 40
+
+// PIT channels that can trigger a DMA channel (channel N triggers DMA channel N)
+#define HOST_PIT_CHANNELS 4
+#define HOST_DMA_CHANNELS 4
+
+// Simulated UARTs (UART0..2), and bytes sent per UART per systick with DMA
+// Slower than the real link, so a receiver's Rx DMA ring is not overrun between main loop iterations
+#define HOST_UARTS         3
+#define HOST_UART_PER_TICK 64
+
+
+
+// ----- Structs -----
+
+// Bytes following the address byte of a START/repeated START (sent or received)
+typedef struct Host_I2CTransfer {
+	uint8_t  addr;
+	uint8_t  nak;  // Address or a data byte was not acknowledged
+	uint16_t len;
+	uint8_t  data[ HOST_I2C_LOG_DATA ];
+} Host_I2CTransfer;
+
+
+
+// ----- Variables -----
+
+// Simulated slave, 8-bit (write) address and register file
+extern uint8_t Host_i2cSlaveAddr;
+extern uint8_t Host_i2cRegs[ 256 ];
+
+// Set while a simulated interrupt handler runs (the equivalent of a non-zero IPSR)
+extern volatile uint8_t Host_isrActive;
+
+// Set to skip Host_gpioUpdate, pin writes are kept pending and input levels are frozen
+// Used to time GPIO accessors without the simulation cost
+extern uint8_t Host_gpioHold;
+
+// Number of upcoming address bytes to NAK (busy chip)
+extern uint8_t Host_i2cNaks;
+
+// Transfer log, entry n is at Host_i2cLog[ n % HOST_I2C_LOG ]
+extern Host_I2CTransfer Host_i2cLog[ HOST_I2C_LOG ];
+extern uint32_t Host_i2cLogCount;
+
+// UART wiring, bytes sent by UART n are received by UART Host_uartLoop[ n ] (-1 not connected)
+extern int8_t Host_uartLoop[ HOST_UARTS ];
+
+
+
+// ----- Functions -----
+
+void Host_disableIrq();
+void Host_enableIrq();
+void Host_waitForIrq();
+
+uint32_t Host_micros();
+uint32_t Host_cycles();
+
+void Host_gpioUpdate();
+void Host_switch( uint8_t strobePort, uint8_t strobePin, uint8_t sensePort, uint8_t sensePin, uint8_t closed );
+void Host_switchClearAll();
+
+void Host_i2cWrite();
+void Host_i2cRead();
+void Host_i2cStop();
+uint16_t Host_i2cDeliver( uint16_t bytes );
+
+void Host_pitDeliver( uint32_t cycles );
+
+uint16_t Host_uartDeliver( uint16_t bytes );
+
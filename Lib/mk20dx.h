@@ -58,6 +58,11 @@
 
 #include <stdint.h>
 
+// Native host builds map the peripheral windows into process memory
+#if defined(_host_)
+#include "host.h"
+#endif
+
 
 
 // ----- Registers -----
@@ -1129,6 +1134,12 @@
 
 // Chapter 36: Periodic Interrupt Timer (PIT)
 #define PIT_MCR                 *(volatile uint32_t *)0x40037000 // PIT Module Control Register
+#define PIT_MCR_MDIS                    (uint32_t)0x02                  // Module Disable
+#define PIT_MCR_FRZ                     (uint32_t)0x01                  // Freeze (in debug mode)
+#define PIT_TCTRL_CHN                   (uint32_t)0x04                  // Chain Mode
+#define PIT_TCTRL_TIE                   (uint32_t)0x02                  // Timer Interrupt Enable
+#define PIT_TCTRL_TEN                   (uint32_t)0x01                  // Timer Enable
+#define PIT_TFLG_TIF                    (uint32_t)0x01                  // Timer Interrupt Flag
 #define PIT_LDVAL0              *(volatile uint32_t *)0x40037100 // Timer Load Value Register
 #define PIT_CVAL0               *(volatile uint32_t *)0x40037104 // Current Timer Value Register
 #define PIT_TCTRL0              *(volatile uint32_t *)0x40037108 // Timer Control Register
@@ -1883,7 +1894,7 @@ typedef struct {
 #define IRQ_SOFTWARE            45
 #define NVIC_NUM_INTERRUPTS     46
 
-#elif defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+#elif defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_)
 #define IRQ_DMA_CH0             0
 #define IRQ_DMA_CH1             1
 #define IRQ_DMA_CH2             2
@@ -1961,8 +1972,15 @@ typedef struct {
 
 
 
+#if defined(_host_)
+#define __disable_irq() Host_disableIrq();
+#define __enable_irq()  Host_enableIrq();
+#define __wait_for_irq() Host_waitForIrq();
+#else
 #define __disable_irq() asm volatile("CPSID i");
 #define __enable_irq()  asm volatile("CPSIE i");
+#define __wait_for_irq() asm volatile("WFI");
+#endif
 
 // System Control Space (SCS), ARMv7 ref manual, B3.2, page 708
 #define SCB_CPUID               *(const    uint32_t *)0xE000ED00 // CPUID Base Register
@@ -2018,9 +2036,11 @@ extern const uint8_t sys_reset_to_loader_magic[22];
 
 // ----- Functions -----
 
+#if !defined(_host_)
 void *memset( void *addr, int val, unsigned int len );
 void *memcpy( void *dst, const void *src, unsigned int len );
 int memcmp( const void *a, const void *b, unsigned int len );
+#endif
 
 extern int nvic_execution_priority(void);
 
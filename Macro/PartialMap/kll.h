@@ -71,6 +71,8 @@ typedef uint8_t index_uint_t;
 typedef uint32_t nat_ptr_t;
 #elif defined(_at90usb162_) || defined(_atmega32u4_) || defined(_at90usb646_) || defined(_at90usb1286_) // AVR
 typedef uint16_t nat_ptr_t;
+#elif defined(_host_) // Host (64 bit pointers)
+typedef uintptr_t nat_ptr_t;
 #endif
 
 
@@ -154,6 +156,20 @@ typedef struct TriggerMacroRecord {
 	TriggerMacroState state;
 } TriggerMacroRecord;
 
+// TriggerMacroInfo flags
+typedef enum TriggerMacroFlag {
+	TriggerMacroFlag_LongTrigger = 0x01, // More than 1 trigger combo
+	TriggerMacroFlag_LongResult  = 0x02, // More than 1 result combo
+} TriggerMacroFlag;
+
+// Guide information precomputed once at setup (instead of walking the guides on every evaluation)
+//  lastScanCode -> <scan code of the last key in the last combo>
+//  flags        -> <TriggerMacroFlag bits>
+typedef struct TriggerMacroInfo {
+	uint8_t lastScanCode;
+	uint8_t flags;
+} TriggerMacroInfo;
+
 // Guide, key element
 #define TriggerGuideSize sizeof( TriggerGuide )
 typedef struct TriggerGuide {
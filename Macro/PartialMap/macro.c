@@ -24,6 +24,7 @@
 #include <led.h>
 #include <print.h>
 #include <scan_loop.h>
+#include <trace.h>
 
 // Keymaps
 #include "usb_hid.h"
@@ -118,8 +119,19 @@ var_uint_t macroTriggerListLayerCache[ MaxScanCode ];
 index_uint_t macroLayerIndexStack[ LayerNum + 1 ] = { 0 };
 index_uint_t macroLayerIndexStackSize = 0;
 
+// Resolved Layer Cache
+// For each scan code, the layer whose trigger list is used on press (top-most valid layer defining the scan code)
+//  * Rebuilt on the next press lookup after LayerState or the LayerIndexStack is modified
+index_uint_t macroLayerResolved[ MaxScanCode + 1 ];
+uint8_t macroLayerResolvedDirty = 1;
+uint8_t macroLayerResolvedLatch = 0; // Set if any layer in the LayerIndexStack is latched
+
 // TODO REMOVE when dependency no longer exists
 extern ResultsPending macroResultMacroPendingList;
+extern uint8_t macroResultMacroPendingListMember[];
+extern TriggerMacroInfo macroTriggerMacroInfo[];
+extern var_uint_t macroTriggerListBufferIndex[];
+extern uint8_t macroTriggerListBufferIndexValid;
 extern index_uint_t macroTriggerMacroPendingList[];
 extern index_uint_t macroTriggerMacroPendingListSize;
 
@@ -130,6 +142,13 @@ TriggerGuide macroInterconnectCache[ MaxScanCode ];
 uint8_t macroInterconnectCacheSize = 0;
 #endif
 
+#if defined(Output_LatencyStats)
+// Oldest key transition in macroTriggerListBuffer (micros), only valid while macroLatencyPending is set
+uint8_t  macroLatencyPending = 0;
+uint32_t macroLatencyChange;
+uint32_t macroLatencyDecision;
+#endif
+
 
 
 // ----- Capabilities -----
@@ -190,6 +209,9 @@ void Macro_layerState( uint8_t state, uint8_t stateType, uint16_t layer, uint8_t
 		macroLayerIndexStackSize--;
 	}
 
+	// Resolved layers must be recomputed
+	macroLayerResolvedDirty = 1;
+
 	// Layer Debug Mode
 	if ( layerDebugMode )
 	{
@@ -380,6 +402,74 @@ void Macro_layerRotate_capability( TriggerMacro *trigger, uint8_t state, uint8_t
 
 // ----- Functions -----
 
+// Rebuilds the resolved layer cache from LayerState and the LayerIndexStack
+// Layers are applied from the bottom of the stack, so the top-most valid layer defining a scan code wins
+void Macro_layerResolve()
+{
+	// Default layer
+	for ( uint16_t scanCode = 0; scanCode <= MaxScanCode; scanCode++ )
+	{
+		macroLayerResolved[ scanCode ] = 0;
+	}
+	macroLayerResolvedLatch = 0;
+
+	for ( index_uint_t stackItem = 0; stackItem < macroLayerIndexStackSize; stackItem++ )
+	{
+		index_uint_t layerIndex = macroLayerIndexStack[ stackItem ];
+		uint8_t layerState = LayerState[ layerIndex ];
+
+		// Latches are expired on lookup, keep track of whether this needs to be done
+		if ( layerState & 0x02 )
+		{
+			macroLayerResolvedLatch = 1;
+		}
+
+		// Only use layer, if state is valid
+		// XOR each of the state bits
+		// If only two are enabled, do not use this state
+		if ( !( (layerState & 0x01) ^ ((layerState & 0x02)>>1) ^ ((layerState & 0x04)>>2) ) )
+			continue;
+
+		// Lookup layer
+		const Layer *layer = &LayerIndex[ layerIndex ];
+		nat_ptr_t **map = (nat_ptr_t**)layer->triggerMap;
+		if ( map == 0 )
+			continue;
+
+		// Override each scan code the layer has a key defined for
+		for ( uint16_t scanCode = layer->first; scanCode <= layer->last && scanCode <= MaxScanCode; scanCode++ )
+		{
+			if ( *map[ scanCode - layer->first ] != 0 )
+			{
+				macroLayerResolved[ scanCode ] = layerIndex;
+			}
+		}
+	}
+
+	macroLayerResolvedDirty = 0;
+}
+
+
+// Expires latched layers from the top of the LayerIndexStack down to (and including) the given layer
+// XXX Regardless of whether a key is found, the latch is removed on first lookup
+void Macro_layerExpireLatch( index_uint_t resolvedLayer )
+{
+	// Iterate downwards, removing an item from the stack only shifts the items above it
+	for ( uint16_t stackItem = macroLayerIndexStackSize; stackItem > 0; stackItem-- )
+	{
+		index_uint_t layerIndex = macroLayerIndexStack[ stackItem - 1 ];
+
+		if ( LayerState[ layerIndex ] & 0x02 )
+		{
+			Macro_layerState( 0, 0, layerIndex, 0x02 );
+		}
+
+		if ( layerIndex == resolvedLayer )
+			break;
+	}
+}
+
+
 // Looks up the trigger list for the given scan code (from the active layer)
 // NOTE: Calling function must handle the NULL pointer case
 nat_ptr_t *Macro_layerLookup( TriggerGuide *guide, uint8_t latch_expire )
@@ -420,62 +510,46 @@ nat_ptr_t *Macro_layerLookup( TriggerGuide *guide, uint8_t latch_expire )
 		return trigger_list;
 	}
 
-	// If no trigger macro is defined at the given layer, fallthrough to the next layer
-	for ( uint16_t layerIndex = macroLayerIndexStackSize; layerIndex != 0xFFFF; layerIndex-- )
+	// Recompute the resolved layers if any layer has changed since the last press
+	if ( macroLayerResolvedDirty )
 	{
-		// Lookup Layer
-		const Layer *layer = &LayerIndex[ macroLayerIndexStack[ layerIndex ] ];
-
-		// Check if latch has been pressed for this layer
-		// XXX Regardless of whether a key is found, the latch is removed on first lookup
-		uint8_t latch = LayerState[ macroLayerIndexStack[ layerIndex ] ] & 0x02;
-		if ( latch && latch_expire )
-		{
-			Macro_layerState( 0, 0, macroLayerIndexStack[ layerIndex ], 0x02 );
-		}
+		Macro_layerResolve();
+	}
 
-		// Only use layer, if state is valid
-		// XOR each of the state bits
-		// If only two are enabled, do not use this state
-		if ( (LayerState[ macroLayerIndexStack[ layerIndex ] ] & 0x01) ^ (latch>>1) ^ ((LayerState[ macroLayerIndexStack[ layerIndex ] ] & 0x04)>>2) )
-		{
-			// Lookup layer
-			nat_ptr_t **map = (nat_ptr_t**)layer->triggerMap;
-
-			// Determine if layer has key defined
-			// Make sure scanCode is between layer first and last scancodes
-			if ( map != 0
-				&& scanCode <= layer->last
-				&& scanCode >= layer->first
-				&& *map[ scanCode - layer->first ] != 0 )
-			{
-				// Set the layer cache
-				macroTriggerListLayerCache[ scanCode ] = macroLayerIndexStack[ layerIndex ];
+	// Top-most valid layer with a trigger macro defined for this scan code (default layer otherwise)
+	index_uint_t resolvedLayer = scanCode <= MaxScanCode ? macroLayerResolved[ scanCode ] : 0;
 
-				return map[ scanCode - layer->first ];
-			}
-		}
+	// Check if latch has been pressed for any of the layers above (or at) the resolved layer
+	if ( macroLayerResolvedLatch && latch_expire )
+	{
+		Macro_layerExpireLatch( resolvedLayer );
 	}
 
-	// Do lookup on default layer
-	nat_ptr_t **map = (nat_ptr_t**)LayerIndex[0].triggerMap;
-
-	// Lookup default layer
-	const Layer *layer = &LayerIndex[0];
+	// Lookup map, then layer
+	nat_ptr_t **map = (nat_ptr_t**)LayerIndex[ resolvedLayer ].triggerMap;
+	const Layer *layer = &LayerIndex[ resolvedLayer ];
 
+	// Layers other than the default layer are only resolved if the key is defined
 	// Make sure scanCode is between layer first and last scancodes
-	if ( map != 0
+	if ( resolvedLayer != 0 || (
+		map != 0
 		&& scanCode <= layer->last
 		&& scanCode >= layer->first
-		&& *map[ scanCode - layer->first ] != 0 )
+		&& *map[ scanCode - layer->first ] != 0 ) )
 	{
-		// Set the layer cache to default map
-		macroTriggerListLayerCache[ scanCode ] = 0;
+		// Set the layer cache
+		macroTriggerListLayerCache[ scanCode ] = resolvedLayer;
 
 		return map[ scanCode - layer->first ];
 	}
 
 	// Otherwise no defined Trigger Macro
+	if ( Trace_on() )
+	{
+		Trace_event( TraceEvent_MacroNoTrigger, scanCode, 0 );
+		return 0;
+	}
+
 	erro_msg("Scan Code has no defined Trigger Macro: ");
 	printHex( scanCode );
 	print( NL );
@@ -586,6 +660,12 @@ inline void Macro_keyState( uint8_t scanCode, uint8_t state )
 		// Check if ScanCode is out of range
 		if ( scanCode > MaxScanCode )
 		{
+			if ( Trace_on() )
+			{
+				Trace_event( TraceEvent_MacroScanCodeKey, scanCode, state );
+				return;
+			}
+
 			warn_msg("ScanCode is out of range/not defined: ");
 			printHex( scanCode );
 			print( NL );
@@ -601,6 +681,22 @@ inline void Macro_keyState( uint8_t scanCode, uint8_t state )
 }
 
 
+// Timestamps the key transition about to be given to Macro_keyState
+// changeTime - micros() when the Scan Module first saw the change, the decision time is now
+// Only the oldest transition of each processing loop is timed (see Output_latencyStamp)
+void Macro_latencyStamp( uint32_t changeTime )
+{
+#if defined(Output_LatencyStats)
+	if ( macroLatencyPending )
+		return;
+
+	macroLatencyChange = changeTime;
+	macroLatencyDecision = micros();
+	macroLatencyPending = 1;
+#endif
+}
+
+
 // Update the scancode analog state
 // States:
 //   * 0x00      - Off
@@ -615,6 +711,12 @@ inline void Macro_analogState( uint8_t scanCode, uint8_t state )
 		// Check if ScanCode is out of range
 		if ( scanCode > MaxScanCode )
 		{
+			if ( Trace_on() )
+			{
+				Trace_event( TraceEvent_MacroScanCodeAnalog, scanCode, state );
+				return;
+			}
+
 			warn_msg("ScanCode is out of range/not defined: ");
 			printHex( scanCode );
 			print( NL );
@@ -657,35 +759,37 @@ void Macro_appendResultMacroToPendingList( const TriggerMacro *triggerMacro )
 	// Lookup result macro index
 	var_uint_t resultMacroIndex = triggerMacro->result;
 
-	// Iterate through result macro pending list, making sure this macro hasn't been added yet
-	for ( var_uint_t macro = 0; macro < macroResultMacroPendingList.size; macro++ )
-	{
-		// If duplicate found, do nothing
-		if ( macroResultMacroPendingList.data[ macro ].index == resultMacroIndex )
-			return;
-	}
+	// Make sure this macro hasn't been added yet, if duplicate do nothing
+	if ( macroResultMacroPendingListMember[ resultMacroIndex >> 3 ] & (1 << (resultMacroIndex & 0x7)) )
+		return;
+	macroResultMacroPendingListMember[ resultMacroIndex >> 3 ] |= (1 << (resultMacroIndex & 0x7));
 
 	// No duplicates found, add to pending list
 	macroResultMacroPendingList.data[ macroResultMacroPendingList.size ].trigger = (TriggerMacro*)triggerMacro;
 	macroResultMacroPendingList.data[ macroResultMacroPendingList.size++ ].index = resultMacroIndex;
 
-	// Lookup scanCode of the last key in the last combo
-	var_uint_t pos = 0;
-	for ( uint8_t comboLength = triggerMacro->guide[0]; comboLength > 0; )
-	{
-		pos += TriggerGuideSize * comboLength + 1;
-		comboLength = triggerMacro->guide[ pos ];
-	}
-
-	uint8_t scanCode = ((TriggerGuide*)&triggerMacro->guide[ pos - TriggerGuideSize ])->scanCode;
+	// Scan code of the last key in the last combo (see Trigger_setup)
+	uint8_t scanCode = macroTriggerMacroInfo[ triggerMacro - TriggerMacroList ].lastScanCode;
 
 	// Lookup scanCode in buffer list for the current state and stateType
-	for ( var_uint_t keyIndex = 0; keyIndex < macroTriggerListBufferSize; keyIndex++ )
+	// Use the scan code index while Trigger_process has it built, otherwise scan the buffer
+	var_uint_t position = macroTriggerListBufferIndexValid && scanCode <= MaxScanCode
+		? macroTriggerListBufferIndex[ scanCode ]
+		: 0;
+	if ( position )
+	{
+		ResultMacroRecordList[ resultMacroIndex ].state     = macroTriggerListBuffer[ position - 1 ].state;
+		ResultMacroRecordList[ resultMacroIndex ].stateType = macroTriggerListBuffer[ position - 1 ].type;
+	}
+	else
 	{
-		if ( macroTriggerListBuffer[ keyIndex ].scanCode == scanCode )
+		for ( var_uint_t keyIndex = 0; keyIndex < macroTriggerListBufferSize; keyIndex++ )
 		{
-			ResultMacroRecordList[ resultMacroIndex ].state     = macroTriggerListBuffer[ keyIndex ].state;
-			ResultMacroRecordList[ resultMacroIndex ].stateType = macroTriggerListBuffer[ keyIndex ].type;
+			if ( macroTriggerListBuffer[ keyIndex ].scanCode == scanCode )
+			{
+				ResultMacroRecordList[ resultMacroIndex ].state     = macroTriggerListBuffer[ keyIndex ].state;
+				ResultMacroRecordList[ resultMacroIndex ].stateType = macroTriggerListBuffer[ keyIndex ].type;
+			}
 		}
 	}
 
@@ -767,6 +871,17 @@ inline void Macro_process()
 	// Process result macros
 	Result_process();
 
+#if defined(Output_LatencyStats)
+	// Hand the transition timestamp over to the Output Module, if it changed a USB report
+	// Transitions without an output change (e.g. layer keys) are not timed
+	if ( macroLatencyPending )
+	{
+		if ( USBKeys_Changed )
+			Output_latencyStamp( macroLatencyChange, macroLatencyDecision );
+		macroLatencyPending = 0;
+	}
+#endif
+
 	// Signal buffer that we've used it
 	Scan_finishedWithMacro( macroTriggerListBufferSize );
 
@@ -802,6 +917,9 @@ inline void Macro_setup()
 	// Set the current rotated layer to 0
 	Macro_rotationLayer = 0;
 
+	// Resolve layers on first lookup
+	macroLayerResolvedDirty = 1;
+
 	// Setup Triggers
 	Trigger_setup();
 
@@ -1077,6 +1195,7 @@ void cliFunc_layerState( char* args )
 
 			// Set the layer state
 			LayerState[ arg1 ] = arg2;
+			macroLayerResolvedDirty = 1;
 			break;
 		}
 	}
@@ -21,6 +21,7 @@
 
 // Project Includes
 #include <led.h>
+#include <perf.h>
 #include <print.h>
 
 // Local Includes
@@ -29,15 +30,45 @@
 
 
 
+// ----- Defines -----
+
+// Combos of a result macro may be delayed (see Macro_resultDelay_capability), AVR has no ms timer
+#if !( defined(_at90usb162_) || defined(_atmega32u4_) || defined(_at90usb646_) || defined(_at90usb1286_) )
+#define Result_Timers
+#endif
+
+// Timer wheel slots (1 ms each), must be a power of two
+// Longer delays stay in their slot for more than one turn
+#define ResultTimerSlots 32
+
+// Number of result macros which may wait at the same time, others continue without delay
+#define ResultTimerPoolSize 16
+
+#define ResultTimerNone 0xFF
+
+
+
 // ----- Enums -----
 
 typedef enum ResultMacroEval {
 	ResultMacroEval_DoNothing,
 	ResultMacroEval_Remove,
+	ResultMacroEval_Delay, // Wait resultComboWait ms before the next combo
 } ResultMacroEval;
 
 
 
+// ----- Structs -----
+
+// Result macro waiting for its next combo
+typedef struct ResultTimer {
+	ResultPendingElem elem;
+	uint32_t          due;  // systick_millis_count
+	uint8_t           next; // Next timer in the same slot (or free list)
+} ResultTimer;
+
+
+
 
 // ----- KLL Generated Variables -----
 
@@ -54,10 +85,125 @@ extern ResultMacroRecord ResultMacroRecordList[];
 //  * Any result macro that needs processing from a previous macro processing loop
 ResultsPending macroResultMacroPendingList;
 
+// Pending Result Macro Membership
+//  * Bit is set if the result macro index is in macroResultMacroPendingList, or waiting on a result timer
+uint8_t macroResultMacroPendingListMember[ ResultMacroNum / 8 + 1 ] = { 0 };
+
+#if defined(Result_Timers)
+// Timer wheel, each slot is a list of the timers due at a time with the same low bits
+ResultTimer resultTimerPool[ ResultTimerPoolSize ];
+uint8_t     resultTimerSlot[ ResultTimerSlots ];
+uint8_t     resultTimerFree;
+uint32_t    resultTimerTick; // Next wheel tick to visit
+
+// Delay before the next combo of the result macro being evaluated (ms)
+//  * Set to resultComboDelay before each combo, Macro_resultDelay_capability overrides it
+uint16_t resultComboWait;
+#endif
+
+#if defined(Perf_Enabled)
+// Cycles spent in each capability, indexed like CapabilitiesList (see capList)
+PerfCounter Result_capabilityPerf[ CapabilitiesNum ];
+#endif
+
+
+
+// ----- Capabilities -----
+
+// Delays the next combo of the result macro
+// Argument #1: Delay (ms) -> uint16_t
+void Macro_resultDelay_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
+{
+	// Display capability name
+	if ( stateType == 0xFF && state == 0xFF )
+	{
+		print("Macro_resultDelay(ms)");
+		return;
+	}
+
+#if defined(Result_Timers)
+	// Cast pointer to uint8_t to uint16_t then access that memory location
+	resultComboWait = *(uint16_t*)(&args[0]);
+#endif
+}
+
 
 
 // ----- Functions -----
 
+#if defined(Result_Timers)
+static void Result_timerSetup()
+{
+	for ( uint8_t slot = 0; slot < ResultTimerSlots; slot++ )
+		resultTimerSlot[ slot ] = ResultTimerNone;
+
+	// Chain the free list
+	for ( uint8_t timer = 0; timer < ResultTimerPoolSize; timer++ )
+		resultTimerPool[ timer ].next = timer + 1 < ResultTimerPoolSize ? timer + 1 : ResultTimerNone;
+	resultTimerFree = 0;
+
+	resultTimerTick = systick_millis_count;
+}
+
+
+// Parks the result macro until delay ms have passed
+// Returns 0 if no timer is available
+static uint8_t Result_timerAdd( ResultPendingElem elem, uint16_t delay )
+{
+	uint8_t timer = resultTimerFree;
+	if ( timer == ResultTimerNone )
+		return 0;
+	resultTimerFree = resultTimerPool[ timer ].next;
+
+	uint32_t due = systick_millis_count + delay;
+	uint8_t slot = due & ( ResultTimerSlots - 1 );
+
+	resultTimerPool[ timer ].elem = elem;
+	resultTimerPool[ timer ].due  = due;
+	resultTimerPool[ timer ].next = resultTimerSlot[ slot ];
+	resultTimerSlot[ slot ] = timer;
+
+	return 1;
+}
+
+
+// Moves the result macros that are due back onto macroResultMacroPendingList
+// Only the slots of the ticks since the last call are visited (at most one turn of the wheel)
+static void Result_timerWake()
+{
+	uint32_t now = systick_millis_count;
+
+	for ( uint8_t visited = 0; (int32_t)( now - resultTimerTick ) >= 0 && visited < ResultTimerSlots; visited++ )
+	{
+		uint8_t *link = &resultTimerSlot[ resultTimerTick++ & ( ResultTimerSlots - 1 ) ];
+		while ( *link != ResultTimerNone )
+		{
+			ResultTimer *timer = &resultTimerPool[ *link ];
+
+			// Not due yet, later turn of the wheel
+			if ( (int32_t)( now - timer->due ) < 0 )
+			{
+				link = &timer->next;
+				continue;
+			}
+
+			macroResultMacroPendingList.data[ macroResultMacroPendingList.size++ ] = timer->elem;
+
+			// Unlink and free
+			uint8_t index = *link;
+			*link = timer->next;
+			timer->next = resultTimerFree;
+			resultTimerFree = index;
+		}
+	}
+
+	// Every slot has been visited, no need to catch up on the rest
+	if ( (int32_t)( now - resultTimerTick ) >= 0 )
+		resultTimerTick = now + 1;
+}
+#endif
+
+
 // Evaluate/Update ResultMacro
 ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
 {
@@ -77,6 +223,10 @@ ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
 	// Combo Item Position within the guide
 	var_uint_t comboItem = pos + 1;
 
+#if defined(Result_Timers)
+	resultComboWait = ResultComboDelay_define;
+#endif
+
 	// Iterate through the Result Combo
 	while ( funcCount < comboLength )
 	{
@@ -88,7 +238,9 @@ ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
 			(void(*)(TriggerMacro*, uint8_t, uint8_t, uint8_t*))(CapabilitiesList[ guide->index ].func);
 
 		// Call capability
+		Perf_start( cycles );
 		capability( resultElem.trigger, record->state, record->stateType, &guide->args );
+		Perf_stop( &Result_capabilityPerf[ guide->index ], cycles );
 
 		// Increment counters
 		funcCount++;
@@ -105,6 +257,12 @@ ResultMacroEval Macro_evalResultMacro( ResultPendingElem resultElem )
 		return ResultMacroEval_Remove;
 	}
 
+#if defined(Result_Timers)
+	// Wait before the next combo
+	if ( resultComboWait )
+		return ResultMacroEval_Delay;
+#endif
+
 	// Otherwise leave the macro in the list
 	return ResultMacroEval_DoNothing;
 }
@@ -119,6 +277,15 @@ void Result_setup()
 {
 	// Initialize macroResultMacroPendingList
 	macroResultMacroPendingList.size = 0;
+	memset( macroResultMacroPendingListMember, 0, sizeof( macroResultMacroPendingListMember ) );
+
+#if defined(Result_Timers)
+	Result_timerSetup();
+#endif
+
+#if defined(Perf_Enabled)
+	Perf_registerGroup( "Capabilities", 0, Result_capabilityPerf, CapabilitiesNum );
+#endif
 
 	// Initialize ResultMacro states
 	for ( var_uint_t macro = 0; macro < ResultMacroNum; macro++ )
@@ -136,11 +303,24 @@ void Result_process()
 	// Macros must be explicitly re-added
 	index_uint_t macroResultMacroPendingListTail = 0;
 
+#if defined(Result_Timers)
+	// Add the result macros which are done waiting
+	Result_timerWake();
+#endif
+
 	// Iterate through the pending ResultMacros, processing each of them
 	for ( index_uint_t macro = 0; macro < macroResultMacroPendingList.size; macro++ )
 	{
 		switch ( Macro_evalResultMacro( macroResultMacroPendingList.data[ macro ] ) )
 		{
+#if defined(Result_Timers)
+		// Park until the next combo is due
+		// If there is no free timer, continue without delay (purposely falling through)
+		case ResultMacroEval_Delay:
+			if ( Result_timerAdd( macroResultMacroPendingList.data[ macro ], resultComboWait ) )
+				break;
+#endif
+
 		// Re-add macros to pending list
 		case ResultMacroEval_DoNothing:
 		default:
@@ -152,6 +332,8 @@ void Result_process()
 
 		// Remove Macro from Pending List, nothing to do, removing by default
 		case ResultMacroEval_Remove:
+			macroResultMacroPendingListMember[ macroResultMacroPendingList.data[ macro ].index >> 3 ]
+				&= ~(1 << (macroResultMacroPendingList.data[ macro ].index & 0x7));
 			break;
 		}
 	}
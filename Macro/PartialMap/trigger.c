@@ -21,6 +21,7 @@
 
 // Project Includes
 #include <led.h>
+#include <perf.h>
 #include <print.h>
 
 // Local Includes
@@ -78,6 +79,29 @@ extern var_uint_t macroTriggerListLayerCache[];
 index_uint_t macroTriggerMacroPendingList[ TriggerMacroNum ] = { 0 };
 index_uint_t macroTriggerMacroPendingListSize = 0;
 
+// Pending Trigger Macro Membership
+//  * Bit is set if the trigger macro index is in macroTriggerMacroPendingList
+uint8_t macroTriggerMacroPendingListMember[ TriggerMacroNum / 8 + 1 ] = { 0 };
+
+// Key Trigger List Buffer Scan Code Index
+//  * Rebuilt every processing loop, position + 1 of the first pressed/held/released entry for each scan code
+//  * 0 if the scan code has no pressed/held/released entry in macroTriggerListBuffer
+//  * Only valid if all buffered scan codes are <= MaxScanCode, otherwise the buffer is scanned as before
+var_uint_t macroTriggerListBufferIndex[ MaxScanCode + 1 ] = { 0 };
+uint8_t macroTriggerListBufferIndexValid = 0;
+
+// Precomputed guide information of each TriggerMacro (see Trigger_setup)
+TriggerMacroInfo macroTriggerMacroInfo[ TriggerMacroNum ];
+
+// Combined incorrect key votes (long macros) of every key in macroTriggerListBuffer
+TriggerMacroVote macroTriggerListBufferVote = TriggerMacroVote_Invalid;
+
+#if defined(Perf_Enabled)
+// Trigger_process stages, see the perf command
+PerfCounter Trigger_perf[3];
+const char *const Trigger_perfLabels[] = { "Index", "Pending", "Evaluate" };
+#endif
+
 
 
 // ----- Protected Macro Functions -----
@@ -234,6 +258,32 @@ inline TriggerMacroVote Macro_evalLongTriggerMacroVote( TriggerGuide *key, Trigg
 }
 
 
+// Votes on the given guide using the scan code index, equivalent to voting over every key in the buffer
+// Only normal keys are indexed
+inline TriggerMacroVote Macro_evalIndexedTriggerMacroVote( TriggerGuide *guide, uint8_t longMacro )
+{
+	var_uint_t position = macroTriggerListBufferIndex[ guide->scanCode ];
+
+	// Correct key, the first pressed/held/released entry decides the vote
+	if ( position )
+	{
+		TriggerGuide *keyInfo = &macroTriggerListBuffer[ position - 1 ];
+		return longMacro
+			? Macro_evalLongTriggerMacroVote( keyInfo, guide )
+			: Macro_evalShortTriggerMacroVote( keyInfo, guide );
+	}
+
+	// No passing key, long macros take the votes of all the other keys
+	if ( longMacro )
+		return macroTriggerListBufferVote;
+
+	// Short macros fail, incorrect keys do nothing
+	return macroTriggerListBufferSize > 0
+		? TriggerMacroVote_DoNothing | TriggerMacroVote_Fail
+		: TriggerMacroVote_Fail;
+}
+
+
 // Evaluate/Update TriggerMacro
 TriggerMacroEval Macro_evalTriggerMacro( var_uint_t triggerMacroIndex )
 {
@@ -261,7 +311,8 @@ TriggerMacroEval Macro_evalTriggerMacro( var_uint_t triggerMacroIndex )
 	}
 
 	// Check if this is a long Trigger Macro
-	uint8_t longMacro = Macro_isLongTriggerMacro( macro );
+	uint8_t flags = macroTriggerMacroInfo[ triggerMacroIndex ].flags;
+	uint8_t longMacro = flags & TriggerMacroFlag_LongTrigger;
 
 	// Iterate through the items in the combo, voting the on the key state
 	// If any of the pressed keys do not match, fail the macro
@@ -281,28 +332,37 @@ TriggerMacroEval Macro_evalTriggerMacro( var_uint_t triggerMacroIndex )
 		TriggerGuide *guide = (TriggerGuide*)(&macro->guide[ comboItem ]);
 
 		TriggerMacroVote vote = TriggerMacroVote_Invalid;
-		// Iterate through the key buffer, comparing to each key in the combo
-		for ( var_uint_t key = 0; key < macroTriggerListBufferSize; key++ )
+
+		// Lookup the key directly using the scan code index
+		if ( macroTriggerListBufferIndexValid && guide->type == 0x00 && guide->scanCode <= MaxScanCode )
+		{
+			vote = Macro_evalIndexedTriggerMacroVote( guide, longMacro );
+		}
+		else
 		{
-			// Lookup key information
-			TriggerGuide *keyInfo = &macroTriggerListBuffer[ key ];
-
-			// If vote is a pass (>= 0x08, no more keys in the combo need to be looked at)
-			// Also mask all of the non-passing votes
-			vote |= longMacro
-				? Macro_evalLongTriggerMacroVote( keyInfo, guide )
-				: Macro_evalShortTriggerMacroVote( keyInfo, guide );
-			if ( vote >= TriggerMacroVote_Pass )
+			// Iterate through the key buffer, comparing to each key in the combo
+			for ( var_uint_t key = 0; key < macroTriggerListBufferSize; key++ )
 			{
-				vote &= TriggerMacroVote_Release | TriggerMacroVote_PassRelease | TriggerMacroVote_Pass;
-				break;
+				// Lookup key information
+				TriggerGuide *keyInfo = &macroTriggerListBuffer[ key ];
+
+				// If vote is a pass (>= 0x08, no more keys in the combo need to be looked at)
+				// Also mask all of the non-passing votes
+				vote |= longMacro
+					? Macro_evalLongTriggerMacroVote( keyInfo, guide )
+					: Macro_evalShortTriggerMacroVote( keyInfo, guide );
+				if ( vote >= TriggerMacroVote_Pass )
+				{
+					vote &= TriggerMacroVote_Release | TriggerMacroVote_PassRelease | TriggerMacroVote_Pass;
+					break;
+				}
 			}
-		}
 
-		// If no pass vote was found after scanning all of the keys
-		// Fail the combo, if this is a short macro (long macros already will have a fail vote)
-		if ( !longMacro && vote < TriggerMacroVote_Pass )
-			vote |= TriggerMacroVote_Fail;
+			// If no pass vote was found after scanning all of the keys
+			// Fail the combo, if this is a short macro (long macros already will have a fail vote)
+			if ( !longMacro && vote < TriggerMacroVote_Pass )
+				vote |= TriggerMacroVote_Fail;
+		}
 
 		// After voting, append to overall vote
 		overallVote |= vote;
@@ -347,7 +407,7 @@ TriggerMacroEval Macro_evalTriggerMacro( var_uint_t triggerMacroIndex )
 		if ( macro->guide[ pos + comboLength + 1 ] == 0 )
 		{
 			// Long result macro (more than 1 combo)
-			if ( Macro_isLongResultMacro( &ResultMacroList[ macro->result ] ) )
+			if ( flags & TriggerMacroFlag_LongResult )
 			{
 				// Only ever trigger result once, on press
 				if ( overallVote == TriggerMacroVote_Pass )
@@ -359,7 +419,7 @@ TriggerMacroEval Macro_evalTriggerMacro( var_uint_t triggerMacroIndex )
 			else
 			{
 				// Only trigger result once, on press, if long trigger (more than 1 combo)
-				if ( Macro_isLongTriggerMacro( macro ) )
+				if ( longMacro )
 				{
 					return TriggerMacroEval_DoResultAndRemove;
 				}
@@ -420,21 +480,12 @@ inline void Macro_updateTriggerMacroPendingList()
 			// Lookup trigger macro index
 			var_uint_t triggerMacroIndex = triggerList[ macro ];
 
-			// Iterate over macroTriggerMacroPendingList to see if any macro in the scancode's
-			//  triggerList needs to be added
-			var_uint_t pending = 0;
-			for ( ; pending < macroTriggerMacroPendingListSize; pending++ )
-			{
-				// Stop scanning if the trigger macro index is found in the pending list
-				if ( macroTriggerMacroPendingList[ pending ] == triggerMacroIndex )
-					break;
-			}
-
-			// If the triggerMacroIndex (macro) was not found in the macroTriggerMacroPendingList
+			// If the triggerMacroIndex (macro) is not in the macroTriggerMacroPendingList
 			// Add it to the list
-			if ( pending == macroTriggerMacroPendingListSize )
+			if ( !( macroTriggerMacroPendingListMember[ triggerMacroIndex >> 3 ] & (1 << (triggerMacroIndex & 0x7)) ) )
 			{
 				macroTriggerMacroPendingList[ macroTriggerMacroPendingListSize++ ] = triggerMacroIndex;
+				macroTriggerMacroPendingListMember[ triggerMacroIndex >> 3 ] |= (1 << (triggerMacroIndex & 0x7));
 
 				// Reset macro position
 				TriggerMacroRecordList[ triggerMacroIndex ].pos   = 0;
@@ -459,19 +510,97 @@ uint8_t Trigger_update( uint8_t type, uint8_t state, uint8_t index )
 
 void Trigger_setup()
 {
+#if defined(Perf_Enabled)
+	Perf_registerGroup( "Triggers", Trigger_perfLabels, Trigger_perf, 3 );
+#endif
+
 	// Initialize TriggerMacro states
 	for ( var_uint_t macro = 0; macro < TriggerMacroNum; macro++ )
 	{
 		TriggerMacroRecordList[ macro ].pos   = 0;
 		TriggerMacroRecordList[ macro ].state = TriggerMacro_Waiting;
+
+		// Lookup scanCode of the last key in the last combo
+		const uint8_t *guide = TriggerMacroList[ macro ].guide;
+		var_uint_t pos = 0;
+		for ( uint8_t comboLength = guide[0]; comboLength > 0; )
+		{
+			pos += TriggerGuideSize * comboLength + 1;
+			comboLength = guide[ pos ];
+		}
+
+		macroTriggerMacroInfo[ macro ].lastScanCode = ((TriggerGuide*)&guide[ pos - TriggerGuideSize ])->scanCode;
+
+		// Sequence lengths, so evaluation does not have to walk the guides
+		macroTriggerMacroInfo[ macro ].flags =
+			( Macro_isLongTriggerMacro( &TriggerMacroList[ macro ] ) ? TriggerMacroFlag_LongTrigger : 0 )
+			| ( Macro_isLongResultMacro( &ResultMacroList[ TriggerMacroList[ macro ].result ] ) ? TriggerMacroFlag_LongResult : 0 );
+	}
+}
+
+
+// Indexes macroTriggerListBuffer by scan code, must be cleared before the buffer is modified
+inline void Macro_indexTriggerListBuffer()
+{
+	macroTriggerListBufferVote = TriggerMacroVote_Invalid;
+	macroTriggerListBufferIndexValid = 1;
+
+	for ( var_uint_t key = 0; key < macroTriggerListBufferSize; key++ )
+	{
+		TriggerGuide *keyInfo = &macroTriggerListBuffer[ key ];
+
+		// Scan code out of range, fallback to scanning the buffer
+		if ( keyInfo->scanCode > MaxScanCode )
+		{
+			macroTriggerListBufferIndexValid = 0;
+			continue;
+		}
+
+		// Incorrect key votes (see Macro_evalLongTriggerMacroVote)
+		switch ( keyInfo->state )
+		{
+		case 0x01:
+			macroTriggerListBufferVote |= TriggerMacroVote_Fail;
+			break;
+		case 0x02:
+			macroTriggerListBufferVote |= TriggerMacroVote_DoNothing;
+			break;
+		case 0x03:
+			macroTriggerListBufferVote |= TriggerMacroVote_DoNothing | TriggerMacroVote_DoNothingRelease;
+			break;
+		default:
+			continue;
+		}
+
+		// Only the first pressed/held/released entry of a scan code is used for voting
+		if ( macroTriggerListBufferIndex[ keyInfo->scanCode ] == 0 )
+			macroTriggerListBufferIndex[ keyInfo->scanCode ] = key + 1;
+	}
+}
+
+inline void Macro_clearTriggerListBufferIndex()
+{
+	for ( var_uint_t key = 0; key < macroTriggerListBufferSize; key++ )
+	{
+		if ( macroTriggerListBuffer[ key ].scanCode <= MaxScanCode )
+			macroTriggerListBufferIndex[ macroTriggerListBuffer[ key ].scanCode ] = 0;
 	}
+
+	macroTriggerListBufferIndexValid = 0;
 }
 
 
 void Trigger_process()
 {
+	Perf_start( cycles );
+
+	// Index the keys of this processing loop
+	Macro_indexTriggerListBuffer();
+	Perf_lap( &Trigger_perf[0], cycles );
+
 	// Update pending trigger list, before processing TriggerMacros
 	Macro_updateTriggerMacroPendingList();
+	Perf_lap( &Trigger_perf[1], cycles );
 
 	// Tail pointer for macroTriggerMacroPendingList
 	// Macros must be explicitly re-added
@@ -498,11 +627,17 @@ void Trigger_process()
 
 		// Remove Macro from Pending List, nothing to do, removing by default
 		case TriggerMacroEval_Remove:
+			macroTriggerMacroPendingListMember[ macroTriggerMacroPendingList[ macro ] >> 3 ]
+				&= ~(1 << (macroTriggerMacroPendingList[ macro ] & 0x7));
 			break;
 		}
 	}
 
 	// Update the macroTriggerMacroPendingListSize with the tail pointer
 	macroTriggerMacroPendingListSize = macroTriggerMacroPendingListTail;
+
+	// Buffer is reset after processing
+	Macro_clearTriggerListBufferIndex();
+	Perf_stop( &Trigger_perf[2], cycles );
 }
 
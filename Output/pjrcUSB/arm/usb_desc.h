@@ -56,6 +56,7 @@
 #define EP0_SIZE                64
 #define NUM_ENDPOINTS           10 // XXX Can save some space if this can be calculated using KLL
 #define NUM_USB_BUFFERS         30
+#define NUM_USB_REPORT_BUFFERS  4  // Of NUM_USB_BUFFERS, only for HID reports (see usb_malloc_report)
 
 // XXX Remember to update total interface count, if it isn't correct some OSs will not initialize USB
 //     Linux warns in dmesg
@@ -170,6 +170,9 @@ uint8_t usb_rx_memory_needed = 0;
 volatile uint8_t usb_configuration = 0;
 volatile uint8_t usb_reboot_timer = 0;
 
+// Number of SOF tokens (USB frames, 1 ms at full speed) received since startup
+volatile uint32_t usb_frame_count = 0;
+
 static uint8_t reply_buffer[8];
 
 static uint8_t power_neg_delay;
@@ -1246,6 +1249,8 @@ restart:
 
 	if ( (status & USB_INTEN_SOFTOKEN /* 04 */ ) )
 	{
+		usb_frame_count++;
+
 		if ( usb_configuration )
 		{
 			t = usb_reboot_timer;
@@ -48,6 +48,7 @@
 // ----- Variables -----
 
 extern volatile uint8_t usb_configuration;
+extern volatile uint32_t usb_frame_count;
 
 extern uint16_t usb_rx_byte_count_data[NUM_ENDPOINTS];
 
@@ -55,105 +55,65 @@
 // When the PC isn't listening, how long do we wait before discarding data?
 #define TX_TIMEOUT_MSEC 50
 
-#if F_CPU == 168000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 1100)
-#elif F_CPU == 144000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 932)
-#elif F_CPU == 120000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 764)
-#elif F_CPU == 96000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 72000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 512)
-#elif F_CPU == 48000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
-
 
 
 // ----- Variables -----
 
 static uint8_t transmit_previous_timeout = 0;
 
+// Time (ms) a report first could not be queued, only valid while transmit_waiting is set
+static uint8_t  transmit_waiting = 0;
+static uint32_t transmit_wait_start;
 
+// USB frame of the last report sent, per endpoint
+// A report snapshots the current key state, changes made during the same frame are sent together in the next one
+static uint32_t keyboard_frame;
+static uint32_t sys_ctrl_frame;
 
-// ----- Functions -----
 
-// send the contents of keyboard_keys and keyboard_modifier_keys
-void usb_keyboard_send()
-{
-	uint32_t wait_count = 0;
-	usb_packet_t *tx_packet;
 
-	// Wait till ready
-	while ( 1 )
-	{
-		if ( !usb_configuration )
-		{
-			erro_print("USB not configured...");
-			return;
-		}
+// ----- Functions -----
 
-		// Try to wake up the host if it's asleep
-		if ( usb_resume() )
-		{
-			// Drop packet
-			USBKeys_Changed = USBKeyChangeState_None;
-			return;
-		}
+// Returns a packet if the endpoint has room for one, never waits
+static usb_packet_t *usb_keyboard_packet( uint32_t endpoint )
+{
+	if ( usb_tx_packet_count( endpoint ) >= TX_PACKET_LIMIT )
+		return 0;
 
-		if ( USBKeys_Protocol == 0 ) // Boot Mode
-		{
-			if ( usb_tx_packet_count( KEYBOARD_ENDPOINT ) < TX_PACKET_LIMIT )
-			{
-				tx_packet = usb_malloc();
-				if ( tx_packet )
-					break;
-			}
-		}
-		else if ( USBKeys_Protocol == 1 ) // NKRO Mode
-		{
-			if ( usb_tx_packet_count( NKRO_KEYBOARD_ENDPOINT ) < TX_PACKET_LIMIT )
-			{
-				tx_packet = usb_malloc();
-				if ( tx_packet )
-					break;
-			}
-		}
-		else if ( USBKeys_Changed &
-			( USBKeyChangeState_System | USBKeyChangeState_Consumer )
-		)
-		{
-			if ( usb_tx_packet_count( SYS_CTRL_ENDPOINT ) < TX_PACKET_LIMIT )
-			{
-				tx_packet = usb_malloc();
-				if ( tx_packet )
-					break;
-			}
-		}
+	return usb_malloc_report();
+}
 
-		// USB Timeout, drop the packet, and potentially try something more drastic to re-enable the bus
-		if ( ++wait_count > TX_TIMEOUT || transmit_previous_timeout )
-		{
-			transmit_previous_timeout = 1;
-			USBKeys_Changed = USBKeyChangeState_None; // Indicate packet lost
-			#if enableDeviceRestartOnUSBTimeout == 1
-			warn_print("USB Transmit Timeout...restarting device");
-			usb_device_software_reset();
-			#else
-			warn_print("USB Transmit Timeout...auto-restart disabled");
-			#endif
-			// Try to wakeup
-			return;
-		}
+// Called when a pending report could not be queued
+// Returns 1 if pending reports were dropped
+static uint8_t usb_keyboard_timeout()
+{
+	if ( !transmit_waiting )
+	{
+		transmit_waiting = 1;
+		transmit_wait_start = systick_millis_count;
+	}
 
-		yield();
+	// USB Timeout, drop the packet, and potentially try something more drastic to re-enable the bus
+	if ( systick_millis_count - transmit_wait_start > TX_TIMEOUT_MSEC || transmit_previous_timeout )
+	{
+		transmit_previous_timeout = 1;
+		transmit_waiting = 0;
+		USBKeys_Changed = USBKeyChangeState_None; // Indicate packet lost
+		#if enableDeviceRestartOnUSBTimeout == 1
+		warn_print("USB Transmit Timeout...restarting device");
+		usb_device_software_reset();
+		#else
+		warn_print("USB Transmit Timeout...auto-restart disabled");
+		#endif
+		return 1;
 	}
 
-	transmit_previous_timeout = 0;
+	return 0;
+}
 
+// System Control report, or Consumer Control if there is no System Control change
+static void usb_keyboard_sysCtrl( usb_packet_t *tx_packet )
+{
 	// Pointer to USB tx packet buffer
 	uint8_t *tx_buf = tx_packet->buf;
 
@@ -197,6 +157,13 @@ void usb_keyboard_send()
 		USBKeys_Changed &= ~USBKeyChangeState_Consumer; // Mark sent
 		return;
 	}
+}
+
+// Boot or NKRO keyboard report, depending on the protocol
+static void usb_keyboard_keys( usb_packet_t *tx_packet )
+{
+	// Pointer to USB tx packet buffer
+	uint8_t *tx_buf = tx_packet->buf;
 
 	switch ( USBKeys_Protocol )
 	{
@@ -227,7 +194,7 @@ void usb_keyboard_send()
 
 		// Send USB Packet
 		usb_tx( KEYBOARD_ENDPOINT, tx_packet );
-		USBKeys_Changed = USBKeyChangeState_None;
+		USBKeys_Changed &= USBKeyChangeState_System | USBKeyChangeState_Consumer; // Mark sent
 		break;
 
 	// Send NKRO keyboard interrupts packet(s)
@@ -286,13 +253,63 @@ void usb_keyboard_send()
 
 			// Send USB Packet
 			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
-			USBKeys_Changed = USBKeyChangeState_None; // Mark sent
+			USBKeys_Changed &= USBKeyChangeState_System | USBKeyChangeState_Consumer; // Mark sent
 		}
 
 		break;
 	}
+}
+
+// Sends at most one report per endpoint per USB frame, does not wait for room on the endpoint
+// Changes that could not be sent remain in USBKeys_Changed, call again (i.e. next Output_send)
+void usb_keyboard_send()
+{
+	usb_packet_t *tx_packet;
+	uint32_t frame = usb_frame_count;
+
+	if ( !usb_configuration )
+	{
+		erro_print("USB not configured...");
+		return;
+	}
 
-	return;
+	// Try to wake up the host if it's asleep
+	if ( usb_resume() )
+	{
+		// Drop packet
+		USBKeys_Changed = USBKeyChangeState_None;
+		return;
+	}
+
+	// System Control and Consumer Control reports share an endpoint
+	if ( USBKeys_Changed & ( USBKeyChangeState_System | USBKeyChangeState_Consumer ) && sys_ctrl_frame != frame )
+	{
+		tx_packet = usb_keyboard_packet( SYS_CTRL_ENDPOINT );
+		if ( !tx_packet )
+		{
+			usb_keyboard_timeout();
+			return;
+		}
+		usb_keyboard_sysCtrl( tx_packet );
+		sys_ctrl_frame = frame;
+	}
+
+	// Keyboard report
+	uint8_t keys = USBKeys_Changed & ~( USBKeyChangeState_System | USBKeyChangeState_Consumer );
+	if ( keys && keyboard_frame != frame )
+	{
+		tx_packet = usb_keyboard_packet( USBKeys_Protocol == 0 ? KEYBOARD_ENDPOINT : NKRO_KEYBOARD_ENDPOINT );
+		if ( !tx_packet )
+		{
+			usb_keyboard_timeout();
+			return;
+		}
+		usb_keyboard_keys( tx_packet );
+		keyboard_frame = frame;
+	}
+
+	transmit_previous_timeout = 0;
+	transmit_waiting = 0;
 }
 
 #endif
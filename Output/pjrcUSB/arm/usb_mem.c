@@ -46,6 +46,12 @@ __attribute__ ((section(".usbbuffers"), used))
 unsigned char usb_buffer_memory[ NUM_USB_BUFFERS * sizeof(usb_packet_t) ];
 
 static uint32_t usb_buffer_available = 0xFFFFFFFF;
+static uint8_t  usb_buffer_free = NUM_USB_BUFFERS;
+
+// Pool statistics
+uint8_t  usb_buffer_high_water    = 0; // Most buffers in use at once
+uint32_t usb_malloc_failed        = 0; // usb_malloc calls refused, pool down to the report reserve
+uint32_t usb_malloc_report_failed = 0; // usb_malloc_report calls with no buffer left
 
 
 
@@ -65,21 +71,26 @@ extern uint8_t usb_rx_memory_needed;
 // http://gcc.gnu.org/ml/gcc/2012-06/msg00015.html
 // __builtin_clz()
 
-usb_packet_t *usb_malloc()
+// Takes a buffer, as long as more than reserve buffers are left
+static usb_packet_t *usb_malloc_reserve( uint8_t reserve, uint32_t *failed )
 {
 	unsigned int n, avail;
 	uint8_t *p;
 
 	__disable_irq();
-	avail = usb_buffer_available;
-	n = __builtin_clz( avail ); // clz = count leading zeros
-	if ( n >= NUM_USB_BUFFERS )
+	if ( usb_buffer_free <= reserve )
 	{
+		(*failed)++;
 		__enable_irq();
 		return NULL;
 	}
 
+	avail = usb_buffer_available;
+	n = __builtin_clz( avail ); // clz = count leading zeros
 	usb_buffer_available = avail & ~(0x80000000 >> n);
+	usb_buffer_free--;
+	if ( NUM_USB_BUFFERS - usb_buffer_free > usb_buffer_high_water )
+		usb_buffer_high_water = NUM_USB_BUFFERS - usb_buffer_free;
 	__enable_irq();
 	p = usb_buffer_memory + ( n * sizeof(usb_packet_t) );
 	*(uint32_t *)p = 0;
@@ -88,6 +99,28 @@ usb_packet_t *usb_malloc()
 }
 
 
+// General purpose buffer (serial, rawio, receive endpoints)
+// The last NUM_USB_REPORT_BUFFERS are left for HID reports, so serial output cannot starve them
+usb_packet_t *usb_malloc()
+{
+	return usb_malloc_reserve( NUM_USB_REPORT_BUFFERS, &usb_malloc_failed );
+}
+
+
+// HID report buffer (keyboard, mouse), may use any free buffer
+usb_packet_t *usb_malloc_report()
+{
+	return usb_malloc_reserve( 0, &usb_malloc_report_failed );
+}
+
+
+// Number of buffers currently free
+uint8_t usb_malloc_free()
+{
+	return usb_buffer_free;
+}
+
+
 void usb_free( usb_packet_t *p )
 {
 	unsigned int n, mask;
@@ -98,7 +131,8 @@ void usb_free( usb_packet_t *p )
 
 	// if any endpoints are starving for memory to receive
 	// packets, give this memory to them immediately!
-	if ( usb_rx_memory_needed && usb_configuration )
+	// Unless the report reserve is short, receive endpoints only get general purpose buffers
+	if ( usb_rx_memory_needed && usb_configuration && usb_buffer_free >= NUM_USB_REPORT_BUFFERS )
 	{
 		usb_rx_memory( p );
 		return;
@@ -107,6 +141,7 @@ void usb_free( usb_packet_t *p )
 	mask = (0x80000000 >> n);
 	__disable_irq();
 	usb_buffer_available |= mask;
+	usb_buffer_free++;
 	__enable_irq();
 }
 
@@ -49,8 +49,18 @@ typedef struct usb_packet_struct {
 
 
 
+// ----- Variables -----
+
+extern uint8_t  usb_buffer_high_water;
+extern uint32_t usb_malloc_failed;
+extern uint32_t usb_malloc_report_failed;
+
+
+
 // ----- Functions -----
 
 usb_packet_t *usb_malloc();
+usb_packet_t *usb_malloc_report();
+uint8_t usb_malloc_free();
 void usb_free( usb_packet_t *p );
 
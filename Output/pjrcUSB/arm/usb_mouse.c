@@ -157,7 +157,7 @@ void usb_mouse_send()
                 // Attempt to acquire a USB packet for the mouse endpoint
                 if ( usb_tx_packet_count( MOUSE_ENDPOINT ) < TX_PACKET_LIMIT )
                 {
-                        tx_packet = usb_malloc();
+                        tx_packet = usb_malloc_report();
                         if ( tx_packet )
                                 break;
                 }
@@ -213,7 +213,7 @@ int usb_mouse_move(int8_t x, int8_t y, int8_t wheel)
                         return -1;
                 }
                 if (usb_tx_packet_count(MOUSE_ENDPOINT) < TX_PACKET_LIMIT) {
-                        tx_packet = usb_malloc();
+                        tx_packet = usb_malloc_report();
                         if (tx_packet) break;
                 }
                 if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
@@ -248,7 +248,7 @@ int usb_mouse_position(uint16_t x, uint16_t y)
                         return -1;
                 }
                 if (usb_tx_packet_count(MOUSE_ENDPOINT) < TX_PACKET_LIMIT) {
-                        tx_packet = usb_malloc();
+                        tx_packet = usb_malloc_report();
                         if (tx_packet) break;
                 }
                 if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
@@ -217,60 +217,101 @@ int usb_serial_putchar( uint8_t c )
 	return usb_serial_write( &c, 1 );
 }
 
-int usb_serial_write( const void *buffer, uint32_t size )
+// Returns the free space of the current transmit packet, allocating a packet if needed
+// size is the number of bytes wanted, it is set to the number of bytes that fit (at most one packet)
+// Bytes written are sent with usb_serial_commit, returns NULL on error
+uint8_t *usb_serial_reserve( uint32_t *size )
 {
 	uint32_t len;
 	uint32_t wait_count;
-	const uint8_t *src = (const uint8_t *)buffer;
-	uint8_t *dest;
 
 	tx_noautoflush = 1;
-	while ( size > 0 )
+	if ( !tx_packet )
 	{
-		if ( !tx_packet )
+		wait_count = 0;
+		while ( 1 )
 		{
-			wait_count = 0;
-			while ( 1 )
+			if ( !usb_configuration )
 			{
-				if ( !usb_configuration )
-				{
-					tx_noautoflush = 0;
-					return -1;
-				}
-				if ( usb_tx_packet_count( CDC_TX_ENDPOINT ) < TX_PACKET_LIMIT )
-				{
-					tx_noautoflush = 1;
-					tx_packet = usb_malloc();
-					if ( tx_packet )
-						break;
-					tx_noautoflush = 0;
-				}
-				if ( ++wait_count > TX_TIMEOUT || transmit_previous_timeout )
-				{
-					transmit_previous_timeout = 1;
-					return -1;
-				}
-				yield();
+				tx_noautoflush = 0;
+				return NULL;
 			}
+			if ( usb_tx_packet_count( CDC_TX_ENDPOINT ) < TX_PACKET_LIMIT )
+			{
+				tx_noautoflush = 1;
+				tx_packet = usb_malloc();
+				if ( tx_packet )
+					break;
+				tx_noautoflush = 0;
+			}
+			if ( ++wait_count > TX_TIMEOUT || transmit_previous_timeout )
+			{
+				transmit_previous_timeout = 1;
+				return NULL;
+			}
+			yield();
 		}
-		transmit_previous_timeout = 0;
-		len = CDC_TX_SIZE - tx_packet->index;
-		if ( len > size )
-			len = size;
-		dest = tx_packet->buf + tx_packet->index;
-		tx_packet->index += len;
-		size -= len;
-		while ( len-- > 0 )
-			*dest++ = *src++;
-		if ( tx_packet->index >= CDC_TX_SIZE )
-		{
-			tx_packet->len = CDC_TX_SIZE;
-			usb_tx( CDC_TX_ENDPOINT, tx_packet );
-			tx_packet = NULL;
-		}
-		usb_cdc_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
 	}
+	transmit_previous_timeout = 0;
+
+	len = CDC_TX_SIZE - tx_packet->index;
+	if ( *size > len )
+		*size = len;
+	return tx_packet->buf + tx_packet->index;
+}
+
+// Adds size bytes, written to the space returned by usb_serial_reserve, to the transmit packet
+void usb_serial_commit( uint32_t size )
+{
+	tx_packet->index += size;
+	if ( tx_packet->index >= CDC_TX_SIZE )
+	{
+		tx_packet->len = CDC_TX_SIZE;
+		usb_tx( CDC_TX_ENDPOINT, tx_packet );
+		tx_packet = NULL;
+	}
+	usb_cdc_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
 	tx_noautoflush = 0;
+}
+
+int usb_serial_write( const void *buffer, uint32_t size )
+{
+	uint32_t len;
+	const uint8_t *src = (const uint8_t *)buffer;
+	uint8_t *dest;
+
+	while ( size > 0 )
+	{
+		len = size;
+		dest = usb_serial_reserve( &len );
+		if ( !dest )
+			return -1;
+		memcpy( dest, src, len );
+		usb_serial_commit( len );
+		src += len;
+		size -= len;
+	}
+	return 0;
+}
+
+// Null terminated string, copied straight into the transmit packets (no separate length pass)
+int usb_serial_write_str( const char *str )
+{
+	uint32_t len;
+	uint32_t pos;
+	uint8_t *dest;
+
+	while ( *str )
+	{
+		len = CDC_TX_SIZE;
+		dest = usb_serial_reserve( &len );
+		if ( !dest )
+			return -1;
+		for ( pos = 0; pos < len && str[ pos ]; pos++ )
+			dest[ pos ] = str[ pos ];
+		usb_serial_commit( pos );
+		str += pos;
+	}
 	return 0;
 }
 
@@ -95,6 +95,11 @@ int usb_serial_peekchar();
 int usb_serial_putchar( uint8_t c );
 int usb_serial_read( void *buffer, uint32_t size );
 int usb_serial_write( const void *buffer, uint32_t size );
+int usb_serial_write_str( const char *str );
+
+// In place writes, see usb_serial_reserve
+uint8_t *usb_serial_reserve( uint32_t *size );
+void usb_serial_commit( uint32_t size );
 
 void usb_serial_flush_input();
 void usb_serial_flush_output();
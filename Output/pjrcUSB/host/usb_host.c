@@ -0,0 +1,243 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Project Includes
+#include <Lib/OutputLib.h>
+#include <print.h>
+
+// Local Includes
+#include "usb_host.h"
+
+
+
+// ----- Variables -----
+
+volatile uint8_t usb_configuration = 0;
+
+uint8_t  usb_host_report[ USB_HOST_REPORT_SIZE ];
+uint8_t  usb_host_report_len = 0;
+uint32_t usb_host_report_count = 0;
+
+// Single character lookahead for usb_serial_available
+static int usb_host_peek = -1;
+
+// Terminal settings restored on exit
+static struct termios usb_host_termios;
+static uint8_t usb_host_termios_saved = 0;
+
+// Bus current is announced once the other modules are setup
+static uint8_t usb_host_current_pending = 0;
+
+
+
+// ----- Functions -----
+
+static void usb_host_restore_terminal()
+{
+	if ( usb_host_termios_saved )
+		tcsetattr( STDIN_FILENO, TCSANOW, &usb_host_termios );
+}
+
+
+// "Enumerates" immediately, stdin/stdout act as the virtual serial port
+uint8_t usb_init()
+{
+	USBInit_TimeStart = systick_millis_count;
+
+	// Character at a time input, the CLI does its own echo
+	if ( isatty( STDIN_FILENO ) && tcgetattr( STDIN_FILENO, &usb_host_termios ) == 0 )
+	{
+		struct termios raw = usb_host_termios;
+		raw.c_lflag &= ~( ICANON | ECHO );
+		tcsetattr( STDIN_FILENO, TCSANOW, &raw );
+		usb_host_termios_saved = 1;
+		atexit( usb_host_restore_terminal );
+	}
+	fcntl( STDIN_FILENO, F_SETFL, fcntl( STDIN_FILENO, F_GETFL ) | O_NONBLOCK );
+
+	usb_configuration = 1;
+	Output_Available = 1;
+	USBInit_TimeEnd = systick_millis_count;
+	USBInit_Ticks++;
+	usb_host_current_pending = 1;
+
+	return 1;
+}
+
+uint8_t usb_configured()
+{
+	return usb_configuration;
+}
+
+
+// No bootloader to jump to
+void usb_device_reload()
+{
+	warn_print("Firmware reload is not available on host builds");
+}
+
+// Announces the (fixed) 500 mA bus current on the first Output_send
+void usb_device_check()
+{
+	if ( usb_host_current_pending )
+	{
+		usb_host_current_pending = 0;
+		Output_update_usb_current( 500 );
+	}
+}
+
+void usb_device_software_reset()
+{
+	exit( 0 );
+}
+
+
+// Captures the next pending keyboard report (same layout as arm/usb_keyboard.c)
+void usb_keyboard_send()
+{
+	uint8_t *tx_buf = usb_host_report;
+
+	// System control keys
+	if ( USBKeys_Changed & USBKeyChangeState_System )
+	{
+		*tx_buf++ = 0x02; // ID
+		*tx_buf   = USBKeys_SysCtrl;
+		usb_host_report_len = 2;
+		usb_host_report_count++;
+		USBKeys_Changed &= ~USBKeyChangeState_System; // Mark sent
+		return;
+	}
+
+	// Consumer control keys
+	if ( USBKeys_Changed & USBKeyChangeState_Consumer )
+	{
+		*tx_buf++ = 0x03; // ID
+		*tx_buf++ = (uint8_t)(USBKeys_ConsCtrl & 0x00FF);
+		*tx_buf   = (uint8_t)(USBKeys_ConsCtrl >> 8);
+		usb_host_report_len = 3;
+		usb_host_report_count++;
+		USBKeys_Changed &= ~USBKeyChangeState_Consumer; // Mark sent
+		return;
+	}
+
+	switch ( USBKeys_Protocol )
+	{
+	// Boot Mode
+	case 0:
+		*tx_buf++ = USBKeys_Modifiers;
+		*tx_buf++ = 0;
+		memcpy( tx_buf, USBKeys_Keys, USB_BOOT_MAX_KEYS );
+		usb_host_report_len = 8;
+		break;
+
+	// NKRO Mode
+	case 1:
+		*tx_buf++ = 0x01; // ID
+		*tx_buf++ = USBKeys_Modifiers;
+		memcpy( tx_buf, USBKeys_Keys, USB_NKRO_BITFIELD_SIZE_KEYS );
+		usb_host_report_len = 2 + USB_NKRO_BITFIELD_SIZE_KEYS;
+		break;
+	}
+
+	if ( Output_DebugMode )
+	{
+		dbug_msg("Host USB: ");
+		for ( uint8_t c = 0; c < usb_host_report_len; c++ )
+			printHex_op( usb_host_report[ c ], 2 );
+		print( NL );
+	}
+
+	usb_host_report_count++;
+	USBKeys_Changed = USBKeyChangeState_None; // Mark sent
+}
+
+void usb_mouse_send()
+{
+	USBMouse_Changed = USBMouseChangeState_None;
+}
+
+
+// Virtual serial port
+int usb_serial_available()
+{
+	if ( usb_host_peek < 0 )
+	{
+		uint8_t c;
+		if ( read( STDIN_FILENO, &c, 1 ) == 1 )
+			usb_host_peek = c;
+	}
+
+	return usb_host_peek < 0 ? 0 : 1;
+}
+
+int usb_serial_getchar()
+{
+	if ( !usb_serial_available() )
+		return -1;
+
+	int c = usb_host_peek;
+	usb_host_peek = -1;
+	return c;
+}
+
+int usb_serial_putchar( uint8_t c )
+{
+	return usb_serial_write( &c, 1 );
+}
+
+int usb_serial_write( const void *buffer, uint32_t size )
+{
+	if ( write( STDOUT_FILENO, buffer, size ) < 0 )
+		return -1;
+	return 0;
+}
+
+int usb_serial_write_str( const char *str )
+{
+	return usb_serial_write( str, strlen( str ) );
+}
+
+
+// RawIO is not connected to anything
+uint32_t usb_rawio_available()
+{
+	return 0;
+}
+
+int32_t usb_rawio_rx( void *buf, uint32_t timeout )
+{
+	return 0;
+}
+
+int32_t usb_rawio_tx( const void *buf, uint32_t timeout )
+{
+	return 0;
+}
+
@@ -0,0 +1,77 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Host USB shim
+// Stands in for the arm/ USB stack on native host builds.
+// The virtual serial port is mapped to stdin/stdout, HID reports are captured in memory.
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <inttypes.h>
+
+// Local Includes
+#include <output_com.h>
+
+
+
+// ----- Defines -----
+
+// Largest HID report generated (NKRO)
+#define USB_HOST_REPORT_SIZE 32
+
+
+
+// ----- Variables -----
+
+extern volatile uint8_t usb_configuration;
+
+// Last keyboard/system/consumer report "sent" and number of reports sent
+extern uint8_t  usb_host_report[ USB_HOST_REPORT_SIZE ];
+extern uint8_t  usb_host_report_len;
+extern uint32_t usb_host_report_count;
+
+
+
+// ----- Functions -----
+
+uint8_t usb_init();
+uint8_t usb_configured();
+
+void usb_device_reload();
+void usb_device_check();
+void usb_device_software_reset();
+
+void usb_keyboard_send();
+void usb_mouse_send();
+
+int usb_serial_available();
+int usb_serial_getchar();
+int usb_serial_putchar( uint8_t c );
+int usb_serial_write( const void *buffer, uint32_t size );
+int usb_serial_write_str( const char *str );
+
+uint32_t usb_rawio_available();
+int32_t  usb_rawio_rx( void *buf, uint32_t timeout );
+int32_t  usb_rawio_tx( const void *buf, uint32_t timeout );
+
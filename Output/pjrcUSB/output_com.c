@@ -27,6 +27,7 @@
 // Project Includes
 #include <cli.h>
 #include <led.h>
+#include <perf.h>
 #include <print.h>
 #include <scan_loop.h>
 
@@ -38,6 +39,8 @@
 #include "arm/usb_keyboard.h"
 #include "arm/usb_serial.h"
 #include "arm/usb_mouse.h"
+#elif defined(_host_)
+#include "host/usb_host.h"
 #endif
 
 // KLL
@@ -51,27 +54,34 @@
 
 // ----- Macros -----
 
-// Used to build a bitmap lookup table from a byte addressable array
+#if defined(_host_)
+// Switch based NKRO lookup that USBKeys_NKROTable replaced, see nkroBench
 #define byteLookup( byte ) \
-	case (( byte ) * ( 8 )):         bytePosition = byte; byteShift = 0; break; \
-	case (( byte ) * ( 8 ) + ( 1 )): bytePosition = byte; byteShift = 1; break; \
-	case (( byte ) * ( 8 ) + ( 2 )): bytePosition = byte; byteShift = 2; break; \
-	case (( byte ) * ( 8 ) + ( 3 )): bytePosition = byte; byteShift = 3; break; \
-	case (( byte ) * ( 8 ) + ( 4 )): bytePosition = byte; byteShift = 4; break; \
-	case (( byte ) * ( 8 ) + ( 5 )): bytePosition = byte; byteShift = 5; break; \
-	case (( byte ) * ( 8 ) + ( 6 )): bytePosition = byte; byteShift = 6; break; \
-	case (( byte ) * ( 8 ) + ( 7 )): bytePosition = byte; byteShift = 7; break
+	case (( byte ) * ( 8 )):         *bytePosition = byte; *byteShift = 0; break; \
+	case (( byte ) * ( 8 ) + ( 1 )): *bytePosition = byte; *byteShift = 1; break; \
+	case (( byte ) * ( 8 ) + ( 2 )): *bytePosition = byte; *byteShift = 2; break; \
+	case (( byte ) * ( 8 ) + ( 3 )): *bytePosition = byte; *byteShift = 3; break; \
+	case (( byte ) * ( 8 ) + ( 4 )): *bytePosition = byte; *byteShift = 4; break; \
+	case (( byte ) * ( 8 ) + ( 5 )): *bytePosition = byte; *byteShift = 5; break; \
+	case (( byte ) * ( 8 ) + ( 6 )): *bytePosition = byte; *byteShift = 6; break; \
+	case (( byte ) * ( 8 ) + ( 7 )): *bytePosition = byte; *byteShift = 7; break
+#endif
 
 
 
 // ----- Function Declarations -----
 
 void cliFunc_kbdProtocol( char* args );
+void cliFunc_latency    ( char* args );
+#if defined(_host_)
+void cliFunc_nkroBench  ( char* args );
+#endif
 void cliFunc_outputDebug( char* args );
 void cliFunc_readLEDs   ( char* args );
 void cliFunc_sendKeys   ( char* args );
 void cliFunc_setKeys    ( char* args );
 void cliFunc_setMod     ( char* args );
+void cliFunc_usbBuffers ( char* args );
 void cliFunc_usbInitTime( char* args );
 
 
@@ -80,20 +90,38 @@ void cliFunc_usbInitTime( char* args );
 
 // Output Module command dictionary
 CLIDict_Entry( kbdProtocol, "Keyboard Protocol Mode: 0 - Boot, 1 - OS/NKRO Mode" );
+#if defined(Output_LatencyStats)
+CLIDict_Entry( latency,     "Key transition to USB report latency (us), per stage and as a histogram." NL "\t\tIf argument \033[35mr\033[0m is given, resets the statistics." );
+#endif
+#if defined(_host_)
+CLIDict_Entry( nkroBench,   "Checks USBKeys_NKROTable against the old switch lookup for every USB Code, then times" NL "\t\tN bursts of 6/12/24/48 simultaneous keys with both, see perf. Defaults to 1000 bursts. Host builds only." );
+#endif
 CLIDict_Entry( outputDebug, "Toggle Output Debug mode." );
 CLIDict_Entry( readLEDs,    "Read LED byte:" NL "\t\t1 NumLck, 2 CapsLck, 4 ScrlLck, 16 Kana, etc." );
 CLIDict_Entry( sendKeys,    "Send the prepared list of USB codes and modifier byte." );
 CLIDict_Entry( setKeys,     "Prepare a space separated list of USB codes (decimal). Waits until \033[35msendKeys\033[0m." );
 CLIDict_Entry( setMod,      "Set the modfier byte:" NL "\t\t1 LCtrl, 2 LShft, 4 LAlt, 8 LGUI, 16 RCtrl, 32 RShft, 64 RAlt, 128 RGUI" );
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+CLIDict_Entry( usbBuffers,  "Displays USB packet buffer usage: free, high-water mark and failed allocations." );
+#endif
 CLIDict_Entry( usbInitTime, "Displays the time in ms from usb_init() till the last setup call." );
 
 CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( kbdProtocol ),
+#if defined(Output_LatencyStats)
+	CLIDict_Item( latency ),
+#endif
+#if defined(_host_)
+	CLIDict_Item( nkroBench ),
+#endif
 	CLIDict_Item( outputDebug ),
 	CLIDict_Item( readLEDs ),
 	CLIDict_Item( sendKeys ),
 	CLIDict_Item( setKeys ),
 	CLIDict_Item( setMod ),
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+	CLIDict_Item( usbBuffers ),
+#endif
 	CLIDict_Item( usbInitTime ),
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
@@ -136,6 +164,17 @@ volatile uint8_t  USBKeys_Protocol = USBProtocol_define;
 // OS only needs update if there has been a change in state
 USBKeyChangeState USBKeys_Changed = USBKeyChangeState_None;
 
+#if defined(_host_)
+// Burst encoding timed by nkroBench, see the perf command
+PerfCounter Output_nkroPerf[8];
+const char *const Output_nkroPerfLabels[] = {
+	"Switch x6",  "Table x6",
+	"Switch x12", "Table x12",
+	"Switch x24", "Table x24",
+	"Switch x48", "Table x48",
+};
+#endif
+
 // Indicate if USB should send update
 USBMouseChangeState USBMouse_Changed = 0;
 
@@ -358,13 +397,7 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 
 	// Depending on which mode the keyboard is in, USBKeys_Keys array is used differently
 	// Boot mode - Maximum of 6 byte codes
-	// NKRO mode - Each bit of the 26 byte corresponds to a key
-	//  Bits   0 -  45 (bytes  0 -  5) correspond to USB Codes   4 -  49 (Main)
-	//  Bits  48 - 161 (bytes  6 - 20) correspond to USB Codes  51 - 164 (Secondary)
-	//  Bits 168 - 213 (bytes 21 - 26) correspond to USB Codes 176 - 221 (Tertiary)
-	//  Bits 214 - 216                 unused
-	uint8_t bytePosition = 0;
-	uint8_t byteShift = 0;
+	// NKRO mode - Each bit of the 27 bytes corresponds to a key (see USBKeys_NKROTable)
 
 	switch ( USBKeys_Protocol )
 	{
@@ -444,78 +477,10 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 			USBKeys_Changed |= USBKeyChangeState_Modifiers;
 			break;
 		}
-		// First 6 bytes
-		else if ( key >= 4 && key <= 49 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 0th position, each byte has 8 bits, starting at 4th bit
-			uint8_t keyPos = key + (0 * 8 - 4); // Starting position in array, Ignoring 4 keys
-			switch ( keyPos )
-			{
-				byteLookup( 0 );
-				byteLookup( 1 );
-				byteLookup( 2 );
-				byteLookup( 3 );
-				byteLookup( 4 );
-				byteLookup( 5 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_MainKeys;
-		}
-		// Next 14 bytes
-		else if ( key >= 51 && key <= 155 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 6th byte position, each byte has 8 bits, starting at 51st bit
-			uint8_t keyPos = key + (6 * 8 - 51); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 6 );
-				byteLookup( 7 );
-				byteLookup( 8 );
-				byteLookup( 9 );
-				byteLookup( 10 );
-				byteLookup( 11 );
-				byteLookup( 12 );
-				byteLookup( 13 );
-				byteLookup( 14 );
-				byteLookup( 15 );
-				byteLookup( 16 );
-				byteLookup( 17 );
-				byteLookup( 18 );
-				byteLookup( 19 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_SecondaryKeys;
-		}
-		// Next byte
-		else if ( key >= 157 && key <= 164 )
+		// Keys with a bit in the NKRO bitfield
+		else if ( USBKeys_NKROTable[ key ].mask )
 		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (20 * 8 - 157); // Starting position in array, Ignoring 6 keys
-			switch ( keyPos )
-			{
-				byteLookup( 20 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_TertiaryKeys;
-		}
-		// Last 6 bytes
-		else if ( key >= 176 && key <= 221 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (21 * 8 - 176); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 21 );
-				byteLookup( 22 );
-				byteLookup( 23 );
-				byteLookup( 24 );
-				byteLookup( 25 );
-				byteLookup( 26 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_QuartiaryKeys;
+			USBKeys_Changed |= USBKeys_NKROTable[ key ].changed;
 		}
 		// Received 0x00
 		// This is a special USB Code that internally indicates a "break"
@@ -540,12 +505,12 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 		// Set/Unset
 		if ( keyPress )
 		{
-			USBKeys_Keys[bytePosition] |= (1 << byteShift);
+			USBKeys_Keys[ USBKeys_NKROTable[ key ].byte ] |= USBKeys_NKROTable[ key ].mask;
 			USBKeys_Sent--;
 		}
 		else // Release
 		{
-			USBKeys_Keys[bytePosition] &= ~(1 << byteShift);
+			USBKeys_Keys[ USBKeys_NKROTable[ key ].byte ] &= ~USBKeys_NKROTable[ key ].mask;
 			USBKeys_Sent++;
 		}
 
@@ -660,6 +625,10 @@ inline void Output_setup()
 	// Register USB Output CLI dictionary
 	CLI_registerDictionary( outputCLIDict, outputCLIDictName );
 
+#if defined(_host_)
+	Perf_registerGroup( "NKRO Encode", Output_nkroPerfLabels, Output_nkroPerf, 8 );
+#endif
+
 	// Flush key buffers
 	Output_flushBuffers();
 }
@@ -701,10 +670,17 @@ inline void Output_send()
 		}
 	}
 
-	// Send keypresses while there are pending changes
-	while ( USBKeys_Changed )
+	// Send pending changes, at most one report per endpoint per USB frame
+	// Anything that could not be sent yet stays in USBKeys_Changed for the next call
+	if ( USBKeys_Changed )
 		usb_keyboard_send();
 
+#if defined(Output_LatencyStats)
+	// Everything pending was queued, time the oldest transition it carried
+	if ( !USBKeys_Changed )
+		Output_latencySent();
+#endif
+
 	// Signal Scan Module we are finished
 	switch ( USBKeys_Protocol )
 	{
@@ -766,14 +742,16 @@ inline int Output_putstr( char* str )
 #if enableVirtualSerialPort_define == 1
 #if defined(_at90usb162_) || defined(_atmega32u4_) || defined(_at90usb646_) || defined(_at90usb1286_) // AVR
 	uint16_t count = 0;
-#elif defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) // ARM
-	uint32_t count = 0;
-#endif
+
 	// Count characters until NULL character, then send the amount counted
 	while ( str[count] != '\0' )
 		count++;
 
 	return usb_serial_write( str, count );
+#elif defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) || defined(_host_) // ARM
+	// Copied directly into the USB packets
+	return usb_serial_write_str( str );
+#endif
 #else
 	return 0;
 #endif
@@ -891,6 +869,86 @@ unsigned int Output_current_available()
 }
 
 
+#if defined(_host_)
+// NKRO bitfield position of a USB Code, found the way Output_usbCodeSend_capability did before USBKeys_NKROTable
+// Returns the USBKeyChangeState of the report section, 0 if the USB Code has no bit
+uint8_t Output_nkroSwitch( uint8_t key, uint8_t *bytePosition, uint8_t *byteShift )
+{
+	// First 6 bytes
+	if ( key >= 4 && key <= 49 )
+	{
+		// Starting at 0th position, each byte has 8 bits, starting at 4th bit
+		uint8_t keyPos = key + (0 * 8 - 4); // Starting position in array, Ignoring 4 keys
+		switch ( keyPos )
+		{
+			byteLookup( 0 );
+			byteLookup( 1 );
+			byteLookup( 2 );
+			byteLookup( 3 );
+			byteLookup( 4 );
+			byteLookup( 5 );
+		}
+
+		return USBKeyChangeState_MainKeys;
+	}
+	// Next 14 bytes
+	else if ( key >= 51 && key <= 155 )
+	{
+		// Starting at 6th byte position, each byte has 8 bits, starting at 51st bit
+		uint8_t keyPos = key + (6 * 8 - 51); // Starting position in array
+		switch ( keyPos )
+		{
+			byteLookup( 6 );
+			byteLookup( 7 );
+			byteLookup( 8 );
+			byteLookup( 9 );
+			byteLookup( 10 );
+			byteLookup( 11 );
+			byteLookup( 12 );
+			byteLookup( 13 );
+			byteLookup( 14 );
+			byteLookup( 15 );
+			byteLookup( 16 );
+			byteLookup( 17 );
+			byteLookup( 18 );
+			byteLookup( 19 );
+		}
+
+		return USBKeyChangeState_SecondaryKeys;
+	}
+	// Next byte
+	else if ( key >= 157 && key <= 164 )
+	{
+		uint8_t keyPos = key + (20 * 8 - 157); // Starting position in array, Ignoring 6 keys
+		switch ( keyPos )
+		{
+			byteLookup( 20 );
+		}
+
+		return USBKeyChangeState_TertiaryKeys;
+	}
+	// Last 6 bytes
+	else if ( key >= 176 && key <= 221 )
+	{
+		uint8_t keyPos = key + (21 * 8 - 176); // Starting position in array
+		switch ( keyPos )
+		{
+			byteLookup( 21 );
+			byteLookup( 22 );
+			byteLookup( 23 );
+			byteLookup( 24 );
+			byteLookup( 25 );
+			byteLookup( 26 );
+		}
+
+		return USBKeyChangeState_QuartiaryKeys;
+	}
+
+	return 0;
+}
+#endif
+
+
 
 // ----- CLI Command Functions -----
 
@@ -924,6 +982,137 @@ void cliFunc_kbdProtocol( char* args )
 }
 
 
+#if defined(_host_)
+void cliFunc_nkroBench( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Number of bursts (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	unsigned int bursts = arg1Ptr[0] == '\0' ? 1000 : numToInt( arg1Ptr );
+
+	print( NL );
+
+	// Every USB Code must give the same byte, bit and report section
+	// USB Codes with a bit are collected for the bursts
+	uint8_t keys[256];
+	uint16_t keysNum = 0;
+	uint16_t mismatches = 0;
+	for ( uint16_t key = 0; key < 256; key++ )
+	{
+		const USBKeys_NKROBit *bit = &USBKeys_NKROTable[ key ];
+		uint8_t bytePosition = 0;
+		uint8_t byteShift = 0;
+		uint8_t changed = Output_nkroSwitch( key, &bytePosition, &byteShift );
+
+		if ( changed != bit->changed
+			|| ( changed && ( bytePosition != bit->byte || ( 1 << byteShift ) != bit->mask ) )
+			|| ( !changed && bit->mask ) )
+		{
+			mismatches++;
+			continue;
+		}
+
+		if ( bit->mask )
+			keys[ keysNum++ ] = key;
+	}
+
+	info_msg("USB Codes: 256, with a bit ");
+	printInt16( keysNum );
+	print(", mismatched ");
+	printInt16( mismatches );
+	print( NL );
+
+	// Simultaneous keys (press, then release), pseudo-random so every run is the same
+	const uint8_t sizes[] = { 6, 12, 24, 48 };
+	uint32_t seed = 1;
+	uint16_t burstMismatches = 0;
+	memset( Output_nkroPerf, 0, sizeof( Output_nkroPerf ) );
+
+	for ( unsigned int burst = 0; burst < bursts; burst++ )
+	{
+		for ( uint8_t size = 0; size < sizeof( sizes ); size++ )
+		{
+			uint8_t burstKeys[48];
+			for ( uint8_t pos = 0; pos < sizes[ size ]; pos++ )
+			{
+				seed = seed * 1103515245 + 12345;
+				burstKeys[ pos ] = keys[ ( seed >> 16 ) % keysNum ];
+			}
+
+			uint8_t switchKeys[ USB_NKRO_BITFIELD_SIZE_KEYS ] = { 0 };
+			uint8_t tableKeys[ USB_NKRO_BITFIELD_SIZE_KEYS ] = { 0 };
+			uint8_t switchChanged = 0;
+			uint8_t tableChanged = 0;
+
+			Perf_start( cycles );
+			for ( uint8_t pos = 0; pos < sizes[ size ]; pos++ )
+			{
+				uint8_t bytePosition = 0;
+				uint8_t byteShift = 0;
+				switchChanged |= Output_nkroSwitch( burstKeys[ pos ], &bytePosition, &byteShift );
+				switchKeys[ bytePosition ] |= 1 << byteShift;
+			}
+			for ( uint8_t pos = 0; pos < sizes[ size ]; pos++ )
+			{
+				uint8_t bytePosition = 0;
+				uint8_t byteShift = 0;
+				Output_nkroSwitch( burstKeys[ pos ], &bytePosition, &byteShift );
+				switchKeys[ bytePosition ] &= ~( 1 << byteShift );
+			}
+			Perf_lap( &Output_nkroPerf[ size * 2 ], cycles );
+
+			for ( uint8_t pos = 0; pos < sizes[ size ]; pos++ )
+			{
+				const USBKeys_NKROBit *bit = &USBKeys_NKROTable[ burstKeys[ pos ] ];
+				tableChanged |= bit->changed;
+				tableKeys[ bit->byte ] |= bit->mask;
+			}
+			for ( uint8_t pos = 0; pos < sizes[ size ]; pos++ )
+			{
+				const USBKeys_NKROBit *bit = &USBKeys_NKROTable[ burstKeys[ pos ] ];
+				tableKeys[ bit->byte ] &= ~bit->mask;
+			}
+			Perf_stop( &Output_nkroPerf[ size * 2 + 1 ], cycles );
+
+			if ( switchChanged != tableChanged || memcmp( switchKeys, tableKeys, sizeof( tableKeys ) ) != 0 )
+				burstMismatches++;
+		}
+	}
+
+	for ( uint8_t size = 0; size < sizeof( sizes ); size++ )
+	{
+		PerfCounter *switchPerf = &Output_nkroPerf[ size * 2 ];
+		PerfCounter *tablePerf = &Output_nkroPerf[ size * 2 + 1 ];
+
+		info_msg("");
+		printInt8( sizes[ size ] );
+		print(" keys: switch ");
+		printInt32( switchPerf->count ? switchPerf->total / switchPerf->count : 0 );
+		print(", table ");
+		printInt32( tablePerf->count ? tablePerf->total / tablePerf->count : 0 );
+		print(" cycles/burst (min ");
+		printInt32( switchPerf->min );
+		print("/");
+		printInt32( tablePerf->min );
+		print(")" NL );
+	}
+
+	if ( mismatches || burstMismatches )
+	{
+		erro_msg("NKRO check failed, mismatched bursts: ");
+		printInt16( burstMismatches );
+	}
+	else
+	{
+		info_msg("NKRO check passed");
+	}
+}
+#endif
+
 void cliFunc_outputDebug( char* args )
 {
 	// Parse number from argument
@@ -999,6 +1188,27 @@ void cliFunc_setMod( char* args )
 	USBKeys_ModifiersCLI = numToInt( arg1Ptr );
 }
 
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+void cliFunc_usbBuffers( char* args )
+{
+	print(NL);
+	info_msg("USB Buffers: ");
+	printInt8( usb_malloc_free() );
+	print(" free of ");
+	printInt8( NUM_USB_BUFFERS );
+	print(" (");
+	printInt8( NUM_USB_REPORT_BUFFERS );
+	print(" reserved for reports), high-water ");
+	printInt8( usb_buffer_high_water );
+	print(NL);
+	info_msg("Failed allocations: ");
+	printInt32( usb_malloc_failed );
+	print(" general, ");
+	printInt32( usb_malloc_report_failed );
+	print(" report");
+}
+#endif
+
 void cliFunc_usbInitTime( char* args )
 {
 	// Calculate overall USB initialization time
@@ -28,6 +28,7 @@
 
 // Local Includes
 #include <buildvars.h> // Defines USB Parameters, partially generated by CMake
+#include <kll_defs.h>
 
 
 
@@ -38,6 +39,11 @@
 #define USB_NKRO_BITFIELD_SIZE_KEYS 27
 #define USB_BOOT_MAX_KEYS 6
 
+// Latency statistics (see output_latency.c) are timed with micros(), which AVR builds do not have
+#if LatencyStats_define == 1 && !( defined(_at90usb162_) || defined(_atmega32u4_) || defined(_at90usb646_) || defined(_at90usb1286_) )
+#define Output_LatencyStats
+#endif
+
 
 
 // ----- Enumerations -----
@@ -67,6 +73,17 @@ typedef enum USBMouseChangeState {
 
 
 
+// ----- Structs -----
+
+// Location of a USB Code in the NKRO bitfield (USBKeys_Keys)
+typedef struct USBKeys_NKROBit {
+	uint8_t byte;    // Index into USBKeys_Keys
+	uint8_t mask;    // Bit within the byte, 0 if the USB Code has no bit
+	uint8_t changed; // USBKeyChangeState of the report section the byte belongs to
+} USBKeys_NKROBit;
+
+
+
 // ----- Variables -----
 
 // Variables used to communciate to the output module
@@ -91,6 +108,8 @@ extern          uint32_t USBKeys_Idle_Expiry;
 extern          uint8_t  USBKeys_Idle_Count; // AVR only
 
 extern USBKeyChangeState   USBKeys_Changed;
+
+extern const USBKeys_NKROBit USBKeys_NKROTable[256]; // Indexed by USB Code, see output_nkro.c
 extern USBMouseChangeState USBMouse_Changed;
 
 extern volatile uint8_t  Output_Available; // 0 - Output module not fully functional, 1 - Output module working
@@ -124,6 +143,9 @@ unsigned int Output_current_available();
 void Output_update_external_current( unsigned int current );
 void Output_update_usb_current( unsigned int current );
 
+void Output_latencyStamp( uint32_t changeTime, uint32_t decisionTime );
+void Output_latencySent();
+
 int Output_getchar();
 int Output_putchar( char c );
 int Output_putstr( char* str );
@@ -0,0 +1,191 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/OutputLib.h>
+
+// Project Includes
+#include <cli.h>
+#include <print.h>
+
+// Local Includes
+#include "output_com.h"
+
+#if defined(Output_LatencyStats)
+
+
+
+// ----- Defines -----
+
+// Histogram bucket N counts latencies below 2^(N + LatencyBucketShift) us
+// The last bucket also counts everything above it
+#define LatencyBucketShift 6
+#define LatencyBuckets     16
+
+
+
+// ----- Enumerations -----
+
+// Stages of a key transition, each one ends at the timestamp of the next
+typedef enum LatencyStage {
+	LatencyStage_Debounce, // Sense pin change -> Scan Module decision
+	LatencyStage_Macro,    // Scan Module decision -> USB buffers updated by Macro_process
+	LatencyStage_USB,      // USB buffers updated -> report queued on the endpoint
+	LatencyStage_Num,
+} LatencyStage;
+
+
+
+// ----- Variables -----
+
+// Oldest transition waiting for a report, only valid while Output_latencyPending is set
+static uint8_t  Output_latencyPending = 0;
+static uint32_t Output_latencyTime[ LatencyStage_Num ];
+
+// End-to-end latency histogram (sense pin change -> report queued)
+static uint32_t Output_latencyHistogram[ LatencyBuckets ];
+
+// Per stage statistics (us)
+static uint32_t Output_latencyStageSum[ LatencyStage_Num ];
+static uint32_t Output_latencyStageMax[ LatencyStage_Num ];
+static uint32_t Output_latencyCount = 0;
+
+
+
+// ----- Functions -----
+
+// Called by the Macro Module once a transition has updated the USB buffers
+// changeTime   - micros() when the sense pin change was first seen
+// decisionTime - micros() when the Scan Module decided on the new key state
+// Only the oldest transition is kept, later ones go out in the same (or an earlier) report
+void Output_latencyStamp( uint32_t changeTime, uint32_t decisionTime )
+{
+	if ( Output_latencyPending )
+		return;
+
+	Output_latencyTime[ LatencyStage_Debounce ] = changeTime;
+	Output_latencyTime[ LatencyStage_Macro ]    = decisionTime;
+	Output_latencyTime[ LatencyStage_USB ]      = micros();
+	Output_latencyPending = 1;
+}
+
+
+// Called by Output_send once all pending changes have been queued
+void Output_latencySent()
+{
+	if ( !Output_latencyPending )
+		return;
+	Output_latencyPending = 0;
+
+	uint32_t now = micros();
+
+	// Stage latencies
+	for ( uint8_t stage = 0; stage < LatencyStage_Num; stage++ )
+	{
+		uint32_t end = stage + 1 < LatencyStage_Num ? Output_latencyTime[ stage + 1 ] : now;
+		uint32_t time = end - Output_latencyTime[ stage ];
+
+		Output_latencyStageSum[ stage ] += time;
+		if ( time > Output_latencyStageMax[ stage ] )
+			Output_latencyStageMax[ stage ] = time;
+	}
+
+	// End-to-end latency
+	uint32_t total = ( now - Output_latencyTime[ LatencyStage_Debounce ] ) >> LatencyBucketShift;
+	uint8_t bucket = total ? 32 - __builtin_clz( total ) : 0;
+	if ( bucket >= LatencyBuckets )
+		bucket = LatencyBuckets - 1;
+
+	Output_latencyHistogram[ bucket ]++;
+	Output_latencyCount++;
+}
+
+
+// Clears the histogram and stage statistics
+static void Output_latencyReset()
+{
+	Output_latencyPending = 0;
+	Output_latencyCount = 0;
+
+	for ( uint8_t bucket = 0; bucket < LatencyBuckets; bucket++ )
+		Output_latencyHistogram[ bucket ] = 0;
+
+	for ( uint8_t stage = 0; stage < LatencyStage_Num; stage++ )
+	{
+		Output_latencyStageSum[ stage ] = 0;
+		Output_latencyStageMax[ stage ] = 0;
+	}
+}
+
+
+
+// ----- CLI Command Functions -----
+
+void cliFunc_latency( char* args )
+{
+	// Parse number from argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Reset statistics
+	if ( *arg1Ptr == 'r' )
+	{
+		Output_latencyReset();
+		return;
+	}
+
+	print( NL );
+	info_msg("Transitions: ");
+	printInt32( Output_latencyCount );
+
+	// Average and worst case for each stage
+	const char *stageNames[] = { "Debounce", "Macro   ", "USB     " };
+	for ( uint8_t stage = 0; stage < LatencyStage_Num; stage++ )
+	{
+		print( NL "\t" );
+		_print( stageNames[ stage ] );
+		print(" avg ");
+		printInt32( Output_latencyCount ? Output_latencyStageSum[ stage ] / Output_latencyCount : 0 );
+		print(" us, max ");
+		printInt32( Output_latencyStageMax[ stage ] );
+		print(" us");
+	}
+
+	// End-to-end histogram, empty buckets are skipped
+	for ( uint8_t bucket = 0; bucket < LatencyBuckets; bucket++ )
+	{
+		if ( !Output_latencyHistogram[ bucket ] )
+			continue;
+
+		print( NL "\t" );
+		print( bucket == LatencyBuckets - 1 ? ">= " : " < " );
+		printInt32( 1 << ( bucket + LatencyBucketShift - ( bucket == LatencyBuckets - 1 ? 1 : 0 ) ) );
+		print(" us: ");
+		printInt32( Output_latencyHistogram[ bucket ] );
+	}
+}
+
+#endif
+
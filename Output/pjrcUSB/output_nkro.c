@@ -0,0 +1,90 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Local Includes
+#include "output_com.h"
+
+
+
+// ----- Macros -----
+
+// 8 consecutive USB Codes of a NKRO bitfield byte
+#define NKRO_Byte( byte, changed ) \
+	{ byte, 0x01, changed }, { byte, 0x02, changed }, { byte, 0x04, changed }, { byte, 0x08, changed }, \
+	{ byte, 0x10, changed }, { byte, 0x20, changed }, { byte, 0x40, changed }, { byte, 0x80, changed }
+
+// Partially used bytes (end of a report section)
+#define NKRO_Byte1( byte, changed ) \
+	{ byte, 0x01, changed }
+#define NKRO_Byte6( byte, changed ) \
+	{ byte, 0x01, changed }, { byte, 0x02, changed }, { byte, 0x04, changed }, { byte, 0x08, changed }, \
+	{ byte, 0x10, changed }, { byte, 0x20, changed }
+
+
+
+// ----- Variables -----
+
+// USB Code -> NKRO bitfield position
+// Shared by the output modules using the NKRO report layout (pjrcUSB, usbMuxUart)
+//  USB Codes   4 -  49 -> bytes  0 -  5 (Main)
+//  USB Codes  51 - 155 -> bytes  6 - 19 (Secondary)
+//  USB Codes 157 - 164 -> byte  20      (Tertiary)
+//  USB Codes 176 - 221 -> bytes 21 - 26 (Quartiary)
+// All other USB Codes (including modifiers, 224 - 231) have no bit
+const USBKeys_NKROBit USBKeys_NKROTable[256] = {
+	[4] =
+	NKRO_Byte (  0, USBKeyChangeState_MainKeys ),
+	NKRO_Byte (  1, USBKeyChangeState_MainKeys ),
+	NKRO_Byte (  2, USBKeyChangeState_MainKeys ),
+	NKRO_Byte (  3, USBKeyChangeState_MainKeys ),
+	NKRO_Byte (  4, USBKeyChangeState_MainKeys ),
+	NKRO_Byte6(  5, USBKeyChangeState_MainKeys ),
+
+	[51] =
+	NKRO_Byte (  6, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte (  7, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte (  8, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte (  9, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 10, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 11, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 12, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 13, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 14, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 15, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 16, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 17, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte ( 18, USBKeyChangeState_SecondaryKeys ),
+	NKRO_Byte1( 19, USBKeyChangeState_SecondaryKeys ),
+
+	[157] =
+	NKRO_Byte ( 20, USBKeyChangeState_TertiaryKeys ),
+
+	[176] =
+	NKRO_Byte ( 21, USBKeyChangeState_QuartiaryKeys ),
+	NKRO_Byte ( 22, USBKeyChangeState_QuartiaryKeys ),
+	NKRO_Byte ( 23, USBKeyChangeState_QuartiaryKeys ),
+	NKRO_Byte ( 24, USBKeyChangeState_QuartiaryKeys ),
+	NKRO_Byte ( 25, USBKeyChangeState_QuartiaryKeys ),
+	NKRO_Byte6( 26, USBKeyChangeState_QuartiaryKeys ),
+};
+
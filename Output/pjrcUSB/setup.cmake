@@ -16,6 +16,7 @@ if ( ${COMPILER_FAMILY} MATCHES "avr" )
 
 	set ( Module_SRCS
 		output_com.c
+		output_nkro.c
 		avr/usb_keyboard_serial.c
 	)
 
@@ -24,6 +25,8 @@ elseif ( ${COMPILER_FAMILY} MATCHES "arm" )
 
 	set ( Module_SRCS
 		output_com.c
+		output_latency.c
+		output_nkro.c
 		arm/usb_desc.c
 		arm/usb_dev.c
 		arm/usb_joystick.c
@@ -34,6 +37,16 @@ elseif ( ${COMPILER_FAMILY} MATCHES "arm" )
 		arm/usb_serial.c
 	)
 
+#| Native Host
+elseif ( ${COMPILER_FAMILY} MATCHES "host" )
+
+	set ( Module_SRCS
+		output_com.c
+		output_latency.c
+		output_nkro.c
+		host/usb_host.c
+	)
+
 endif ( ${COMPILER_FAMILY} MATCHES "avr" )
 
 
@@ -43,5 +56,6 @@ endif ( ${COMPILER_FAMILY} MATCHES "avr" )
 set( ModuleCompatibility
 	arm
 	avr
+	host
 )
 
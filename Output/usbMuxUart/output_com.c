@@ -49,24 +49,10 @@
 
 
 
-// ----- Macros -----
-
-// Used to build a bitmap lookup table from a byte addressable array
-#define byteLookup( byte ) \
-	case (( byte ) * ( 8 )):         bytePosition = byte; byteShift = 0; break; \
-	case (( byte ) * ( 8 ) + ( 1 )): bytePosition = byte; byteShift = 1; break; \
-	case (( byte ) * ( 8 ) + ( 2 )): bytePosition = byte; byteShift = 2; break; \
-	case (( byte ) * ( 8 ) + ( 3 )): bytePosition = byte; byteShift = 3; break; \
-	case (( byte ) * ( 8 ) + ( 4 )): bytePosition = byte; byteShift = 4; break; \
-	case (( byte ) * ( 8 ) + ( 5 )): bytePosition = byte; byteShift = 5; break; \
-	case (( byte ) * ( 8 ) + ( 6 )): bytePosition = byte; byteShift = 6; break; \
-	case (( byte ) * ( 8 ) + ( 7 )): bytePosition = byte; byteShift = 7; break
-
-
-
 // ----- Function Declarations -----
 
 void cliFunc_kbdProtocol( char* args );
+void cliFunc_latency    ( char* args );
 void cliFunc_outputDebug( char* args );
 void cliFunc_readLEDs   ( char* args );
 void cliFunc_readUART   ( char* args );
@@ -74,6 +60,7 @@ void cliFunc_sendKeys   ( char* args );
 void cliFunc_sendUART   ( char* args );
 void cliFunc_setKeys    ( char* args );
 void cliFunc_setMod     ( char* args );
+void cliFunc_usbBuffers ( char* args );
 void cliFunc_usbInitTime( char* args );
 
 
@@ -82,6 +69,9 @@ void cliFunc_usbInitTime( char* args );
 
 // Output Module command dictionary
 CLIDict_Entry( kbdProtocol, "Keyboard Protocol Mode: 0 - Boot, 1 - OS/NKRO Mode" );
+#if defined(Output_LatencyStats)
+CLIDict_Entry( latency,     "Key transition to USB report latency (us), per stage and as a histogram." NL "\t\tIf argument \033[35mr\033[0m is given, resets the statistics." );
+#endif
 CLIDict_Entry( outputDebug, "Toggle Output Debug mode." );
 CLIDict_Entry( readLEDs,    "Read LED byte:" NL "\t\t1 NumLck, 2 CapsLck, 4 ScrlLck, 16 Kana, etc." );
 CLIDict_Entry( readUART,    "Read UART buffer until empty." );
@@ -89,10 +79,16 @@ CLIDict_Entry( sendKeys,    "Send the prepared list of USB codes and modifier by
 CLIDict_Entry( sendUART,    "Send characters over UART0." );
 CLIDict_Entry( setKeys,     "Prepare a space separated list of USB codes (decimal). Waits until \033[35msendKeys\033[0m." );
 CLIDict_Entry( setMod,      "Set the modfier byte:" NL "\t\t1 LCtrl, 2 LShft, 4 LAlt, 8 LGUI, 16 RCtrl, 32 RShft, 64 RAlt, 128 RGUI" );
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+CLIDict_Entry( usbBuffers,  "Displays USB packet buffer usage: free, high-water mark and failed allocations." );
+#endif
 CLIDict_Entry( usbInitTime, "Displays the time in ms from usb_init() till the last setup call." );
 
 CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( kbdProtocol ),
+#if defined(Output_LatencyStats)
+	CLIDict_Item( latency ),
+#endif
 	CLIDict_Item( outputDebug ),
 	CLIDict_Item( readLEDs ),
 	CLIDict_Item( readUART ),
@@ -100,6 +96,9 @@ CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( sendUART ),
 	CLIDict_Item( setKeys ),
 	CLIDict_Item( setMod ),
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+	CLIDict_Item( usbBuffers ),
+#endif
 	CLIDict_Item( usbInitTime ),
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
@@ -392,13 +391,7 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 
 	// Depending on which mode the keyboard is in, USBKeys_Keys array is used differently
 	// Boot mode - Maximum of 6 byte codes
-	// NKRO mode - Each bit of the 26 byte corresponds to a key
-	//  Bits   0 -  45 (bytes  0 -  5) correspond to USB Codes   4 -  49 (Main)
-	//  Bits  48 - 161 (bytes  6 - 20) correspond to USB Codes  51 - 164 (Secondary)
-	//  Bits 168 - 213 (bytes 21 - 26) correspond to USB Codes 176 - 221 (Tertiary)
-	//  Bits 214 - 216                 unused
-	uint8_t bytePosition = 0;
-	uint8_t byteShift = 0;
+	// NKRO mode - Each bit of the 27 bytes corresponds to a key (see USBKeys_NKROTable)
 	switch ( USBKeys_Protocol )
 	{
 	case 0: // Boot Mode
@@ -448,78 +441,10 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 			USBKeys_Changed |= USBKeyChangeState_Modifiers;
 			break;
 		}
-		// First 6 bytes
-		else if ( key >= 4 && key <= 49 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 0th position, each byte has 8 bits, starting at 4th bit
-			uint8_t keyPos = key + (0 * 8 - 4); // Starting position in array, Ignoring 4 keys
-			switch ( keyPos )
-			{
-				byteLookup( 0 );
-				byteLookup( 1 );
-				byteLookup( 2 );
-				byteLookup( 3 );
-				byteLookup( 4 );
-				byteLookup( 5 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_MainKeys;
-		}
-		// Next 14 bytes
-		else if ( key >= 51 && key <= 155 )
+		// Keys with a bit in the NKRO bitfield
+		else if ( USBKeys_NKROTable[ key ].mask )
 		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			// Starting at 6th byte position, each byte has 8 bits, starting at 51st bit
-			uint8_t keyPos = key + (6 * 8 - 51); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 6 );
-				byteLookup( 7 );
-				byteLookup( 8 );
-				byteLookup( 9 );
-				byteLookup( 10 );
-				byteLookup( 11 );
-				byteLookup( 12 );
-				byteLookup( 13 );
-				byteLookup( 14 );
-				byteLookup( 15 );
-				byteLookup( 16 );
-				byteLookup( 17 );
-				byteLookup( 18 );
-				byteLookup( 19 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_SecondaryKeys;
-		}
-		// Next byte
-		else if ( key >= 157 && key <= 164 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (20 * 8 - 157); // Starting position in array, Ignoring 6 keys
-			switch ( keyPos )
-			{
-				byteLookup( 20 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_TertiaryKeys;
-		}
-		// Last 6 bytes
-		else if ( key >= 176 && key <= 221 )
-		{
-			// Lookup (otherwise division or multiple checks are needed to do alignment)
-			uint8_t keyPos = key + (21 * 8 - 176); // Starting position in array
-			switch ( keyPos )
-			{
-				byteLookup( 21 );
-				byteLookup( 22 );
-				byteLookup( 23 );
-				byteLookup( 24 );
-				byteLookup( 25 );
-				byteLookup( 26 );
-			}
-
-			USBKeys_Changed |= USBKeyChangeState_QuartiaryKeys;
+			USBKeys_Changed |= USBKeys_NKROTable[ key ].changed;
 		}
 		// Received 0x00
 		// This is a special USB Code that internally indicates a "break"
@@ -544,12 +469,12 @@ void Output_usbCodeSend_capability( TriggerMacro *trigger, uint8_t state, uint8_
 		// Set/Unset
 		if ( keyPress )
 		{
-			USBKeys_Keys[bytePosition] |= (1 << byteShift);
+			USBKeys_Keys[ USBKeys_NKROTable[ key ].byte ] |= USBKeys_NKROTable[ key ].mask;
 			USBKeys_Sent++;
 		}
 		else // Release
 		{
-			USBKeys_Keys[bytePosition] &= ~(1 << byteShift);
+			USBKeys_Keys[ USBKeys_NKROTable[ key ].byte ] &= ~USBKeys_NKROTable[ key ].mask;
 			USBKeys_Sent++;
 		}
 
@@ -700,10 +625,17 @@ inline void Output_send()
 		for ( uint8_t c = USBKeys_Sent; c < USB_BOOT_MAX_KEYS; c++ )
 			USBKeys_Keys[c] = 0;
 
-	// Send keypresses while there are pending changes
-	while ( USBKeys_Changed )
+	// Send pending changes, at most one report per endpoint per USB frame
+	// Anything that could not be sent yet stays in USBKeys_Changed for the next call
+	if ( USBKeys_Changed )
 		usb_keyboard_send();
 
+#if defined(Output_LatencyStats)
+	// Everything pending was queued, time the oldest transition it carried
+	if ( !USBKeys_Changed )
+		Output_latencySent();
+#endif
+
 	// Clear keys sent
 	USBKeys_Sent = 0;
 
@@ -980,6 +912,27 @@ void cliFunc_setMod( char* args )
 	USBKeys_ModifiersCLI = numToInt( arg1Ptr );
 }
 
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_)
+void cliFunc_usbBuffers( char* args )
+{
+	print(NL);
+	info_msg("USB Buffers: ");
+	printInt8( usb_malloc_free() );
+	print(" free of ");
+	printInt8( NUM_USB_BUFFERS );
+	print(" (");
+	printInt8( NUM_USB_REPORT_BUFFERS );
+	print(" reserved for reports), high-water ");
+	printInt8( usb_buffer_high_water );
+	print(NL);
+	info_msg("Failed allocations: ");
+	printInt32( usb_malloc_failed );
+	print(" general, ");
+	printInt32( usb_malloc_report_failed );
+	print(" report");
+}
+#endif
+
 void cliFunc_usbInitTime( char* args )
 {
 	// Calculate overall USB initialization time
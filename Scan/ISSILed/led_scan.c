@@ -23,6 +23,7 @@
 #include <cli.h>
 #include <kll_defs.h>
 #include <led.h>
+#include <perf.h>
 #include <print.h>
 
 // Interconnect module if compiled in
@@ -40,25 +41,60 @@
 
 // ----- Defines -----
 
-#define I2C_TxBufferLength 300
-#define I2C_RxBufferLength 8
+// Queued transactions and the pool their (copied) payloads are stored in
+#define I2C_QueueLength 16
+#define I2C_PoolLength  300
+
+// Number of times a NAKed transaction is retried before it is dropped
+#define I2C_Retries 3
+
+// Frequency divider, 400 kHz (see I2C_setup)
+#define I2C_Frequency 0x85
+#define I2C_F_MULT_MASK 0xC0
 
 #define LED_BufferLength 144
 
 // TODO Needs to be defined per keyboard
 #define LED_TotalChannels 144
 
+// Unchanged registers between two changed spans are sent if it is cheaper than starting a new write
+// (I2C address + register address + STOP/START)
+#define LED_SpanGap 3
+
+// Animation frame tables, see ISSILedAnimations in capabilities.kll
+#define LED_AnimationEnd 0xFF
+#define LED_AnimationMax 16
+
 
 
 // ----- Structs -----
 
-typedef struct I2C_Buffer {
-	uint16_t  head;
-	uint16_t  tail;
-	uint8_t   sequencePos;
-	uint16_t  size;
-	uint8_t  *buffer;
-} I2C_Buffer;
+typedef enum I2C_Status {
+	I2C_Status_Done,
+	I2C_Status_Nak, // Retries exhausted
+} I2C_Status;
+
+// I2C transaction descriptor
+// Write: <addr> <reg> <data>...
+// Read:  <addr> <reg> <repeated START> <addr | 1> <data>...
+typedef struct I2C_Transaction {
+	uint8_t   addr;  // Chip address (write)
+	uint8_t   reg;   // First register
+	uint8_t   read;  // Read len bytes into data instead of writing them
+	uint8_t   len;
+	uint8_t  *data;  // Must stay valid until the transaction completes
+	void    (*complete)( struct I2C_Transaction *trans, uint8_t status ); // Optional, called from the I2C ISR
+	uint16_t  pool;  // Payload pool bytes to release on completion
+} I2C_Transaction;
+
+// Bus state of the transaction at the head of the queue
+typedef enum I2C_State {
+	I2C_State_Idle,        // Bus released, queue is restarted by I2C_start
+	I2C_State_Address,     // Chip address sent
+	I2C_State_Write,       // Register/data bytes being sent
+	I2C_State_ReadAddress, // Chip address (read) sent after a repeated START
+	I2C_State_Read,        // Data bytes being received
+} I2C_State;
 
 typedef struct LED_Buffer {
 	uint8_t i2c_addr;
@@ -66,13 +102,38 @@ typedef struct LED_Buffer {
 	uint8_t buffer[LED_BufferLength];
 } LED_Buffer;
 
+// How the animation levels are combined with the base (LED_control) levels
+typedef enum LED_Blend {
+	LED_Blend_Replace, // Animation level
+	LED_Blend_Add,     // Base + animation level (saturated)
+	LED_Blend_Max,     // Brightest of the two
+	LED_Blend_None,    // No animation running
+} LED_Blend;
+
+typedef struct LED_Animation {
+	const uint8_t *start;  // First frame
+	const uint8_t *frame;  // Next frame, 0 if stopped
+	uint8_t        period; // Ticks per frame
+	uint8_t        ticks;  // Ticks until the next frame
+	uint8_t        blend;
+	uint8_t        loop;
+	uint8_t        index;
+} LED_Animation;
+
 
 
 // ----- Function Declarations -----
 
 // CLI Functions
+#if defined(_host_)
+void cliFunc_i2cCheck( char* args );
+#endif
 void cliFunc_i2cRecv ( char* args );
 void cliFunc_i2cSend ( char* args );
+void cliFunc_ledAnim ( char* args );
+#if defined(_host_)
+void cliFunc_ledBench( char* args );
+#endif
 void cliFunc_ledCtrl ( char* args );
 void cliFunc_ledRPage( char* args );
 void cliFunc_ledStart( char* args );
@@ -80,18 +141,24 @@ void cliFunc_ledTest ( char* args );
 void cliFunc_ledWPage( char* args );
 void cliFunc_ledZero ( char* args );
 
-uint8_t I2C_TxBufferPop();
-void I2C_BufferPush( uint8_t byte, I2C_Buffer *buffer );
-uint16_t I2C_BufferLen( I2C_Buffer *buffer );
-uint8_t I2C_Send( uint8_t *data, uint8_t sendLen, uint8_t recvLen );
+uint8_t I2C_Send( uint8_t *data, uint8_t sendLen );
+uint8_t I2C_Recv( uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len );
+void I2C_start();
 
 
 
 // ----- Variables -----
 
 // Scan Module command dictionary
-CLIDict_Entry( i2cRecv,     "Send I2C sequence of bytes and expect a reply of 1 byte on the last sequence." NL "\t\tUse |'s to split sequences with a stop." );
-CLIDict_Entry( i2cSend,     "Send I2C sequence of bytes. Use |'s to split sequences with a stop." );
+#if defined(_host_)
+CLIDict_Entry( i2cCheck,    "Checks I2C ordering, NAK retries/drops and pool wrap over N rounds. Defaults to 20 rounds. Host builds only." );
+#endif
+CLIDict_Entry( i2cRecv,     "Read I2C registers. Args: <addr> <reg> [<len>]" );
+CLIDict_Entry( i2cSend,     "Send I2C sequence of bytes. Use |'s to split transactions." NL "\t\tShows queue stats with no args." );
+CLIDict_Entry( ledAnim,     "Start/stop LED animation. Args: <index> [<mode>] (0 stop, 1 once, 2 loop). No args lists animations." );
+#if defined(_host_)
+CLIDict_Entry( ledBench,    "Times N frames that change all channels, see perf. Defaults to 100 frames. Host builds only." );
+#endif
 CLIDict_Entry( ledCtrl,     "Basic LED control. Args: <mode> <amount> [<index>]" );
 CLIDict_Entry( ledRPage,    "Read the given register page." );
 CLIDict_Entry( ledStart,    "Disable software shutdown." );
@@ -100,8 +167,15 @@ CLIDict_Entry( ledWPage,    "Write to given register page starting at address. i
 CLIDict_Entry( ledZero,     "Zero out LED register pages (non-configuration)." );
 
 CLIDict_Def( ledCLIDict, "ISSI LED Module Commands" ) = {
+#if defined(_host_)
+	CLIDict_Item( i2cCheck ),
+#endif
 	CLIDict_Item( i2cRecv ),
 	CLIDict_Item( i2cSend ),
+	CLIDict_Item( ledAnim ),
+#if defined(_host_)
+	CLIDict_Item( ledBench ),
+#endif
 	CLIDict_Item( ledCtrl ),
 	CLIDict_Item( ledRPage ),
 	CLIDict_Item( ledStart ),
@@ -113,15 +187,63 @@ CLIDict_Def( ledCLIDict, "ISSI LED Module Commands" ) = {
 
 
 
-// Before sending the sequence, I2C_TxBuffer_CurLen is assigned and as each byte is sent, it is decremented
-// Once I2C_TxBuffer_CurLen reaches zero, a STOP on the I2C bus is sent
-volatile uint8_t I2C_TxBufferPtr[ I2C_TxBufferLength ];
-volatile uint8_t I2C_RxBufferPtr[ I2C_TxBufferLength ];
+// Transactions are processed in order by i2c0_isr
+// Consecutive transactions are joined with a repeated START, a STOP is only sent once the queue is empty
+I2C_Transaction I2C_queue[ I2C_QueueLength ];
+volatile uint8_t I2C_queueHead = 0;
+volatile uint8_t I2C_queueItems = 0;
+
+volatile uint8_t I2C_state = I2C_State_Idle;
+uint8_t I2C_pos = 0;     // Current byte of the head transaction
+uint8_t I2C_retries = 0; // NAKs of the head transaction
+
+// Copied payloads, allocated in queue order (see I2C_Send)
+uint8_t I2C_pool[ I2C_PoolLength ];
+uint16_t I2C_poolTail = 0;
+volatile uint16_t I2C_poolUsed = 0;
+
+// Statistics
+uint32_t I2C_transactions = 0;
+uint16_t I2C_naks = 0;
+uint16_t I2C_failed = 0;
+uint16_t I2C_arbLost = 0;
+
+// Frame buffer, LED_control modifies this buffer and LED_scan sends the changes
+LED_Buffer LED_pageBuffer = {
+	0xE8, // Chip 1
+	0x24, // Brightness section
+};
+
+// Brightness registers as last sent to the ISSI chip
+uint8_t LED_sentBuffer[LED_BufferLength];
+
+// Range of channels that may differ from LED_sentBuffer (empty if start >= end)
+uint16_t LED_dirtyStart = LED_TotalChannels;
+uint16_t LED_dirtyEnd = 0;
+
+// Last time the frame buffer was sent
+uint32_t LED_frameTime = 0;
+
+// Currently selected register page of the ISSI chip, 0xFF if unknown
+uint8_t LED_currentPage = 0xFF;
+
+// Levels set by LED_control and the running animation, blended into the frame buffer
+uint8_t LED_baseBuffer[LED_BufferLength];
+uint8_t LED_animBuffer[LED_BufferLength];
+
+// Animation frame tables
+// Each animation: <ticks per frame>, <blend mode>, <frame>..., 0xFF
+// Each frame:     <count>, <channel>, <level>... (only the channels that change)
+const uint8_t LED_animationData[] = { ISSILedAnimations_define };
+const uint8_t *LED_animations[LED_AnimationMax];
+uint8_t LED_animationsNum = 0;
 
-volatile I2C_Buffer I2C_TxBuffer = { 0, 0, 0, I2C_TxBufferLength, (uint8_t*)I2C_TxBufferPtr };
-volatile I2C_Buffer I2C_RxBuffer = { 0, 0, 0, I2C_RxBufferLength, (uint8_t*)I2C_RxBufferPtr };
+// Running animation, advanced by the animation tick (PIT channel 1)
+LED_Animation LED_animation = { 0, 0, 0, 0, LED_Blend_None, 0, 0 };
 
-LED_Buffer LED_pageBuffer;
+// Animation tick and frame send, see the perf command
+PerfCounter LED_perf[2];
+const char *const LED_perfLabels[] = { "Animation Tick", "Frame Send" };
 
 // A bit mask determining which LEDs are enabled in the ISSI chip
 const uint8_t LED_ledEnableMask1[] = {
@@ -141,126 +263,187 @@ const uint8_t LED_defaultBrightness1[] = {
 
 // ----- Interrupt Functions -----
 
-void i2c0_isr()
+// Data register access, host builds simulate the resulting bus activity
+inline void I2C_write( uint8_t byte )
 {
-	cli(); // Disable Interrupts
+	I2C0_D = byte;
+#if defined(_host_)
+	Host_i2cWrite();
+#endif
+}
 
-	uint8_t status = I2C0_S; // Read I2C Bus status
+// Returns the received byte and starts receiving the next one
+inline uint8_t I2C_read()
+{
+	uint8_t byte = I2C0_D;
+#if defined(_host_)
+	Host_i2cRead();
+#endif
+	return byte;
+}
 
-	// Master Mode Transmit
-	if ( I2C0_C1 & I2C_C1_TX )
+// Releases the bus
+inline void I2C_stop()
+{
+	I2C0_C1 = I2C_C1_IICEN;
+#if defined(_host_)
+	Host_i2cStop();
+#endif
+}
+
+// Repeated START, followed by the address byte
+inline void I2C_restart( uint8_t addr )
+{
+	// Errata e6070, a repeated START is not generated if I2C0_F[MULT] is set
+	I2C0_F = I2C_Frequency & ~I2C_F_MULT_MASK;
+	I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX | I2C_C1_RSTA;
+	I2C0_F = I2C_Frequency;
+
+	I2C_write( addr );
+}
+
+// Finishes the head transaction then starts the next one, or releases the bus if there are none left
+void I2C_next( uint8_t status )
+{
+	I2C_Transaction *trans = &I2C_queue[ I2C_queueHead ];
+	I2C_pos = 0;
+
+	// Chip is busy or glitched, try again
+	if ( status == I2C_Status_Nak )
 	{
-		// Check current use of the I2C bus
-		// Currently sending data
-		if ( I2C_TxBuffer.sequencePos > 0 )
+		I2C_naks++;
+		if ( I2C_retries++ < I2C_Retries )
 		{
-			// Make sure slave sent an ACK
-			if ( status & I2C_S_RXAK )
-			{
-				// NACK Detected, disable interrupt
-				erro_print("I2C NAK detected...");
-				I2C0_C1 = I2C_C1_IICEN;
-
-				// Abort Tx Buffer
-				I2C_TxBuffer.head = 0;
-				I2C_TxBuffer.tail = 0;
-				I2C_TxBuffer.sequencePos = 0;
-			}
-			else
-			{
-				// Transmit byte
-				I2C0_D = I2C_TxBufferPop();
-			}
+			I2C_state = I2C_State_Address;
+			I2C_restart( trans->addr );
+			return;
 		}
-		// Receiving data
-		else if ( I2C_RxBuffer.sequencePos > 0 )
-		{
-			// Master Receive, addr sent
-			if ( status & I2C_S_ARBL )
-			{
-				// Arbitration Lost
-				erro_print("Arbitration lost...");
-				// TODO Abort Rx
+		I2C_failed++;
+	}
+	I2C_retries = 0;
+	I2C_transactions++;
 
-				I2C0_C1 = I2C_C1_IICEN;
-				I2C0_S = I2C_S_ARBL | I2C_S_IICIF; // Clear ARBL flag and interrupt
-			}
-			if ( status & I2C_S_RXAK )
-			{
-				// Slave Address NACK Detected, disable interrupt
-				erro_print("Slave Address I2C NAK detected...");
-				// TODO Abort Rx
+	if ( trans->complete )
+		trans->complete( trans, status );
 
-				I2C0_C1 = I2C_C1_IICEN;
-			}
-			else
-			{
-				dbug_msg("Attempting to read byte - ");
-				printHex( I2C_RxBuffer.sequencePos );
-				print( NL );
-				I2C0_C1 = I2C_RxBuffer.sequencePos == 1
-					? I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK // Single byte read
-					: I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST; // Multi-byte read
-			}
-		}
-		else
-		{
-			/*
-			dbug_msg("STOP - ");
-			printHex( I2C_BufferLen( (I2C_Buffer*)&I2C_TxBuffer ) );
-			print(NL);
-			*/
-
-			// Delay around STOP to make sure it actually happens...
-			delayMicroseconds( 1 );
-			I2C0_C1 = I2C_C1_IICEN; // Send STOP
-			delayMicroseconds( 7 );
-
-			// If there is another sequence, start sending
-			if ( I2C_BufferLen( (I2C_Buffer*)&I2C_TxBuffer ) < I2C_TxBuffer.size )
-			{
-				// Clear status flags
-				I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+	// Release transaction
+	I2C_poolUsed -= trans->pool;
+	I2C_queueHead = I2C_queueHead + 1 < I2C_QueueLength ? I2C_queueHead + 1 : 0;
+	I2C_queueItems--;
+
+	// Nothing left, send STOP
+	if ( I2C_queueItems == 0 )
+	{
+		I2C_state = I2C_State_Idle;
+		I2C_stop();
+		return;
+	}
+
+	I2C_state = I2C_State_Address;
+	I2C_restart( I2C_queue[ I2C_queueHead ].addr );
+}
 
-				// Wait...till the master dies
-				while ( I2C0_S & I2C_S_BUSY );
+// Only the head transaction is touched here, the rest of the queue belongs to the thread adding to it
+// Never waits on the bus, each interrupt sends/receives at most one byte
+void i2c0_isr()
+{
+	uint8_t status = I2C0_S; // Read I2C Bus status
+	I2C0_S = I2C_S_IICIF; // Clear interrupt
 
-				// Enable I2C interrupt
-				I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+	I2C_Transaction *trans = &I2C_queue[ I2C_queueHead ];
 
-				// Transmit byte
-				I2C0_D = I2C_TxBufferPop();
-			}
+	// Another master took the bus (master mode is left by the hardware)
+	// The transaction is restarted by I2C_start
+	if ( status & I2C_S_ARBL )
+	{
+		I2C0_S = I2C_S_ARBL;
+		I2C_arbLost++;
+		I2C_pos = 0;
+		I2C_state = I2C_State_Idle;
+		I2C_stop();
+		return;
+	}
+
+	switch ( I2C_state )
+	{
+	case I2C_State_Address:
+	case I2C_State_Write:
+	case I2C_State_ReadAddress:
+		// Address or data byte was not acknowledged
+		if ( status & I2C_S_RXAK )
+		{
+			I2C_next( I2C_Status_Nak );
+			return;
 		}
+		break;
+
+	case I2C_State_Idle:
+		return;
 	}
-	// Master Mode Receive
-	else
+
+	switch ( I2C_state )
 	{
-		// XXX Do we need to handle 2nd last byte?
-		//I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK; // No STOP, Rx, NAK on recv
+	case I2C_State_Address:
+		I2C_state = I2C_State_Write;
+		I2C_write( trans->reg );
+		break;
 
-		// Last byte
-		if ( I2C_TxBuffer.sequencePos <= 1 )
+	case I2C_State_Write:
+		if ( !trans->read && I2C_pos < trans->len )
 		{
-			// Change to Tx mode
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
-
-			// Grab last byte
-			I2C_BufferPush( I2C0_D, (I2C_Buffer*)&I2C_RxBuffer );
+			I2C_write( trans->data[ I2C_pos++ ] );
+			break;
+		}
 
-			delayMicroseconds( 1 ); // Should be enough time before issuing the stop
-			I2C0_C1 = I2C_C1_IICEN; // Send STOP
+		// Register set, read from it
+		if ( trans->read )
+		{
+			I2C_state = I2C_State_ReadAddress;
+			I2C_restart( trans->addr | 0x01 );
+			break;
 		}
-		else
+
+		I2C_next( I2C_Status_Done );
+		break;
+
+	case I2C_State_ReadAddress:
+		// Receive mode, the last byte is not acknowledged
+		I2C_state = I2C_State_Read;
+		I2C0_C1 = trans->len == 1
+			? I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK
+			: I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST;
+		I2C_read(); // Dummy read, starts receiving the first byte
+		break;
+
+	case I2C_State_Read:
+		// Last byte, back to transmit mode (stays master for the next repeated START)
+		if ( I2C_pos + 1 >= trans->len )
 		{
-			// Retrieve data
-			I2C_BufferPush( I2C0_D, (I2C_Buffer*)&I2C_RxBuffer );
+			I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+			trans->data[ I2C_pos++ ] = I2C0_D;
+			I2C_next( I2C_Status_Done );
+			break;
 		}
+
+		// Second last byte
+		if ( I2C_pos + 2 == trans->len )
+			I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK;
+
+		trans->data[ I2C_pos++ ] = I2C_read();
+		break;
 	}
+}
 
-	I2C0_S = I2C_S_IICIF; // Clear interrupt
+void LED_animationTick();
 
-	sei(); // Re-enable Interrupts
+// Animation tick
+void pit1_isr()
+{
+	PIT_TFLG1 = PIT_TFLG_TIF; // Clear interrupt
+
+	Perf_start( cycles );
+	LED_animationTick();
+	Perf_stop( &LED_perf[0], cycles );
 }
 
 
@@ -278,7 +461,7 @@ inline void I2C_setup()
 
 	// SCL Frequency Divider
 	// 400kHz -> 120 (0x85) @ 48 MHz F_BUS
-	I2C0_F = 0x85;
+	I2C0_F = I2C_Frequency;
 	I2C0_FLT = 4;
 	I2C0_C1 = I2C_C1_IICEN;
 	I2C0_C2 = I2C_C2_HDRS; // High drive select
@@ -304,12 +487,14 @@ void LED_zeroPages( uint8_t startPage, uint8_t numPages, uint8_t startReg, uint8
 		pageSetup[2] = page;
 
 		// Setup page
-		while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
+		while ( I2C_Send( pageSetup, sizeof( pageSetup ) ) == 0 )
 			delay(1);
 
 		// Zero out page
-		while ( I2C_Send( fullPage, endReg - startReg + 2, 0 ) == 0 )
+		while ( I2C_Send( fullPage, endReg - startReg + 2 ) == 0 )
 			delay(1);
+
+		LED_currentPage = page;
 	}
 }
 
@@ -319,13 +504,14 @@ void LED_sendPage( uint8_t *buffer, uint8_t len, uint8_t page )
 	uint8_t pageSetup[] = { 0xE8, 0xFD, page };
 
 	// Setup page
-	while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
+	while ( I2C_Send( pageSetup, sizeof( pageSetup ) ) == 0 )
 		delay(1);
 
 	// Write page to I2C Tx Buffer
-	while ( I2C_Send( buffer, len, 0 ) == 0 )
+	while ( I2C_Send( buffer, len ) == 0 )
 		delay(1);
 
+	LED_currentPage = page;
 }
 
 void LED_writeReg( uint8_t reg, uint8_t val, uint8_t page )
@@ -337,11 +523,13 @@ void LED_writeReg( uint8_t reg, uint8_t val, uint8_t page )
 	uint8_t writeData[] = { 0xE8, reg, val };
 
 	// Setup page
-	while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
+	while ( I2C_Send( pageSetup, sizeof( pageSetup ) ) == 0 )
 		delay(1);
 
-	while ( I2C_Send( writeData, sizeof( writeData ), 0 ) == 0 )
+	while ( I2C_Send( writeData, sizeof( writeData ) ) == 0 )
 		delay(1);
+
+	LED_currentPage = page;
 }
 
 void LED_readPage( uint8_t len, uint8_t page )
@@ -353,33 +541,295 @@ void LED_readPage( uint8_t len, uint8_t page )
 	uint8_t pageSetup[] = { 0xE8, 0xFD, page };
 
 	// Setup page
-	while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
+	while ( I2C_Send( pageSetup, sizeof( pageSetup ) ) == 0 )
 		delay(1);
+	LED_currentPage = page;
 
-	// Register Setup
-	uint8_t regSetup[] = { 0xE8, 0x00 };
+	// Read the whole page at once
+	uint8_t regs[ 0xB4 ];
+	if ( len > sizeof( regs ) )
+		len = sizeof( regs );
 
-	// Read each register in the page
-	for ( uint8_t reg = 0; reg < len; reg++ )
+	if ( I2C_Recv( 0xE8, 0x00, regs, len ) )
+	{
+		for ( uint8_t reg = 0; reg < len; reg++ )
+		{
+			printHex_op( regs[ reg ], 2 );
+			print( reg % 16 == 15 ? NL : " " );
+		}
+		print( NL );
+	}
+	else
 	{
-		// Update register to read
-		regSetup[1] = reg;
+		erro_print("I2C NAK detected...");
+	}
 
-		// Configure register
-		while ( I2C_Send( regSetup, sizeof( regSetup ), 0 ) == 0 )
-			delay(1);
+	// Disable software shutdown
+	LED_writeReg( 0x0A, 0x01, 0x0B );
+}
 
-		// Register Read Command
-		uint8_t regReadCmd[] = { 0xE9 };
+// Interrupts must be disabled (or called from the animation tick ISR) when changing the frame buffer
+inline void LED_frameDirty( uint16_t start, uint16_t end )
+{
+	if ( start < LED_dirtyStart )
+		LED_dirtyStart = start;
+	if ( end > LED_dirtyEnd )
+		LED_dirtyEnd = end;
+}
 
-		// Request single register byte
-		while ( I2C_Send( regReadCmd, sizeof( regReadCmd ), 1 ) == 0 )
-			delay(1);
-		dbug_print("NEXT");
+inline void LED_compose( uint8_t channel )
+{
+	uint8_t base = LED_baseBuffer[ channel ];
+	uint8_t anim = LED_animBuffer[ channel ];
+
+	switch ( LED_animation.blend )
+	{
+	case LED_Blend_Replace:
+		LED_pageBuffer.buffer[ channel ] = anim;
+		break;
+
+	case LED_Blend_Add:
+		LED_pageBuffer.buffer[ channel ] = base + anim > 0xFF ? 0xFF : base + anim;
+		break;
+
+	case LED_Blend_Max:
+		LED_pageBuffer.buffer[ channel ] = base > anim ? base : anim;
+		break;
+
+	default:
+		LED_pageBuffer.buffer[ channel ] = base;
+		break;
 	}
+}
 
-	// Disable software shutdown
-	LED_writeReg( 0x0A, 0x01, 0x0B );
+// The brightness registers were written directly, make the base levels match the ISSI chip
+// brightness may be 0 (all off)
+void LED_frameReset( const uint8_t *brightness, uint8_t len )
+{
+	if ( len > LED_BufferLength )
+		len = LED_BufferLength;
+
+	__disable_irq();
+
+	memset( LED_baseBuffer, 0, LED_BufferLength );
+	if ( brightness )
+		memcpy( LED_baseBuffer, brightness, len );
+	memcpy( LED_sentBuffer, LED_baseBuffer, LED_BufferLength );
+
+	// Only differs if an animation is running
+	for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
+	{
+		LED_compose( channel );
+	}
+	LED_frameDirty( 0, LED_TotalChannels );
+
+	__enable_irq();
+}
+
+// Sends the changed brightness registers, one I2C write per span of changed registers
+// Does not wait for I2C buffer space, whatever does not fit is sent on the next call
+void LED_frameSend()
+{
+	// Take the dirty range, the animation tick may start a new one while sending
+	__disable_irq();
+	uint16_t channel = LED_dirtyStart;
+	uint16_t dirtyEnd = LED_dirtyEnd;
+	LED_dirtyStart = LED_TotalChannels;
+	LED_dirtyEnd = 0;
+	__enable_irq();
+
+	while ( channel < dirtyEnd )
+	{
+		// Skip unchanged registers
+		if ( LED_pageBuffer.buffer[ channel ] == LED_sentBuffer[ channel ] )
+		{
+			channel++;
+			continue;
+		}
+
+		// Find the end of the span
+		uint16_t end = channel + 1;
+		for ( uint16_t next = end; next < dirtyEnd && next - end < LED_SpanGap; next++ )
+		{
+			if ( LED_pageBuffer.buffer[ next ] != LED_sentBuffer[ next ] )
+				end = next + 1;
+		}
+
+		// Brightness registers are on the frame page
+		if ( LED_currentPage != 0 )
+		{
+			uint8_t pageSetup[] = { 0xE8, 0xFD, 0x00 };
+			if ( I2C_Send( pageSetup, sizeof( pageSetup ) ) == 0 )
+				break;
+			LED_currentPage = 0;
+		}
+
+		// Chip address + starting register + span
+		uint8_t write[ LED_BufferLength + 2 ];
+		uint8_t len = end - channel;
+		write[0] = LED_pageBuffer.i2c_addr;
+		write[1] = LED_pageBuffer.reg_addr + channel;
+		memcpy( &write[2], &LED_pageBuffer.buffer[ channel ], len );
+		if ( I2C_Send( write, len + 2 ) == 0 )
+			break;
+
+		memcpy( &LED_sentBuffer[ channel ], &write[2], len );
+		channel = end;
+	}
+
+	// Remaining changes
+	if ( channel < dirtyEnd )
+	{
+		__disable_irq();
+		LED_frameDirty( channel, dirtyEnd );
+		__enable_irq();
+	}
+}
+
+// Stops the running animation, LEDs return to their base levels
+// Interrupts must be disabled (or called from the animation tick ISR)
+void LED_animationStop()
+{
+	PIT_TCTRL1 = 0;
+
+	LED_animation.frame = 0;
+	LED_animation.blend = LED_Blend_None;
+	memset( LED_animBuffer, 0, LED_BufferLength );
+
+	for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
+	{
+		LED_compose( channel );
+	}
+	LED_frameDirty( 0, LED_TotalChannels );
+}
+
+// loop - Restart from the first frame instead of stopping after the last one
+void LED_animationStart( uint8_t index, uint8_t loop )
+{
+	if ( index >= LED_animationsNum )
+	{
+		warn_msg("Invalid LED animation: ");
+		printInt8( index );
+		print( NL );
+		return;
+	}
+
+	const uint8_t *data = LED_animations[ index ];
+
+	__disable_irq();
+
+	LED_animationStop();
+
+	// First frame is applied on the next tick
+	LED_animation.period = data[0];
+	LED_animation.ticks = 1;
+	LED_animation.blend = data[1];
+	LED_animation.start = &data[2];
+	LED_animation.frame = &data[2];
+	LED_animation.loop = loop;
+	LED_animation.index = index;
+
+	PIT_TCTRL1 = PIT_TCTRL_TIE | PIT_TCTRL_TEN;
+
+	__enable_irq();
+}
+
+// Applies the next frame of the running animation
+// Tables are validated by LED_animationSetup
+void LED_animationTick()
+{
+	if ( !LED_animation.frame || --LED_animation.ticks )
+		return;
+	LED_animation.ticks = LED_animation.period;
+
+	// Last frame
+	if ( *LED_animation.frame == LED_AnimationEnd )
+	{
+		if ( !LED_animation.loop )
+		{
+			LED_animationStop();
+			return;
+		}
+		LED_animation.frame = LED_animation.start;
+	}
+
+	const uint8_t *frame = LED_animation.frame;
+	uint8_t count = *frame++;
+	uint8_t first = LED_TotalChannels;
+	uint8_t last = 0;
+	for ( ; count > 0; count-- )
+	{
+		uint8_t channel = *frame++;
+		LED_animBuffer[ channel ] = *frame++;
+		LED_compose( channel );
+
+		if ( channel < first )
+			first = channel;
+		if ( channel > last )
+			last = channel;
+	}
+	LED_animation.frame = frame;
+
+	if ( first <= last )
+		LED_frameDirty( first, last + 1 );
+}
+
+// Finds the start of each animation in the frame tables
+// Tables are checked here so the animation tick doesn't have to
+void LED_animationSetup()
+{
+	uint16_t pos = 0;
+	while ( pos < sizeof( LED_animationData ) && LED_animationsNum < LED_AnimationMax )
+	{
+		uint16_t start = pos;
+		uint8_t valid = pos + 2 < sizeof( LED_animationData )
+			&& LED_animationData[ pos ] > 0                  // Ticks per frame
+			&& LED_animationData[ pos + 1 ] < LED_Blend_None // Blend mode
+			&& LED_animationData[ pos + 2 ] != LED_AnimationEnd; // At least one frame
+		pos += 2;
+
+		// Frames
+		while ( valid && pos < sizeof( LED_animationData ) && LED_animationData[ pos ] != LED_AnimationEnd )
+		{
+			uint8_t count = LED_animationData[ pos++ ];
+			if ( pos + count * 2 > sizeof( LED_animationData ) )
+			{
+				valid = 0;
+				break;
+			}
+
+			for ( ; count > 0; count--, pos += 2 )
+			{
+				if ( LED_animationData[ pos ] >= LED_TotalChannels )
+					valid = 0;
+			}
+		}
+
+		// Missing end marker
+		if ( pos >= sizeof( LED_animationData ) )
+			valid = 0;
+
+		if ( !valid )
+		{
+			erro_msg("Invalid LED animation table: ");
+			printInt8( LED_animationsNum );
+			print( NL );
+			break;
+		}
+
+		LED_animations[ LED_animationsNum++ ] = &LED_animationData[ start ];
+		pos++; // End marker
+	}
+
+	// Animation tick, only enabled while an animation is running
+	SIM_SCGC6 |= SIM_SCGC6_PIT;
+	PIT_MCR = 0;
+	PIT_TCTRL1 = 0;
+	PIT_LDVAL1 = F_BUS / 1000 * ISSILedAnimationTick_define - 1;
+
+	// Lower priority than the rest of the system (default is 128)
+	NVIC_SET_PRIORITY( IRQ_PIT_CH1, 192 );
+	NVIC_ENABLE_IRQ( IRQ_PIT_CH1 );
 }
 
 // Setup
@@ -388,6 +838,9 @@ inline void LED_setup()
 	// Register Scan CLI dictionary
 	CLI_registerDictionary( ledCLIDict, ledCLIDictName );
 
+	// Profiling
+	Perf_registerGroup( "LED", LED_perfLabels, LED_perf, 2 );
+
 	// Initialize I2C
 	I2C_setup();
 
@@ -408,6 +861,10 @@ inline void LED_setup()
 
 	// Set default brightness
 	LED_sendPage( (uint8_t*)LED_defaultBrightness1, sizeof( LED_defaultBrightness1 ), 0 );
+	LED_frameReset( &LED_defaultBrightness1[2], sizeof( LED_defaultBrightness1 ) - 2 );
+
+	// Animations
+	LED_animationSetup();
 
 	// Do not disable software shutdown of ISSI chip unless current is high enough
 	// Require at least 150 mA
@@ -420,223 +877,144 @@ inline void LED_setup()
 }
 
 
-inline uint8_t I2C_BufferCopy( uint8_t *data, uint8_t sendLen, uint8_t recvLen, I2C_Buffer *buffer )
+// Interrupts must be disabled
+inline uint8_t I2C_queuePush( I2C_Transaction *trans )
 {
-	uint8_t reTurn = 0;
-
-	// If sendLen is greater than buffer fail right away
-	if ( sendLen > buffer->size )
+	if ( I2C_queueItems >= I2C_QueueLength )
 		return 0;
 
-	// Calculate new tail to determine if buffer has enough space
-	// The first element specifies the expected number of bytes from the slave (+1)
-	// The second element in the new buffer is the length of the buffer sequence (+1)
-	uint16_t newTail = buffer->tail + sendLen + 2;
-	if ( newTail >= buffer->size )
-		newTail -= buffer->size;
+	uint8_t pos = I2C_queueHead + I2C_queueItems;
+	if ( pos >= I2C_QueueLength )
+		pos -= I2C_QueueLength;
+	I2C_queue[ pos ] = *trans;
+	I2C_queueItems++;
 
-	if ( I2C_BufferLen( buffer ) < sendLen + 2 )
-		return 0;
+	return 1;
+}
 
-/*
-	print("|");
-	printHex( sendLen + 2 );
-	print("|");
-	printHex( *tail );
-	print("@");
-	printHex( newTail );
-	print("@");
-*/
-
-	// If buffer is clean, return 1, otherwise 2
-	reTurn = buffer->head == buffer->tail ? 1 : 2;
-
-	// Add to buffer, already know there is enough room (simplifies adding logic)
-	uint8_t bufferHeaderPos = 0;
-	for ( uint16_t c = 0; c < sendLen; c++ )
-	{
-		// Add data to buffer
-		switch ( bufferHeaderPos )
-		{
-		case 0:
-			buffer->buffer[ buffer->tail ] = recvLen;
-			bufferHeaderPos++;
-			c--;
-			break;
+// Queues a transaction, the descriptor is copied (but not the data it points to)
+// Returns 0 if the queue is full
+uint8_t I2C_queueAdd( I2C_Transaction *trans )
+{
+	__disable_irq();
+	uint8_t added = I2C_queuePush( trans );
+	__enable_irq();
 
-		case 1:
-			buffer->buffer[ buffer->tail ] = sendLen;
-			bufferHeaderPos++;
-			c--;
-			break;
+	I2C_start();
+	return added;
+}
 
-		default:
-			buffer->buffer[ buffer->tail ] = data[ c ];
-			break;
-		}
+// Starts processing the queue if the bus was released
+void I2C_start()
+{
+	if ( I2C_state != I2C_State_Idle || I2C_queueItems == 0 )
+		return;
 
-		// Check for wrap-around case
-		if ( buffer->tail + 1 >= buffer->size )
-		{
-			buffer->tail = 0;
-		}
-		// Normal case
-		else
-		{
-			buffer->tail++;
-		}
-	}
+	// Wait for the STOP of the last transaction to finish (never done in the ISR)
+	while ( I2C0_S & I2C_S_BUSY );
 
-	return reTurn;
-}
+	__disable_irq();
+
+	if ( I2C_state == I2C_State_Idle && I2C_queueItems > 0 )
+	{
+		// Clear status flags
+		I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
 
+		// START, enable I2C interrupt
+		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
+		I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
 
-inline uint16_t I2C_BufferLen( I2C_Buffer *buffer )
-{
-	// Tail >= Head
-	if ( buffer->tail >= buffer->head )
-		return buffer->head + buffer->size - buffer->tail;
+		I2C_pos = 0;
+		I2C_state = I2C_State_Address;
+		I2C_write( I2C_queue[ I2C_queueHead ].addr );
+	}
 
-	// Head > Tail
-	return buffer->head - buffer->tail;
+	__enable_irq();
 }
 
-
-void I2C_BufferPush( uint8_t byte, I2C_Buffer *buffer )
+// Queues a write, data is <addr> <reg> <data>...
+// The data is copied, so it may be modified (or go out of scope) right away
+// Returns 0 if there is no room left in the queue, try again later
+uint8_t I2C_Send( uint8_t *data, uint8_t sendLen )
 {
-	dbug_msg("DATA: ");
-	printHex( byte );
+	if ( sendLen < 2 )
+		return 0;
+	uint16_t len = sendLen - 2;
 
-	// Make sure buffer isn't full
-	if ( buffer->tail + 1 == buffer->head || ( buffer->head > buffer->tail && buffer->tail + 1 - buffer->size == buffer->head ) )
-	{
-		warn_msg("I2C_BufferPush failed, buffer full: ");
-		printHex( byte );
-		print( NL );
-		return;
-	}
+	__disable_irq();
 
-	// Check for wrap-around case
-	if ( buffer->tail + 1 >= buffer->size )
+	// Payloads are contiguous, skip the end of the pool if the payload doesn't fit
+	uint16_t pos = I2C_poolTail;
+	uint16_t skip = 0;
+	if ( pos + len > I2C_PoolLength )
 	{
-		buffer->tail = 0;
+		skip = I2C_PoolLength - pos;
+		pos = 0;
 	}
-	// Normal case
-	else
+
+	if ( I2C_queueItems >= I2C_QueueLength || I2C_poolUsed + skip + len > I2C_PoolLength )
 	{
-		buffer->tail++;
+		__enable_irq();
+		return 0;
 	}
 
-	// Add byte to buffer
-	buffer->buffer[ buffer->tail ] = byte;
-}
+	I2C_poolUsed += skip + len;
+	I2C_poolTail = pos + len;
+	memcpy( &I2C_pool[ pos ], &data[2], len );
 
+	I2C_Transaction trans = {
+		.addr = data[0],
+		.reg  = data[1],
+		.len  = len,
+		.data = &I2C_pool[ pos ],
+		.pool = skip + len,
+	};
+	I2C_queuePush( &trans );
 
-uint8_t I2C_TxBufferPop()
-{
-	// Return 0xFF if no buffer left (do not rely on this)
-	if ( I2C_BufferLen( (I2C_Buffer*)&I2C_TxBuffer ) >= I2C_TxBuffer.size )
-	{
-		erro_msg("No buffer to pop an entry from... ");
-		printHex( I2C_TxBuffer.head );
-		print(" ");
-		printHex( I2C_TxBuffer.tail );
-		print(" ");
-		printHex( I2C_TxBuffer.sequencePos );
-		print(NL);
-		return 0xFF;
-	}
+	__enable_irq();
+
+	I2C_start();
+	return 1;
+}
 
-	// If there is currently no sequence being sent, the first entry in the RingBuffer is the length
-	if ( I2C_TxBuffer.sequencePos == 0 )
+// Waits for all queued transactions to complete
+void I2C_flush()
+{
+	while ( I2C_queueItems > 0 )
 	{
-		I2C_TxBuffer.sequencePos = 0xFF; // So this doesn't become an infinite loop
-		I2C_RxBuffer.sequencePos = I2C_TxBufferPop();
-		I2C_TxBuffer.sequencePos = I2C_TxBufferPop();
+		I2C_start();
+		delay(1);
 	}
-
-	uint8_t data = I2C_TxBuffer.buffer[ I2C_TxBuffer.head ];
-
-	// Prune head
-	I2C_TxBuffer.head++;
-
-	// Wrap-around case
-	if ( I2C_TxBuffer.head >= I2C_TxBuffer.size )
-		I2C_TxBuffer.head = 0;
-
-	// Decrement buffer sequence (until next stop will be sent)
-	I2C_TxBuffer.sequencePos--;
-
-	/*
-	dbug_msg("Popping: ");
-	printHex( data );
-	print(" ");
-	printHex( I2C_TxBuffer.head );
-	print(" ");
-	printHex( I2C_TxBuffer.tail );
-	print(" ");
-	printHex( I2C_TxBuffer.sequencePos );
-	print(NL);
-	*/
-	return data;
 }
 
+volatile uint8_t I2C_recvStatus;
+void I2C_recvComplete( I2C_Transaction *trans, uint8_t status )
+{
+	I2C_recvStatus = status;
+}
 
-uint8_t I2C_Send( uint8_t *data, uint8_t sendLen, uint8_t recvLen )
+// Reads len registers starting at reg, waits until they have been received
+// Returns 0 if the chip did not respond
+uint8_t I2C_Recv( uint8_t addr, uint8_t reg, uint8_t *data, uint8_t len )
 {
-	// Check head and tail pointers
-	// If full, return 0
-	// If empty, start up I2C Master Tx
-	// If buffer is non-empty and non-full, just append to the buffer
-	switch ( I2C_BufferCopy( data, sendLen, recvLen, (I2C_Buffer*)&I2C_TxBuffer ) )
-	{
-	// Not enough buffer space...
-	case 0:
-		/*
-		erro_msg("Not enough Tx buffer space... ");
-		printHex( I2C_TxBuffer.head );
-		print(":");
-		printHex( I2C_TxBuffer.tail );
-		print("+");
-		printHex( sendLen );
-		print("|");
-		printHex( I2C_TxBuffer.size );
-		print( NL );
-		*/
+	I2C_Transaction trans = {
+		.addr     = addr,
+		.reg      = reg,
+		.read     = 1,
+		.len      = len,
+		.data     = data,
+		.complete = I2C_recvComplete,
+	};
+
+	if ( len == 0 )
 		return 0;
 
-	// Empty buffer, initialize I2C
-	case 1:
-		// Clear status flags
-		I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
-
-		// Check to see if we already have control of the bus
-		if ( I2C0_C1 & I2C_C1_MST )
-		{
-			// Already the master (ah yeah), send a repeated start
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX;
-		}
-		// Otherwise, seize control
-		else
-		{
-			// Wait...till the master dies
-			while ( I2C0_S & I2C_S_BUSY );
-
-			// Now we're the master (ah yisss), get ready to send stuffs
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
-		}
-
-		// Enable I2C interrupt
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
-
-		// Depending on what type of transfer, the first byte is configured for R or W
-		I2C0_D = I2C_TxBufferPop();
-
-		return 1;
-	}
+	I2C_recvStatus = 0xFF;
+	while ( I2C_queueAdd( &trans ) == 0 )
+		delay(1);
+	I2C_flush();
 
-	// Dirty buffer, I2C already initialized
-	return 2;
+	return I2C_recvStatus == I2C_Status_Done;
 }
 
 
@@ -663,6 +1041,19 @@ inline uint8_t LED_scan()
 		LED_currentEvent = 0;
 	}
 
+	// Restart the I2C queue if another master took the bus
+	I2C_start();
+
+	// Send frame buffer changes, all changes made within a frame period are sent together
+	if ( LED_dirtyStart < LED_dirtyEnd && systick_millis_count - LED_frameTime >= ISSILedFramePeriod_define )
+	{
+		LED_frameTime = systick_millis_count;
+
+		Perf_start( cycles );
+		LED_frameSend();
+		Perf_stop( &LED_perf[1], cycles );
+	}
+
 	return 0;
 }
 
@@ -697,61 +1088,59 @@ typedef struct LedControl {
 	uint16_t       index;
 } LedControl;
 
+// Modifies the base levels, changes are sent by LED_scan
 void LED_control( LedControl *control )
 {
-	// Only send if we've completed all other transactions
-	/*
-	if ( I2C_TxBuffer.sequencePos > 0 )
-		return;
-	*/
+	uint8_t start = 0;
+	uint8_t end = LED_TotalChannels;
 
-	// Configure based upon the given mode
-	// TODO Perhaps do gamma adjustment?
 	switch ( control->mode )
 	{
 	case LedControlMode_brightness_decrease:
-		// Don't worry about rolling over, the cycle is quick
-		LED_pageBuffer.buffer[ control->index ] -= control->amount;
-		break;
-
 	case LedControlMode_brightness_increase:
-		// Don't worry about rolling over, the cycle is quick
-		LED_pageBuffer.buffer[ control->index ] += control->amount;
+	case LedControlMode_brightness_set:
+		// Invalid led
+		if ( control->index >= LED_TotalChannels )
+			return;
+		start = control->index;
+		end = control->index + 1;
 		break;
 
-	case LedControlMode_brightness_set:
-		LED_pageBuffer.buffer[ control->index ] = control->amount;
+	default:
 		break;
+	}
 
-	case LedControlMode_brightness_decrease_all:
-		for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
+	__disable_irq();
+
+	// Configure based upon the given mode
+	// TODO Perhaps do gamma adjustment?
+	for ( uint8_t channel = start; channel < end; channel++ )
+	{
+		switch ( control->mode )
 		{
+		case LedControlMode_brightness_decrease:
+		case LedControlMode_brightness_decrease_all:
 			// Don't worry about rolling over, the cycle is quick
-			LED_pageBuffer.buffer[ channel ] -= control->amount;
-		}
-		break;
+			LED_baseBuffer[ channel ] -= control->amount;
+			break;
 
-	case LedControlMode_brightness_increase_all:
-		for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
-		{
+		case LedControlMode_brightness_increase:
+		case LedControlMode_brightness_increase_all:
 			// Don't worry about rolling over, the cycle is quick
-			LED_pageBuffer.buffer[ channel ] += control->amount;
-		}
-		break;
+			LED_baseBuffer[ channel ] += control->amount;
+			break;
 
-	case LedControlMode_brightness_set_all:
-		for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
-		{
-			LED_pageBuffer.buffer[ channel ] = control->amount;
+		case LedControlMode_brightness_set:
+		case LedControlMode_brightness_set_all:
+			LED_baseBuffer[ channel ] = control->amount;
+			break;
 		}
-		break;
+
+		LED_compose( channel );
 	}
+	LED_frameDirty( start, end );
 
-	// Sync LED buffer with ISSI chip buffer
-	// TODO Support multiple frames
-	LED_pageBuffer.i2c_addr = 0xE8; // Chip 1
-	LED_pageBuffer.reg_addr = 0x24; // Brightness section
-	LED_sendPage( (uint8_t*)&LED_pageBuffer, sizeof( LED_Buffer ), 0 );
+	__enable_irq();
 }
 
 uint8_t LED_control_timer = 0;
@@ -769,14 +1158,11 @@ void LED_control_capability( TriggerMacro *trigger, uint8_t state, uint8_t state
 	if ( stateType == 0x00 && state == 0x03 ) // Not on release
 		return;
 
-	// XXX
-	// ISSI Chip locks up if we spam updates too quickly (might be an I2C bug on this side too -HaaTa)
-	// Make sure we only send an update every 30 milliseconds at most
-	// It may be possible to optimize speed even further, but will likely require serious time with a logic analyzer
-
+	// Updates are sent at most once per frame (see LED_scan), so presses are never throttled
+	// Held keys repeat every ISSILedControlRepeat milliseconds
 	uint8_t currentTime = (uint8_t)systick_millis_count;
 	int8_t compare = (int8_t)(currentTime - LED_control_timer) & 0x7F;
-	if ( compare < 30 )
+	if ( stateType == 0x00 && state == 0x02 && compare < ISSILedControlRepeat_define )
 	{
 		return;
 	}
@@ -850,11 +1236,72 @@ void LED_control_capability( TriggerMacro *trigger, uint8_t state, uint8_t state
 	LED_control( control );
 }
 
+// mode - 0 stop, 1 play once, 2 loop, 3 toggle (loop)
+void LED_animationControl( uint8_t index, uint8_t mode )
+{
+	switch ( mode )
+	{
+	case 0:
+		__disable_irq();
+		LED_animationStop();
+		__enable_irq();
+		break;
+
+	case 3:
+		if ( LED_animation.frame && LED_animation.index == index )
+		{
+			__disable_irq();
+			LED_animationStop();
+			__enable_irq();
+			break;
+		}
+		LED_animationStart( index, 1 );
+		break;
+
+	default:
+		LED_animationStart( index, mode == 2 );
+		break;
+	}
+}
+
+void LED_animation_capability( TriggerMacro *trigger, uint8_t state, uint8_t stateType, uint8_t *args )
+{
+	// Display capability name
+	if ( stateType == 0xFF && state == 0xFF )
+	{
+		print("LED_animation_capability(index,mode)");
+		return;
+	}
+
+	// Only use capability on press
+	if ( stateType == 0x00 && state != 0x01 )
+		return;
+
+	// Interconnect broadcasting
+	// Each node runs the animation on its own leds and passes it on to the *next* node
+#if defined(ConnectEnabled_define)
+	extern uint8_t Connect_id; // connect_scan.c
+
+	// generatedKeymap.h
+	extern const Capability CapabilitiesList[];
+
+	Connect_send_RemoteCapability(
+		Connect_id + 1,
+		LED_animation_capability_index,
+		state,
+		stateType,
+		CapabilitiesList[ LED_animation_capability_index ].argCount,
+		args
+	);
+#endif
+
+	LED_animationControl( args[0], args[1] );
+}
+
 
 
 // ----- CLI Command Functions -----
 
-// TODO Currently not working correctly
 void cliFunc_i2cSend( char* args )
 {
 	char* curArgs;
@@ -869,6 +1316,27 @@ void cliFunc_i2cSend( char* args )
 
 	// No \r\n by default after the command is entered
 	print( NL );
+
+	// Queue statistics
+	if ( *args == '\0' )
+	{
+		info_msg("Transactions: ");
+		printInt32( I2C_transactions );
+		print( NL );
+		info_msg("Queued: ");
+		printInt8( I2C_queueItems );
+		print("  Pool: ");
+		printInt16( I2C_poolUsed );
+		print( NL );
+		info_msg("NAKs: ");
+		printInt16( I2C_naks );
+		print("  Failed: ");
+		printInt16( I2C_failed );
+		print("  Arbitration Lost: ");
+		printInt16( I2C_arbLost );
+		return;
+	}
+
 	info_msg("Sending: ");
 
 	// Parse args until a \0 is found
@@ -881,11 +1349,11 @@ void cliFunc_i2cSend( char* args )
 		if ( *arg1Ptr == '\0' )
 			break;
 
-		// If | is found, end sequence and start new one
+		// If | is found, end transaction and start new one
 		if ( *arg1Ptr == '|' )
 		{
 			print("| ");
-			I2C_Send( buffer, bufferLen, 0 );
+			I2C_Send( buffer, bufferLen );
 			bufferLen = 0;
 			continue;
 		}
@@ -900,7 +1368,10 @@ void cliFunc_i2cSend( char* args )
 
 	print( NL );
 
-	I2C_Send( buffer, bufferLen, 0 );
+	I2C_Send( buffer, bufferLen );
+
+	// May have changed the register page
+	LED_currentPage = 0xFF;
 }
 
 void cliFunc_i2cRecv( char* args )
@@ -909,46 +1380,40 @@ void cliFunc_i2cRecv( char* args )
 	char* arg1Ptr;
 	char* arg2Ptr = args;
 
-	// Buffer used after interpretting the args, will be sent to I2C functions
-	// NOTE: Limited to 8 bytes currently (can be increased if necessary
-	#define i2cSend_BuffLenMax 8
-	uint8_t buffer[ i2cSend_BuffLenMax ];
-	uint8_t bufferLen = 0;
-
-	// No \r\n by default after the command is entered
-	print( NL );
-	info_msg("Sending: ");
-
-	// Parse args until a \0 is found
-	while ( bufferLen < i2cSend_BuffLenMax )
+	// Address, register and number of bytes (default 1)
+	uint8_t params[3] = { 0, 0, 1 };
+	for ( uint8_t param = 0; param < sizeof( params ); param++ )
 	{
-		curArgs = arg2Ptr; // Use the previous 2nd arg pointer to separate the next arg from the list
+		curArgs = arg2Ptr;
 		CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
 
 		// Stop processing args if no more are found
 		if ( *arg1Ptr == '\0' )
 			break;
 
-		// If | is found, end sequence and start new one
-		if ( *arg1Ptr == '|' )
-		{
-			print("| ");
-			I2C_Send( buffer, bufferLen, 0 );
-			bufferLen = 0;
-			continue;
-		}
-
-		// Interpret the argument
-		buffer[ bufferLen++ ] = (uint8_t)numToInt( arg1Ptr );
-
-		// Print out the arg
-		dPrint( arg1Ptr );
-		print(" ");
+		params[ param ] = (uint8_t)numToInt( arg1Ptr );
 	}
 
+	// No \r\n by default after the command is entered
 	print( NL );
 
-	I2C_Send( buffer, bufferLen, 1 ); // Only 1 byte is ever read at a time with the ISSI chip
+	#define i2cRecv_BuffLenMax 16
+	uint8_t buffer[ i2cRecv_BuffLenMax ];
+	if ( params[2] > i2cRecv_BuffLenMax )
+		params[2] = i2cRecv_BuffLenMax;
+
+	if ( !I2C_Recv( params[0], params[1], buffer, params[2] ) )
+	{
+		erro_print("I2C NAK detected...");
+		return;
+	}
+
+	info_msg("Received: ");
+	for ( uint8_t pos = 0; pos < params[2]; pos++ )
+	{
+		printHex_op( buffer[ pos ], 2 );
+		print(" ");
+	}
 }
 
 // TODO Currently not working correctly
@@ -999,8 +1464,9 @@ void cliFunc_ledWPage( char* args )
 	uint8_t data[] = { 0xE8, numToInt( arg1Ptr ), 0 };
 
 	// Set the register page
-	while ( I2C_Send( page, sizeof( page ), 0 ) == 0 )
+	while ( I2C_Send( page, sizeof( page ) ) == 0 )
 		delay(1);
+	LED_currentPage = page[2];
 
 	// Process all args
 	for ( ;; )
@@ -1015,7 +1481,7 @@ void cliFunc_ledWPage( char* args )
 		data[2] = numToInt( arg1Ptr );
 
 		// Write register location and data to I2C
-		while ( I2C_Send( data, sizeof( data ), 0 ) == 0 )
+		while ( I2C_Send( data, sizeof( data ) ) == 0 )
 			delay(1);
 
 		// Increment address
@@ -1037,14 +1503,284 @@ void cliFunc_ledTest( char* args )
 {
 	print( NL ); // No \r\n by default after the command is entered
 	LED_sendPage( (uint8_t*)LED_defaultBrightness1, sizeof( LED_defaultBrightness1 ), 0 );
+	LED_frameReset( &LED_defaultBrightness1[2], sizeof( LED_defaultBrightness1 ) - 2 );
 }
 
 void cliFunc_ledZero( char* args )
 {
 	print( NL ); // No \r\n by default after the command is entered
 	LED_zeroPages( 0x00, 8, 0x24, 0xB4 ); // Only PWMs
+	LED_frameReset( 0, 0 );
 }
 
+void cliFunc_ledAnim( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Process index argument
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+
+	// List animations
+	if ( *arg1Ptr == '\0' )
+	{
+		print( NL );
+		info_msg("Animations: ");
+		printInt8( LED_animationsNum );
+		print( NL );
+		info_msg("Running: ");
+		if ( LED_animation.frame )
+			printInt8( LED_animation.index );
+		else
+			print("None");
+		return;
+	}
+	uint8_t index = numToInt( arg1Ptr );
+
+	// Process mode argument, defaults to play once
+	uint8_t mode = 1;
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	if ( *arg1Ptr != '\0' )
+		mode = numToInt( arg1Ptr );
+
+	print( NL );
+	LED_animationControl( index, mode );
+}
+
+#if defined(_host_)
+// Sends everything queued on the simulated bus
+void LED_benchDrain()
+{
+	while ( I2C_queueItems > 0 )
+	{
+		__disable_irq();
+		Host_i2cDeliver( I2C_PoolLength );
+		__enable_irq();
+		I2C_start();
+	}
+}
+
+void cliFunc_ledBench( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Number of frames (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	unsigned int frames = arg1Ptr[0] == '\0' ? 100 : numToInt( arg1Ptr );
+
+	// Two frames that set every channel, alternating on each tick
+	static uint8_t table[ 2 + 2 * ( 1 + LED_TotalChannels * 2 ) + 1 ];
+	uint16_t pos = 0;
+	table[ pos++ ] = 1; // Ticks per frame
+	table[ pos++ ] = LED_Blend_Replace;
+	for ( uint8_t frame = 0; frame < 2; frame++ )
+	{
+		table[ pos++ ] = LED_TotalChannels;
+		for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
+		{
+			table[ pos++ ] = channel;
+			table[ pos++ ] = frame ? 0xFF - channel : channel;
+		}
+	}
+	table[ pos++ ] = LED_AnimationEnd;
+
+	// Ticks are run here instead of by PIT1 (stopped by LED_animationStop)
+	__disable_irq();
+	LED_animationStop();
+	LED_animation.period = table[0];
+	LED_animation.ticks = 1;
+	LED_animation.blend = table[1];
+	LED_animation.start = &table[2];
+	LED_animation.frame = &table[2];
+	LED_animation.loop = 1;
+	LED_animation.index = LED_AnimationMax;
+	__enable_irq();
+
+	LED_frameSend();
+	LED_benchDrain();
+	memset( LED_perf, 0, sizeof( LED_perf ) );
+	uint32_t transactions = I2C_transactions;
+
+	for ( unsigned int frame = 0; frame < frames; frame++ )
+	{
+		pit1_isr();
+
+		// Don't wait for the frame period
+		LED_frameTime = systick_millis_count - ISSILedFramePeriod_define;
+		LED_scan();
+		LED_benchDrain();
+	}
+	transactions = I2C_transactions - transactions;
+
+	// The simulated chip must end up with the last frame
+	uint8_t mismatches = 0;
+	for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
+	{
+		if ( Host_i2cRegs[ LED_pageBuffer.reg_addr + channel ] != LED_pageBuffer.buffer[ channel ] )
+			mismatches++;
+	}
+
+	// Back to the base levels
+	__disable_irq();
+	LED_animationStop();
+	__enable_irq();
+	LED_frameSend();
+	LED_benchDrain();
+
+	print( NL );
+	info_msg("Frames: ");
+	printInt32( LED_perf[1].count );
+	print(", transactions ");
+	printInt32( transactions );
+	print(", mismatched channels ");
+	printInt8( mismatches );
+	print( NL );
+	info_msg("Animation tick ");
+	printInt32( LED_perf[0].count ? LED_perf[0].total / LED_perf[0].count : 0 );
+	print(" cycles/frame, frame send ");
+	printInt32( LED_perf[1].count ? LED_perf[1].total / LED_perf[1].count : 0 );
+	print(" cycles/frame (");
+	printInt32( LED_TotalChannels );
+	print(" channels)");
+}
+
+// Each round queues 1-5 writes of various lengths, the first one may be NAKed by the simulated chip
+// Round 1 (mod 4) is retried until it succeeds, round 3 (mod 4) runs out of retries and is dropped
+void cliFunc_i2cCheck( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Number of rounds (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	unsigned int rounds = arg1Ptr[0] == '\0' ? 20 : numToInt( arg1Ptr );
+
+	print( NL );
+	LED_benchDrain();
+
+	uint16_t naks = I2C_naks;
+	uint16_t failed = I2C_failed;
+	uint32_t sent = 0;
+	uint32_t retried = 0;
+	uint32_t dropped = 0;
+	uint32_t wraps = 0;
+	uint32_t errors = 0;
+	uint8_t seq = 0;
+
+	for ( unsigned int round = 0; round < rounds; round++ )
+	{
+		uint8_t count = 1 + round % 5;
+		uint8_t nakCount = round % 4 == 1 ? I2C_Retries : round % 4 == 3 ? I2C_Retries + 1 : 0;
+		uint32_t logStart = Host_i2cLogCount;
+		uint8_t first = seq;
+
+		// Payload byte n of a write is its sequence number + n
+		Host_i2cNaks = nakCount;
+		for ( uint8_t trans = 0; trans < count; trans++ )
+		{
+			uint8_t write[ 2 + 100 ];
+			uint8_t len = 20 + ( round * 7 + trans * 13 ) % 80;
+			write[0] = Host_i2cSlaveAddr;
+			write[1] = LED_pageBuffer.reg_addr;
+			for ( uint8_t byte = 0; byte < len; byte++ )
+				write[ 2 + byte ] = seq + byte;
+			seq++;
+
+			uint16_t tail = I2C_poolTail;
+			while ( I2C_Send( write, len + 2 ) == 0 )
+			{
+				__disable_irq();
+				Host_i2cDeliver( HOST_I2C_PER_TICK );
+				__enable_irq();
+			}
+			if ( I2C_poolTail < tail )
+				wraps++;
+		}
+		LED_benchDrain();
+		sent += count;
+
+		// Log, NAKed attempts of the first write then the remaining writes in queue order
+		uint32_t entry = logStart;
+		for ( uint8_t attempt = 0; attempt < nakCount && attempt <= I2C_Retries; attempt++, entry++ )
+		{
+			Host_I2CTransfer *transfer = &Host_i2cLog[ entry % HOST_I2C_LOG ];
+			if ( !transfer->nak || transfer->len != 0 )
+				errors++;
+		}
+		if ( nakCount > I2C_Retries )
+			dropped++;
+		else if ( nakCount > 0 )
+			retried++;
+
+		for ( uint8_t trans = nakCount > I2C_Retries ? 1 : 0; trans < count; trans++, entry++ )
+		{
+			Host_I2CTransfer *transfer = &Host_i2cLog[ entry % HOST_I2C_LOG ];
+			uint8_t tseq = first + trans;
+			uint8_t len = 20 + ( round * 7 + trans * 13 ) % 80;
+			if ( transfer->nak || transfer->len != len + 1 || transfer->data[0] != LED_pageBuffer.reg_addr )
+			{
+				errors++;
+				continue;
+			}
+			for ( uint8_t byte = 0; byte < len; byte++ )
+			{
+				if ( transfer->data[ 1 + byte ] != (uint8_t)( tseq + byte ) )
+				{
+					errors++;
+					break;
+				}
+			}
+		}
+		if ( entry != Host_i2cLogCount )
+			errors++;
+	}
+
+	// Every NAK counted, dropped writes reported, nothing left allocated
+	naks = I2C_naks - naks;
+	failed = I2C_failed - failed;
+	if ( naks != retried * I2C_Retries + dropped * ( I2C_Retries + 1 ) || failed != dropped || I2C_poolUsed != 0 )
+		errors++;
+
+	// The brightness registers were overwritten, resend the frame buffer
+	__disable_irq();
+	for ( uint8_t channel = 0; channel < LED_TotalChannels; channel++ )
+	{
+		LED_sentBuffer[ channel ] = ~LED_pageBuffer.buffer[ channel ];
+	}
+	LED_frameDirty( 0, LED_TotalChannels );
+	__enable_irq();
+
+	info_msg("Writes: ");
+	printInt32( sent );
+	print(", retried ");
+	printInt32( retried );
+	print(", dropped ");
+	printInt32( dropped );
+	print(", NAKs ");
+	printInt16( naks );
+	print(", pool wraps ");
+	printInt32( wraps );
+	print( NL );
+	if ( errors )
+	{
+		erro_msg("I2C check failed, errors: ");
+		printInt32( errors );
+	}
+	else
+	{
+		info_msg("I2C check passed");
+	}
+}
+#endif
+
 void cliFunc_ledCtrl( char* args )
 {
 	char* curArgs;
@@ -40,5 +40,6 @@ set ( Module_SRCS
 #
 set ( ModuleCompatibility
 	arm
+	host
 )
 
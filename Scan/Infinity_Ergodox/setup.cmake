@@ -41,5 +41,6 @@ set ( Module_SRCS
 #
 set ( ModuleCompatibility
 	arm
+	host
 )
 
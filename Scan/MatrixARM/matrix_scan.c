@@ -30,6 +30,8 @@
 #include <led.h>
 #include <print.h>
 #include <macro.h>
+#include <perf.h>
+#include <trace.h>
 #include <Lib/delay.h>
 
 // Local Includes
@@ -50,6 +52,70 @@ nat_ptr_t Matrix_divCounter = 0;
 #define STROBE_DELAY StrobeDelay_define
 #endif
 
+#if EventScan_define || DebounceBitPlane_define
+// Bit per sense pin (row), see Matrix_senseRead
+#define Matrix_senseMask ( Matrix_rowsNum < 32 ? ( 1u << Matrix_rowsNum ) - 1 : 0xFFFFFFFF )
+#endif
+
+#if DmaScanStrobeTime_define > 0 && EventScan_define && !DebounceBitPlane_define && !defined(GHOSTING_MATRIX)
+// Matrix scanned by PIT0/DMA, see Matrix_dmaSetup
+#define Matrix_DmaScan
+
+// Frames kept in the DMA ring
+#define Matrix_dmaFrames 4
+
+// TCD address registers are 32 bit, host pointers are not (host builds are linked below 4 GB)
+#define Matrix_dmaAddr( reg, addr ) ( *(volatile uint32_t*)&(reg) = (uint32_t)(uintptr_t)(addr) )
+
+#if defined(UARTConnectBaud_define)
+#error "DmaScanStrobeTime needs DMA channels 0 and 1, which are used by UARTConnect"
+#endif
+#endif
+
+#if IdleScanTime_define > 0
+// Matrix sleeps while no key is on, see Matrix_idleEnter
+#define Matrix_IdleScan
+
+// Available current (mA) at or below which the matrix goes idle without waiting (USB suspend)
+#define Matrix_idleLowCurrent 100
+
+// Pin control register of a pin, and interrupt status flags of a port
+// Assumes 0x1000 between PORT registers, see Lib/mk20dx.h
+#define Matrix_pinPCR( gpio ) ( (volatile unsigned int*)(&PORTA_PCR0) + (gpio).port * 0x1000 / sizeof(unsigned int) + (gpio).pin )
+#define Matrix_portISFR( port ) ( (volatile unsigned int*)(&PORTA_ISFR) + (port) * 0x1000 / sizeof(unsigned int) )
+#endif
+
+#if defined(Matrix_KeyWindows)
+// Debounce time of a key
+#define Matrix_keyDebounceTime( state ) ( (state)->debounceTime )
+#else
+#define Matrix_keyDebounceTime( state ) MinDebounceTime_define
+#endif
+
+#if DebounceBitPlane_define
+// Consecutive 1 ms samples needed to change the state of a key
+#define Matrix_debounceSamples ( MinDebounceTime_define > 0 ? MinDebounceTime_define : 1 )
+
+// Vertical counter bit-planes, enough to count to Matrix_debounceSamples
+#if   Matrix_debounceSamples < 2
+#define Matrix_debouncePlanes 1
+#elif Matrix_debounceSamples < 4
+#define Matrix_debouncePlanes 2
+#elif Matrix_debounceSamples < 8
+#define Matrix_debouncePlanes 3
+#elif Matrix_debounceSamples < 16
+#define Matrix_debouncePlanes 4
+#elif Matrix_debounceSamples < 32
+#define Matrix_debouncePlanes 5
+#elif Matrix_debounceSamples < 64
+#define Matrix_debouncePlanes 6
+#elif Matrix_debounceSamples < 128
+#define Matrix_debouncePlanes 7
+#else
+#define Matrix_debouncePlanes 8
+#endif
+#endif
+
 
 
 // ----- Function Declarations -----
@@ -58,6 +124,11 @@ nat_ptr_t Matrix_divCounter = 0;
 void cliFunc_matrixDebug( char* args );
 void cliFunc_matrixInfo( char* args );
 void cliFunc_matrixState( char* args );
+#if defined(_host_)
+void cliFunc_matrixBench( char* args );
+void cliFunc_matrixBounce( char* args );
+void cliFunc_matrixSwitch( char* args );
+#endif
 
 
 
@@ -68,23 +139,156 @@ CLIDict_Entry( matrixDebug,  "Enables matrix debug mode, prints out each scan co
 CLIDict_Entry( matrixInfo,   "Print info about the configured matrix." );
 CLIDict_Entry( matrixState,  "Prints out the current scan table N times." NL "\t\t \033[1mO\033[0m - Off, \033[1;33mP\033[0m - Press, \033[1;32mH\033[0m - Hold, \033[1;35mR\033[0m - Release, \033[1;31mI\033[0m - Invalid" );
 
+#if defined(_host_)
+CLIDict_Entry( matrixBench,  "Times N strobe/sense passes through Matrix_pin and the cached accessors, see perf." NL "\t\tDefaults to 1000 passes. Host builds only." );
+CLIDict_Entry( matrixBounce, "Replays contact bounce waveforms on switch 0:0, checks for extra presses/releases and" NL "\t\treports the latency. Args: [<scan period us>] [<keystrokes>] (default 500 us, 20). Host builds only." );
+CLIDict_Entry( matrixSwitch, "Close/open a simulated switch. Usage: matrixSwitch <col> <row> [0|1]" NL "\t\tDefaults to closed (1). Host builds only." );
+#endif
+
 CLIDict_Def( matrixCLIDict, "Matrix Module Commands" ) = {
 	CLIDict_Item( matrixDebug ),
 	CLIDict_Item( matrixInfo ),
 	CLIDict_Item( matrixState ),
+#if defined(_host_)
+	CLIDict_Item( matrixBench ),
+	CLIDict_Item( matrixBounce ),
+	CLIDict_Item( matrixSwitch ),
+#endif
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
 // Debounce Array
 KeyState Matrix_scanArray[ Matrix_colsNum * Matrix_rowsNum ];
 
+// Event Scan Arrays
+#if EventScan_define
+#if !DebounceBitPlane_define
+// Sense pins read on the previous scan, for each strobe
+uint32_t Matrix_senseState[ Matrix_colsNum ];
+
+// Sense pins that still need to be debounced, for each strobe
+uint32_t Matrix_senseUnsettled[ Matrix_colsNum ];
+#endif
+
+// Ports with at least one sense pin
+GPIO_SensePort Matrix_sensePorts[ Port_E + 1 ];
+uint8_t        Matrix_sensePortsNum = 0;
+
+_Static_assert( Matrix_rowsNum <= 32, "EventScan supports a maximum of 32 sense pins" );
+#endif
+
+// DMA Scan Arrays
+#if defined(Matrix_DmaScan)
+// Sense port captures, Matrix_dmaWords ports (from Matrix_dmaFirstPort) per strobe and Matrix_colsNum strobes per frame
+// Sized for the worst case of every GPIO port
+uint32_t Matrix_dmaRing[ Matrix_dmaFrames * Matrix_colsNum * ( Port_E + 1 ) ];
+uint8_t  Matrix_dmaWords;
+uint8_t  Matrix_dmaFirstPort;
+
+// Strobe pins toggled after each capture, moves the strobe to the next column
+uint32_t Matrix_dmaToggle[ Matrix_colsNum ];
+
+// Major loops (whole rings) captured, and strobes captured as of the previous check
+volatile uint32_t Matrix_dmaLaps;
+uint32_t Matrix_dmaCapturedPrev;
+
+// Frames debounced, and frames overwritten before they could be
+uint32_t Matrix_dmaFramesDone;
+uint32_t Matrix_dmaOverruns;
+
+// Set once the DMA is scanning, otherwise the CPU scans the matrix
+uint8_t Matrix_dmaActive = 0;
+
+_Static_assert( Matrix_dmaFrames * Matrix_colsNum <= 0x1FF, "DmaScan major loop count is 9 bits (channel linking)" );
+#endif
+
+// Idle Scan
+#if defined(Matrix_IdleScan)
+volatile MatrixIdle Matrix_idle = MatrixIdle_Scanning;
+
+// Sense pins of each port, armed to interrupt while sleeping
+uint32_t Matrix_idlePins[ Port_E + 1 ];
+
+// systick_millis_count when a key was last on, and the time every key must be off before sleeping (ms)
+uint32_t Matrix_idleActiveTime;
+uint32_t Matrix_idleTime = IdleScanTime_define;
+
+// micros() of the sense pin interrupt, until the first press after it is decided
+uint32_t Matrix_idleWakeTime;
+uint8_t  Matrix_idleWakePending = 0;
+
+// Sleeps, wakes and the latency from a wake to the first press decided after it (us)
+uint32_t Matrix_idleSleeps;
+uint32_t Matrix_idleWakes;
+uint32_t Matrix_idleLatencyCount;
+uint32_t Matrix_idleLatencySum;
+uint32_t Matrix_idleLatencyLast;
+uint32_t Matrix_idleLatencyMax;
+#endif
+
+// Bit-plane Debounce Arrays, a bit per sense pin in each word
+#if DebounceBitPlane_define
+// Debounced state of the sense pins, for each strobe
+uint32_t Matrix_debounced[ Matrix_colsNum ];
+
+// Vertical counters, consecutive samples disagreeing with Matrix_debounced (bit N of the count is in plane N)
+uint32_t Matrix_debounceCount[ Matrix_debouncePlanes ][ Matrix_colsNum ];
+
+// Debounced state given on the previous key state decision, and keys released by it
+uint32_t Matrix_decided[ Matrix_colsNum ];
+uint32_t Matrix_released[ Matrix_colsNum ];
+
+// systick_millis_count of the last sample
+uint32_t Matrix_sampleTime;
+
+_Static_assert( Matrix_rowsNum <= 32, "DebounceBitPlane supports a maximum of 32 sense pins" );
+#endif
+
+#if defined(Matrix_KeyWindows)
+// Per-key debounce time overrides, pairs of <key>, <ms> (see DebounceKeyWindows in capabilities.kll)
+const uint8_t Matrix_debounceWindows[] = { DebounceKeyWindows_define };
+#endif
+
+// Pin Accessors, resolved from Matrix_cols and Matrix_rows during setup
+GPIO_Access Matrix_colsAccess[ Matrix_colsNum ];
+GPIO_Access Matrix_rowsAccess[ Matrix_rowsNum ];
+
+#if defined(_host_)
+// Strobe/sense passes timed by matrixBench, see the perf command
+PerfCounter Matrix_benchPerf[2];
+const char *const Matrix_benchPerfLabels[] = { "Matrix_pin", "Accessors" };
+
+// Contact waveforms replayed by matrixBounce, edge times in us from the first change of the contact
+// Every edge toggles the switch, presses end closed and releases end open (odd number of edges)
+typedef struct Matrix_BounceWave {
+	const char     *name;
+	const uint16_t *press;
+	uint8_t         pressEdges;
+	const uint16_t *release;
+	uint8_t         releaseEdges;
+} Matrix_BounceWave;
+
+const uint16_t Matrix_bounceClean[] = { 0 };
+
+// MX style switch, fast bounces on first contact then a late short re-open (~1.5 ms press, ~0.9 ms release)
+const uint16_t Matrix_bounceMxPress[]   = { 0, 35, 90, 160, 230, 610, 690, 1480, 1530 };
+const uint16_t Matrix_bounceMxRelease[] = { 0, 20, 70, 140, 320, 380, 900 };
+
+const Matrix_BounceWave Matrix_bounceWaves[] = {
+	{ "Clean", Matrix_bounceClean, 1, Matrix_bounceClean, 1 },
+	{ "MX", Matrix_bounceMxPress, sizeof( Matrix_bounceMxPress ) / 2, Matrix_bounceMxRelease, sizeof( Matrix_bounceMxRelease ) / 2 },
+};
+#endif
+
 // Ghost Arrays
 #ifdef GHOSTING_MATRIX
 KeyGhost Matrix_ghostArray[ Matrix_colsNum * Matrix_rowsNum ];
 
-uint8_t col_use[Matrix_colsNum], row_use[Matrix_rowsNum];  // used count
-uint8_t col_ghost[Matrix_colsNum], row_ghost[Matrix_rowsNum];  // marked as having ghost if 1
-uint8_t col_ghost_old[Matrix_colsNum], row_ghost_old[Matrix_rowsNum];  // old ghost state
+uint8_t col_ghost[Matrix_colsNum];  // marked as having ghost if 1
+uint8_t col_ghost_old[Matrix_colsNum];  // old ghost state
+uint32_t row_ghost, row_ghost_old;  // bit per row, same as col_ghost
+
+_Static_assert( Matrix_rowsNum <= 32, "GHOSTING_MATRIX supports a maximum of 32 sense pins" );
 #endif
 
 
@@ -100,6 +304,11 @@ uint16_t matrixMaxScans  = 0;
 uint16_t matrixCurScans  = 0;
 uint16_t matrixPrevScans = 0;
 
+#if LatencyStats_define == 1
+// micros() when the sense signal of each key first disagreed with its debounced state, 0 if it has not
+uint32_t Matrix_latencyStart[ Matrix_colsNum * Matrix_rowsNum ];
+#endif
+
 // System Timer used for delaying debounce decisions
 extern volatile uint32_t systick_millis_count;
 
@@ -112,9 +321,9 @@ extern volatile uint32_t systick_millis_count;
 //       Only guaranteed to work with Freescale MK20 series uCs
 uint8_t Matrix_pin( GPIO_Pin gpio, Type type )
 {
-	// Register width is defined as size of a pointer
-	unsigned int gpio_offset = gpio.port * 0x40   / sizeof(unsigned int*);
-	unsigned int port_offset = gpio.port * 0x1000 / sizeof(unsigned int*) + gpio.pin;
+	// Register width is 32 bits
+	unsigned int gpio_offset = gpio.port * 0x40   / sizeof(unsigned int);
+	unsigned int port_offset = gpio.port * 0x1000 / sizeof(unsigned int) + gpio.pin;
 
 	// Assumes 0x40 between GPIO Port registers and 0x1000 between PORT pin registers
 	// See Lib/mk20dx.h
@@ -127,6 +336,11 @@ uint8_t Matrix_pin( GPIO_Pin gpio, Type type )
 	volatile unsigned int *GPIO_PDOR = (unsigned int*)(&GPIOA_PDIR) + gpio_offset;
 	volatile unsigned int *PORT_PCR  = (unsigned int*)(&PORTA_PCR0) + port_offset;
 
+#if defined(_host_)
+	// Apply previous pin writes to the simulated GPIO registers
+	Host_gpioUpdate();
+#endif
+
 	// Operation depends on Type
 	switch ( type )
 	{
@@ -237,6 +451,419 @@ uint8_t Matrix_pin( GPIO_Pin gpio, Type type )
 	return 0;
 }
 
+// Resolves the register block and bit of a pin
+// Assumes 0x40 between GPIO Port registers, see Lib/mk20dx.h
+GPIO_Access Matrix_access( GPIO_Pin gpio )
+{
+	GPIO_Access access = {
+		.regs = (GPIO_Regs*)( (unsigned int*)(&GPIOA_PDOR) + gpio.port * 0x40 / sizeof(unsigned int) ),
+		.mask = (1 << gpio.pin),
+	};
+	return access;
+}
+
+
+// Strobe accessors, equivalent to Matrix_pin with Type_StrobeOn/Type_StrobeOff
+inline void Matrix_strobeOn( uint8_t strobe )
+{
+	GPIO_Access *access = &Matrix_colsAccess[ strobe ];
+
+#if defined(_host_)
+	Host_gpioUpdate();
+#endif
+
+	#ifdef GHOSTING_MATRIX
+	access->regs->pcor |= access->mask;
+	access->regs->pddr |= access->mask; // output, low
+	#else
+	access->regs->pddr |= access->mask; // output, low
+	access->regs->psor |= access->mask;
+	#endif
+}
+
+inline void Matrix_strobeOff( uint8_t strobe )
+{
+	GPIO_Access *access = &Matrix_colsAccess[ strobe ];
+
+#if defined(_host_)
+	Host_gpioUpdate();
+#endif
+
+	#ifdef GHOSTING_MATRIX
+	access->regs->pddr &= ~access->mask; // input, high Z state
+	#endif
+	access->regs->pddr |= access->mask; // output, low
+	access->regs->pcor |= access->mask;
+}
+
+
+// Sense accessor, equivalent to Matrix_pin with Type_Sense
+inline uint8_t Matrix_senseGet( uint8_t sense )
+{
+	GPIO_Access *access = &Matrix_rowsAccess[ sense ];
+
+#if defined(_host_)
+	Host_gpioUpdate();
+#endif
+
+	#ifdef GHOSTING_MATRIX // inverted
+	return access->regs->pdir & access->mask ? 0 : 1;
+	#else
+	return access->regs->pdir & access->mask ? 1 : 0;
+	#endif
+}
+
+
+#if EventScan_define
+// Groups the sense pins by port, see Matrix_senseRead
+void Matrix_senseSetup()
+{
+	Matrix_sensePortsNum = 0;
+
+	for ( uint8_t port = Port_A; port <= Port_E; port++ )
+	{
+		GPIO_SensePort *sensePort = &Matrix_sensePorts[ Matrix_sensePortsNum ];
+		sensePort->mask  = 0;
+		sensePort->shift = GPIO_SenseGather;
+
+		uint8_t contiguous = 1;
+		int8_t prevSense = -1;
+		for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+		{
+			if ( Matrix_rows[ sense ].port != port )
+				continue;
+
+			// Sense bits and pins must both be consecutive
+			if ( prevSense >= 0 && ( sense != prevSense + 1
+				|| Matrix_rows[ sense ].pin != Matrix_rows[ prevSense ].pin + 1 ) )
+			{
+				contiguous = 0;
+			}
+
+			// First sense pin of the port determines the shift
+			if ( prevSense < 0 )
+				sensePort->shift = (int8_t)sense - (int8_t)Matrix_rows[ sense ].pin;
+
+			sensePort->mask |= (1 << Matrix_rows[ sense ].pin);
+			prevSense = sense;
+		}
+
+		// Port not used
+		if ( prevSense < 0 )
+			continue;
+
+		sensePort->regs = Matrix_access( (GPIO_Pin){ port, 0 } ).regs;
+		sensePort->port = port;
+		if ( !contiguous )
+			sensePort->shift = GPIO_SenseGather;
+
+		Matrix_sensePortsNum++;
+	}
+}
+
+
+// Maps the input register (pdir) of a sense port to sense bits
+inline uint32_t Matrix_sensePortMap( GPIO_SensePort *sensePort, uint32_t pdir )
+{
+	pdir &= sensePort->mask;
+
+	// Contiguous pins, shift into place
+	if ( sensePort->shift != GPIO_SenseGather )
+		return sensePort->shift >= 0 ? pdir << sensePort->shift : pdir >> -sensePort->shift;
+
+	// Otherwise map each pin of this port
+	uint32_t sense = 0;
+	for ( uint8_t pin = 0; pin < Matrix_rowsNum; pin++ )
+	{
+		if ( pdir & Matrix_rowsAccess[ pin ].mask && Matrix_rowsAccess[ pin ].regs == sensePort->regs )
+			sense |= (1 << pin);
+	}
+	return sense;
+}
+
+
+// Reads every sense pin of the currently strobed column
+// Each sense port is only read once, bit N of the result is Matrix_rows[ N ]
+inline uint32_t Matrix_senseRead()
+{
+#if defined(_host_)
+	// Apply strobe to the simulated GPIO registers
+	Host_gpioUpdate();
+#endif
+
+	uint32_t sense = 0;
+	for ( uint8_t port = 0; port < Matrix_sensePortsNum; port++ )
+	{
+		GPIO_SensePort *sensePort = &Matrix_sensePorts[ port ];
+		sense |= Matrix_sensePortMap( sensePort, sensePort->regs->pdir );
+	}
+
+	#ifdef GHOSTING_MATRIX // inverted
+	sense = ~sense & Matrix_senseMask;
+	#endif
+
+	return sense;
+}
+#endif
+
+
+#if defined(Matrix_DmaScan)
+// Starts autonomous scanning
+// PIT0 paces DMA channel 0, which captures the sense ports of the strobed column into Matrix_dmaRing
+// Each capture is linked to DMA channel 1, which toggles the strobe pins (PTOR) to the next column
+// A column is strobed for a whole PIT period before it is captured
+// Falls back to CPU scanning if the strobes are not all on the same port
+void Matrix_dmaSetup()
+{
+	GPIO_Regs *strobeRegs = Matrix_colsAccess[ 0 ].regs;
+	for ( uint8_t strobe = 1; strobe < Matrix_colsNum; strobe++ )
+	{
+		if ( Matrix_colsAccess[ strobe ].regs != strobeRegs )
+		{
+			warn_print("DmaScan needs every strobe on the same port, using CPU scanning");
+			return;
+		}
+	}
+
+#if defined(_host_)
+	if ( (uintptr_t)Matrix_dmaRing > 0xFFFFFFFF || (uintptr_t)Matrix_dmaToggle > 0xFFFFFFFF )
+	{
+		warn_print("DmaScan buffers are not below 4 GB (position independent build?), using CPU scanning");
+		return;
+	}
+#endif
+
+	// Every port from the first to the last sense port is captured
+	Matrix_dmaFirstPort = Matrix_sensePorts[ 0 ].port;
+	Matrix_dmaWords     = Matrix_sensePorts[ Matrix_sensePortsNum - 1 ].port - Matrix_dmaFirstPort + 1;
+
+	// Column N toggles itself off and column N + 1 on
+	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+	{
+		Matrix_dmaToggle[ strobe ] = Matrix_colsAccess[ strobe ].mask ^ Matrix_colsAccess[ ( strobe + 1 ) % ( Matrix_colsNum ) ].mask;
+		Matrix_strobeOff( strobe );
+	}
+	Matrix_strobeOn( 0 );
+
+	Matrix_dmaLaps         = 0;
+	Matrix_dmaCapturedPrev = 0;
+	Matrix_dmaFramesDone   = 0;
+	Matrix_dmaOverruns     = 0;
+
+	SIM_SCGC6 |= SIM_SCGC6_DMAMUX | SIM_SCGC6_PIT;
+	SIM_SCGC7 |= SIM_SCGC7_DMA;
+
+	// Minor loop offsets, each capture starts again at the first sense port
+	DMA_CR |= DMA_CR_EMLM;
+
+	// Channel 0, sense port capture, minor loop linked to channel 1 (and major loop, the last capture)
+	Matrix_dmaAddr( DMA_TCD0_SADDR, &Matrix_sensePorts[ 0 ].regs->pdir );
+	DMA_TCD0_SOFF = 0x40; // GPIO port stride
+	DMA_TCD0_ATTR = DMA_TCD_ATTR_SSIZE( DMA_TCD_ATTR_SIZE_32BIT ) | DMA_TCD_ATTR_DSIZE( DMA_TCD_ATTR_SIZE_32BIT );
+	DMA_TCD0_NBYTES_MLOFFYES = DMA_TCD_NBYTES_SMLOE
+		| DMA_TCD_NBYTES_MLOFFYES_MLOFF( -0x40 * Matrix_dmaWords )
+		| DMA_TCD_NBYTES_MLOFFYES_NBYTES( 4 * Matrix_dmaWords );
+	DMA_TCD0_SLAST = 0;
+	Matrix_dmaAddr( DMA_TCD0_DADDR, Matrix_dmaRing );
+	DMA_TCD0_DOFF = 4;
+	DMA_TCD0_DLASTSGA = -(int32_t)( 4 * Matrix_dmaFrames * Matrix_colsNum * Matrix_dmaWords );
+	DMA_TCD0_CITER_ELINKYES = DMA_TCD_CITER_ELINK | ( 1 << 9 ) | ( Matrix_dmaFrames * Matrix_colsNum );
+	DMA_TCD0_BITER_ELINKYES = DMA_TCD_BITER_ELINK | ( 1 << 9 ) | ( Matrix_dmaFrames * Matrix_colsNum );
+	DMA_TCD0_CSR = DMA_TCD_CSR_INTMAJOR | DMA_TCD_CSR_MAJORELINK | DMA_TCD_CSR_MAJORLINKCH( 1 );
+
+	// Channel 1, strobe toggle, only started by channel 0
+	Matrix_dmaAddr( DMA_TCD1_SADDR, Matrix_dmaToggle );
+	DMA_TCD1_SOFF = 4;
+	DMA_TCD1_ATTR = DMA_TCD_ATTR_SSIZE( DMA_TCD_ATTR_SIZE_32BIT ) | DMA_TCD_ATTR_DSIZE( DMA_TCD_ATTR_SIZE_32BIT );
+	DMA_TCD1_NBYTES_MLOFFNO = 4;
+	DMA_TCD1_SLAST = -(int32_t)( 4 * Matrix_colsNum );
+	Matrix_dmaAddr( DMA_TCD1_DADDR, &strobeRegs->ptor );
+	DMA_TCD1_DOFF = 0;
+	DMA_TCD1_DLASTSGA = 0;
+	DMA_TCD1_CITER_ELINKNO = Matrix_colsNum;
+	DMA_TCD1_BITER_ELINKNO = Matrix_colsNum;
+	DMA_TCD1_CSR = 0;
+
+	// PIT0 requests a capture every DmaScanStrobeTime us (DMAMUX periodic trigger)
+	PIT_MCR = 0;
+	PIT_TCTRL0 = 0;
+	PIT_LDVAL0 = F_BUS / 1000000 * DmaScanStrobeTime_define - 1;
+	DMAMUX0_CHCFG0 = 0;
+	DMAMUX0_CHCFG0 = DMAMUX_SOURCE_ALWAYS0 | DMAMUX_TRIG | DMAMUX_ENABLE;
+
+	NVIC_ENABLE_IRQ( IRQ_DMA_CH0 );
+	DMA_SERQ = 0;
+	PIT_TCTRL0 = PIT_TCTRL_TEN;
+
+	Matrix_dmaActive = 1;
+}
+
+
+// Capture ring done, channel 0 starts again at the beginning of Matrix_dmaRing
+void dma_ch0_isr()
+{
+	DMA_CINT = 0;
+
+	// Back to the first sense port, whether or not the minor loop offset was applied to the last capture
+	Matrix_dmaAddr( DMA_TCD0_SADDR, &Matrix_sensePorts[ 0 ].regs->pdir );
+
+	Matrix_dmaLaps++;
+}
+
+
+// Strobes captured since Matrix_dmaSetup
+uint32_t Matrix_dmaCaptured()
+{
+	uint32_t steps = Matrix_dmaFrames * Matrix_colsNum;
+	uint32_t laps;
+	uint32_t citer;
+	do {
+		laps  = Matrix_dmaLaps;
+		citer = DMA_TCD0_CITER_ELINKYES & 0x1FF;
+	} while ( laps != Matrix_dmaLaps );
+
+	uint32_t captured = laps * steps + steps - citer;
+
+	// The capture ring restarted, but its interrupt has not been handled yet
+	if ( captured < Matrix_dmaCapturedPrev )
+		captured += steps;
+
+	Matrix_dmaCapturedPrev = captured;
+	return captured;
+}
+#endif
+
+
+#if defined(Matrix_IdleScan)
+// Arms (or disarms) an interrupt on either edge of every sense pin
+// Writing the flag clears any interrupt left over from scanning
+void Matrix_idleArm( uint8_t arm )
+{
+	for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+	{
+		volatile unsigned int *pcr = Matrix_pinPCR( Matrix_rows[ sense ] );
+		*pcr = ( *pcr & ~PORT_PCR_IRQC_MASK ) | PORT_PCR_ISF | ( arm ? PORT_PCR_IRQC( 0xB ) : 0 );
+	}
+}
+
+
+// Stops scanning, every strobe is driven so pressing any key changes a sense pin
+// Does nothing if a sense pin is already active, it could not cause an interrupt
+void Matrix_idleEnter()
+{
+	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+		Matrix_strobeOn( strobe );
+
+	// Armed before checking, a key touched in between is either seen here or interrupts
+	Matrix_idleArm( 1 );
+
+	for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+	{
+		if ( Matrix_senseGet( sense ) )
+		{
+			Matrix_idleArm( 0 );
+			for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+				Matrix_strobeOff( strobe );
+			return;
+		}
+	}
+
+	// A wake that did not lead to a press is not timed
+	Matrix_idleWakePending = 0;
+	Matrix_idleSleeps++;
+	Matrix_idle = MatrixIdle_Sleeping;
+}
+
+
+// Sense pin changed while sleeping, from the port interrupt (or Matrix_idleSleep)
+void Matrix_idleInterrupt()
+{
+	if ( Matrix_idle != MatrixIdle_Sleeping )
+		return;
+
+	Matrix_idleArm( 0 );
+	Matrix_idleWakeTime = micros();
+	Matrix_idleWakePending = 1;
+	Matrix_idleWakes++;
+	Matrix_idle = MatrixIdle_Woken;
+}
+
+
+// Key decided in a state other than off, keeps the matrix awake
+void Matrix_idleKeyOn( KeyState *state )
+{
+	Matrix_idleActiveTime = systick_millis_count;
+
+	// First press since a sense pin woke the matrix
+	if ( Matrix_idleWakePending && state->curState == KeyState_Press )
+	{
+		Matrix_idleWakePending = 0;
+		Matrix_idleLatencyLast = micros() - Matrix_idleWakeTime;
+		Matrix_idleLatencySum += Matrix_idleLatencyLast;
+		Matrix_idleLatencyCount++;
+		if ( Matrix_idleLatencyLast > Matrix_idleLatencyMax )
+			Matrix_idleLatencyMax = Matrix_idleLatencyLast;
+	}
+}
+
+
+// Sense pin interrupt flags, set even while interrupts are disabled
+uint8_t Matrix_idleFlagged()
+{
+#if defined(_host_)
+	Host_gpioUpdate();
+#endif
+
+	for ( uint8_t port = Port_A; port <= Port_E; port++ )
+	{
+		if ( *Matrix_portISFR( port ) & Matrix_idlePins[ port ] )
+			return 1;
+	}
+	return 0;
+}
+
+
+// Called at the start of each scan while not scanning
+// Sleeps until the next interrupt, returns 1 if the matrix is still idle afterwards
+// NOTE: Interrupts are disabled during scans, WFI still returns once one is pending
+//       The port interrupt only runs after the scan, so its flags are checked directly
+uint8_t Matrix_idleSleep()
+{
+	if ( Matrix_idle == MatrixIdle_Sleeping && !Matrix_idleFlagged() )
+		__wait_for_irq();
+
+	if ( Matrix_idle == MatrixIdle_Sleeping && Matrix_idleFlagged() )
+		Matrix_idleInterrupt();
+
+	if ( Matrix_idle == MatrixIdle_Sleeping )
+		return 1;
+
+	// Back to scanning one strobe at a time
+	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+		Matrix_strobeOff( strobe );
+
+#if !DebounceBitPlane_define
+	// Decision times are 8 bit, after a long sleep they may look recent
+	// Every debounce window has expired, an eager press is not held back
+	uint8_t currentTime = (uint8_t)systick_millis_count;
+	for ( uint8_t key = 0; key < Matrix_maxKeys; key++ )
+		Matrix_scanArray[ key ].prevDecisionTime = currentTime - Matrix_keyDebounceTime( &Matrix_scanArray[ key ] );
+#endif
+
+	Matrix_idleActiveTime = systick_millis_count;
+	Matrix_idle = MatrixIdle_Scanning;
+	return 0;
+}
+
+
+// Sense pins can be on any port
+void porta_isr() { Matrix_idleInterrupt(); }
+void portb_isr() { Matrix_idleInterrupt(); }
+void portc_isr() { Matrix_idleInterrupt(); }
+void portd_isr() { Matrix_idleInterrupt(); }
+void porte_isr() { Matrix_idleInterrupt(); }
+#endif
+
 void Matrix_sense(uint8_t enable)
 {
 	for (uint8_t pin = 0; pin < Matrix_colsNum; pin++)
@@ -266,12 +893,16 @@ void Matrix_setup()
 	// Register Matrix CLI dictionary
 	CLI_registerDictionary( matrixCLIDict, matrixCLIDictName );
 
+#if defined(_host_)
+	Perf_registerGroup( "Matrix Access", Matrix_benchPerfLabels, Matrix_benchPerf, 2 );
+#endif
+
 	// Setup Strobe Pins
 	for ( uint8_t pin = 0; pin < Matrix_colsNum; pin++ )
 	{
 		Matrix_pin( Matrix_cols[ pin ], Type_StrobeSetup );
+		Matrix_colsAccess[ pin ] = Matrix_access( Matrix_cols[ pin ] );
 		#ifdef GHOSTING_MATRIX
-		col_use[pin] = 0;
 		col_ghost[pin] = 0;
 		col_ghost_old[pin] = 0;
 		#endif
@@ -281,21 +912,26 @@ void Matrix_setup()
 	for ( uint8_t pin = 0; pin < Matrix_rowsNum; pin++ )
 	{
 		Matrix_pin( Matrix_rows[ pin ], Type_SenseSetup );
-		#ifdef GHOSTING_MATRIX
-		row_use[pin] = 0;
-		row_ghost[pin] = 0;
-		row_ghost_old[pin] = 0;
-		#endif
+		Matrix_rowsAccess[ pin ] = Matrix_access( Matrix_rows[ pin ] );
 	}
+	#ifdef GHOSTING_MATRIX
+	row_ghost = 0;
+	row_ghost_old = 0;
+	#endif
 
 	// Clear out Debounce Array
 	for ( uint8_t item = 0; item < Matrix_maxKeys; item++ )
 	{
 		Matrix_scanArray[ item ].prevState        = KeyState_Off;
 		Matrix_scanArray[ item ].curState         = KeyState_Off;
+		#if !DebounceBitPlane_define
 		Matrix_scanArray[ item ].activeCount      = 0;
 		Matrix_scanArray[ item ].inactiveCount    = DebounceDivThreshold_define; // Start at 'off' steady state
 		Matrix_scanArray[ item ].prevDecisionTime = 0;
+		#endif
+		#if defined(Matrix_KeyWindows)
+		Matrix_scanArray[ item ].debounceTime     = MinDebounceTime_define;
+		#endif
 		#ifdef GHOSTING_MATRIX
 		Matrix_ghostArray[ item ].prev            = KeyState_Off;
 		Matrix_ghostArray[ item ].cur             = KeyState_Off;
@@ -303,6 +939,73 @@ void Matrix_setup()
 		#endif
 	}
 
+	#if defined(Matrix_KeyWindows)
+	// Per-key debounce times
+	for ( uint8_t pos = 0; pos + 1 < sizeof( Matrix_debounceWindows ); pos += 2 )
+	{
+		uint8_t key = Matrix_debounceWindows[ pos ];
+		if ( key >= Matrix_maxKeys )
+		{
+			warn_msg("DebounceKeyWindows, invalid key: ");
+			printHex( key );
+			print( NL );
+			continue;
+		}
+
+		Matrix_scanArray[ key ].debounceTime = Matrix_debounceWindows[ pos + 1 ];
+	}
+	#endif
+
+	#if EventScan_define
+	Matrix_senseSetup();
+	#endif
+
+	#if DebounceBitPlane_define
+	// Every key starts off, with no disagreeing samples
+	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+	{
+		Matrix_debounced[ strobe ] = 0;
+		Matrix_decided[ strobe ]   = 0;
+		Matrix_released[ strobe ]  = 0;
+		for ( uint8_t plane = 0; plane < Matrix_debouncePlanes; plane++ )
+			Matrix_debounceCount[ plane ][ strobe ] = 0;
+	}
+	Matrix_sampleTime = systick_millis_count;
+	#elif EventScan_define
+	// Debounce every key on the first scans
+	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+	{
+		Matrix_senseState[ strobe ]     = 0;
+		Matrix_senseUnsettled[ strobe ] = Matrix_senseMask;
+	}
+	#endif
+
+	#if defined(Matrix_DmaScan)
+	Matrix_dmaSetup();
+	#endif
+
+	#if defined(Matrix_IdleScan)
+	// Port interrupts of the sense pins, the pins are only armed while sleeping
+	for ( uint8_t port = Port_A; port <= Port_E; port++ )
+		Matrix_idlePins[ port ] = 0;
+	for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+		Matrix_idlePins[ Matrix_rows[ sense ].port ] |= (1 << Matrix_rows[ sense ].pin);
+	for ( uint8_t port = Port_A; port <= Port_E; port++ )
+	{
+		if ( Matrix_idlePins[ port ] )
+			NVIC_ENABLE_IRQ( ( IRQ_PORTA + port ) );
+	}
+
+	Matrix_idle             = MatrixIdle_Scanning;
+	Matrix_idleActiveTime   = systick_millis_count;
+	Matrix_idleSleeps       = 0;
+	Matrix_idleWakes        = 0;
+	Matrix_idleLatencyCount = 0;
+	Matrix_idleLatencySum   = 0;
+	Matrix_idleLatencyLast  = 0;
+	Matrix_idleLatencyMax   = 0;
+	#endif
+
 	// Clear scan stats counters
 	matrixMaxScans  = 0;
 	matrixPrevScans = 0;
@@ -337,34 +1040,503 @@ void Matrix_keyPositionDebug( KeyPosition pos )
 }
 
 
-// Scan the matrix for keypresses
-// NOTE: scanNum should be reset to 0 after a USB send (to reset all the counters)
-void Matrix_scan( uint16_t scanNum )
+#if !DebounceBitPlane_define
+// Updates the debounce counters of a key
+// Signal Detected
+// Increment count and right shift opposing count
+// This means there is a maximum of scan 13 cycles on a perfect off to on transition
+//  (coming from a steady state 0xFFFF off scans)
+// Somewhat longer with switch bounciness
+// The advantage of this is that the count is ongoing and never needs to be reset
+// State still needs to be kept track of to deal with what to send to the Macro module
+inline void Matrix_keyCount( KeyState *state, uint8_t signal )
 {
-#if ( DebounceThrottleDiv_define > 0 )
-	// Scan-rate throttling
-	// By scanning using a divider, the scan rate slowed down
-	// DebounceThrottleDiv_define == 1 means -> /2 or half scan rate
-	// This helps with bouncy switches on fast uCs
-	if ( !( Matrix_divCounter++ & (1 << ( DebounceThrottleDiv_define - 1 )) ) )
-		return;
-#endif
-
-	// Increment stats counters
-	if ( scanNum > matrixMaxScans ) matrixMaxScans = scanNum;
-	if ( scanNum == 0 )
+	if ( signal )
 	{
-		matrixPrevScans = matrixCurScans;
-		matrixCurScans = 0;
+		// Only update if not going to wrap around
+		if ( state->activeCount < DebounceDivThreshold_define ) state->activeCount += 1;
+		state->inactiveCount >>= 1;
 	}
+	// Signal Not Detected
 	else
 	{
-		matrixCurScans++;
+		// Only update if not going to wrap around
+		if ( state->inactiveCount < DebounceDivThreshold_define ) state->inactiveCount += 1;
+		state->activeCount >>= 1;
 	}
+}
+#endif
+
+
+// Sends a key state decision to the macro module (and matrix debug)
+inline void Matrix_keyDecided( uint8_t key, KeyState *state )
+{
+	// Send keystate to macro module
+	#ifndef GHOSTING_MATRIX
+	#if LatencyStats_define == 1
+	// Presses and releases carry the time the change was first seen
+	if ( Matrix_latencyStart[ key ] && ( state->curState == KeyState_Press || state->curState == KeyState_Release ) )
+	{
+		Macro_latencyStamp( Matrix_latencyStart[ key ] );
+		Matrix_latencyStart[ key ] = 0;
+	}
+	#endif
+	Macro_keyState( key, state->curState );
+	#endif
+
+	#if defined(Matrix_IdleScan)
+	// The matrix only sleeps once every key has been off for a while
+	if ( state->curState != KeyState_Off )
+		Matrix_idleKeyOn( state );
+	#endif
+
+	// Matrix Debug, only if there is a state change
+	if ( matrixDebugMode && state->curState != state->prevState )
+	{
+		// Binary trace, see the trace command
+		if ( Trace_on() )
+		{
+			if ( matrixDebugMode == 2 )
+				Trace_event( TraceEvent_MatrixState, key, state->curState );
+			else if ( state->curState == KeyState_Press )
+				Trace_event( TraceEvent_MatrixPress, key, 0 );
+		}
+		// Basic debug output
+		else if ( matrixDebugMode == 1 && state->curState == KeyState_Press )
+		{
+			printHex( key );
+			print(" ");
+		}
+		// State transition debug output
+		else if ( matrixDebugMode == 2 )
+		{
+			printHex( key );
+			Matrix_keyPositionDebug( state->curState );
+			print(" ");
+		}
+	}
+}
+
+
+#if DebounceBitPlane_define
+// Strobes a column and reads all of its sense pins, bit N is Matrix_rows[ N ]
+inline uint32_t Matrix_strobeRead( uint8_t strobe )
+{
+	#ifdef STROBE_DELAY
+	uint32_t start = micros();
+	while ((micros() - start) < STROBE_DELAY);
+	#endif
+
+	// Strobe Pin
+	Matrix_strobeOn( strobe );
+
+	#ifdef STROBE_DELAY
+	start = micros();
+	while ((micros() - start) < STROBE_DELAY);
+	#endif
+
+#if EventScan_define
+	uint32_t sample = Matrix_senseRead();
+#else
+	uint32_t sample = 0;
+	for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+		sample |= (uint32_t)Matrix_senseGet( sense ) << sense;
+#endif
+
+	// Unstrobe Pin
+	Matrix_strobeOff( strobe );
+
+	return sample;
+}
+
+
+// Adds a sample of every sense pin of a strobe to the vertical counters
+// Counters of keys agreeing with their debounced state restart, the others count up
+// Keys reaching Matrix_debounceSamples change debounced state
+inline void Matrix_debounceSample( uint8_t strobe, uint32_t sample, uint32_t time )
+{
+	uint32_t delta = sample ^ Matrix_debounced[ strobe ];
+
+#if LatencyStats_define == 1
+	// Keys starting to disagree are timestamped, keys agreeing again (glitches) are forgotten
+	uint32_t counting = 0;
+	for ( uint8_t plane = 0; plane < Matrix_debouncePlanes; plane++ )
+		counting |= Matrix_debounceCount[ plane ][ strobe ];
+
+	for ( uint32_t keys = ( delta & ~counting ) | ( ~delta & counting ); keys; keys &= keys - 1 )
+	{
+		uint8_t sense = __builtin_ctz( keys );
+		uint8_t key = Matrix_colsNum * sense + strobe;
+		Matrix_latencyStart[ key ] = delta & (1 << sense) ? ( time ? time : 1 ) : 0;
+	}
+#endif
+
+	// Ripple carry increment of the disagreeing keys, comparing against Matrix_debounceSamples on the way
+	uint32_t carry = delta;
+	uint32_t reached = delta;
+	for ( uint8_t plane = 0; plane < Matrix_debouncePlanes; plane++ )
+	{
+		uint32_t count = Matrix_debounceCount[ plane ][ strobe ] & delta;
+		uint32_t next = count ^ carry;
+		carry &= count;
+
+		Matrix_debounceCount[ plane ][ strobe ] = next;
+		reached &= Matrix_debounceSamples & (1 << plane) ? next : ~next;
+	}
+
+#if DebounceEager_define
+	// Eager press, keys that are off change state on their first active sample
+	reached |= sample & ~Matrix_debounced[ strobe ];
+#endif
+
+	// Keys that changed state start counting again
+	if ( reached )
+	{
+		Matrix_debounced[ strobe ] ^= reached;
+		for ( uint8_t plane = 0; plane < Matrix_debouncePlanes; plane++ )
+			Matrix_debounceCount[ plane ][ strobe ] &= ~reached;
+	}
+}
+
+
+// Decides the next state of the keys of a strobe, once per macro processing loop
+// Only keys that are on, or were on at the previous decision, are looked at
+inline void Matrix_keyDecisionWord( uint8_t strobe )
+{
+	uint32_t on   = Matrix_debounced[ strobe ];
+	uint32_t prev = Matrix_decided[ strobe ];
+
+	// Keys released on the previous decision are now off
+	uint32_t keys = on | prev | Matrix_released[ strobe ];
+	Matrix_released[ strobe ] = prev & ~on;
+	Matrix_decided[ strobe ]  = on;
+
+	while ( keys )
+	{
+		uint8_t sense = __builtin_ctz( keys );
+		uint32_t bit = 1 << sense;
+		keys &= keys - 1;
+
+		uint8_t key = Matrix_colsNum * sense + strobe;
+		KeyState *state = &Matrix_scanArray[ key ];
+
+		state->prevState = state->curState;
+		state->curState = on & bit
+			? ( prev & bit ? KeyState_Hold : KeyState_Press )
+			: ( prev & bit ? KeyState_Release : KeyState_Off );
+
+		Matrix_keyDecided( key, state );
+	}
+}
+
+
+// Number of consecutive samples a key has disagreed with its debounced state
+uint8_t Matrix_debounceCountGet( uint8_t key )
+{
+	uint8_t strobe = key % ( Matrix_colsNum );
+	uint8_t sense  = key / ( Matrix_colsNum );
+
+	uint8_t count = 0;
+	for ( uint8_t plane = 0; plane < Matrix_debouncePlanes; plane++ )
+		count |= ( Matrix_debounceCount[ plane ][ strobe ] >> sense & 1 ) << plane;
+	return count;
+}
+#endif
+
+
+#if !DebounceBitPlane_define
+#if LatencyStats_define == 1
+// Notes when the sense signal of a key starts to disagree with its debounced state
+// Forgotten again if the key settles back without a transition (i.e. a glitch)
+inline void Matrix_latencyTrack( uint8_t key, KeyState *state, uint8_t signal, uint32_t time )
+{
+	KeyPosition debounced = state->curState == KeyState_Invalid ? state->prevState : state->curState;
+	uint8_t on = debounced == KeyState_Press || debounced == KeyState_Hold;
+
+	if ( signal != on )
+	{
+		if ( !Matrix_latencyStart[ key ] )
+			Matrix_latencyStart[ key ] = time ? time : 1;
+	}
+	else if ( signal ? state->inactiveCount == 0 : state->activeCount == 0 )
+	{
+		Matrix_latencyStart[ key ] = 0;
+	}
+}
+#endif
+
+
+// Decides the next key state, once per macro processing loop (see Matrix_scan)
+// signal is the latest sample of the key, only used by DebounceEager
+inline void Matrix_keyDecision( uint8_t key, KeyState *state, uint8_t currentTime, uint8_t signal )
+{
+	// Check for state change if it hasn't been set
+	// But only if enough time has passed since last state change
+	// Only check if the minimum number of scans has been met
+	//   the current state is invalid
+	//   and either active or inactive count is over the debounce threshold
+	if ( state->curState == KeyState_Invalid )
+	{
+		// Determine time since last decision
+		uint8_t lastTransition = currentTime - state->prevDecisionTime;
+
+		// Attempt state transition
+		switch ( state->prevState )
+		{
+		case KeyState_Press:
+		case KeyState_Hold:
+			if ( state->activeCount > state->inactiveCount )
+			{
+				state->curState = KeyState_Hold;
+			}
+			else
+			{
+				// If not enough time has passed since Hold
+				// Keep previous state
+				if ( lastTransition < Matrix_keyDebounceTime( state ) )
+				{
+					//warn_print("FAST Release stopped");
+					state->curState = state->prevState;
+					return;
+				}
+
+				state->curState = KeyState_Release;
+			}
+			break;
+
+		case KeyState_Release:
+		case KeyState_Off:
+#if DebounceEager_define
+			// Eager press, the first active sample is enough
+			// Keys active for most of the scans are pressed too, even if the last sample bounced low
+			if ( signal || state->activeCount > state->inactiveCount )
+#else
+			if ( state->activeCount > state->inactiveCount )
+#endif
+			{
+				// If not enough time has passed since Hold
+				// Keep previous state
+				if ( lastTransition < Matrix_keyDebounceTime( state ) )
+				{
+					//warn_print("FAST Press stopped");
+					state->curState = state->prevState;
+					return;
+				}
+
+				state->curState = KeyState_Press;
+#if DebounceEager_define
+				// From here the key counts as steadily active
+				// A release needs the inactive samples to outweigh that again, bounces are not enough
+				state->activeCount   = DebounceDivThreshold_define;
+				state->inactiveCount = 0;
+#endif
+			}
+			else
+			{
+				state->curState = KeyState_Off;
+			}
+			break;
+
+		case KeyState_Invalid:
+		default:
+			erro_print("Matrix scan bug!! Report me!");
+			break;
+		}
+
+		// Update decision time
+#if DebounceEager_define
+		// Only transitions start a new debounce window
+		// An expired window is kept expired, so the 8 bit time wrapping around does not reopen it
+		if ( state->curState == KeyState_Press || state->curState == KeyState_Release )
+			state->prevDecisionTime = currentTime;
+		else if ( lastTransition >= Matrix_keyDebounceTime( state ) )
+			state->prevDecisionTime = currentTime - Matrix_keyDebounceTime( state );
+#else
+		state->prevDecisionTime = currentTime;
+#endif
+
+		Matrix_keyDecided( key, state );
+	}
+}
+
+
+#if EventScan_define
+// Debounces a sample of the sense pins of a strobe (see Matrix_senseRead)
+// sampled - senseWord is a new sample, otherwise it is the previous one and keys only get a state decision
+// decide  - first scan since the previous decision, every key of the strobe gets a new state decision
+inline void Matrix_senseDebounce( uint8_t strobe, uint32_t senseWord, uint8_t sampled, uint8_t decide, uint8_t currentTime, uint32_t scanTime )
+{
+	// Any sense pin that changed since the last scan needs to be debounced
+	Matrix_senseUnsettled[ strobe ] |= senseWord ^ Matrix_senseState[ strobe ];
+	Matrix_senseState[ strobe ] = senseWord;
 
+	// Every key needs a state decision on the first scan, otherwise only unsettled keys are looked at
+	uint32_t senseKeys = decide ? Matrix_senseMask : Matrix_senseUnsettled[ strobe ];
+	while ( senseKeys )
+	{
+		uint8_t sense = __builtin_ctz( senseKeys );
+		senseKeys &= senseKeys - 1;
+
+		// Key position
+		uint8_t key = Matrix_colsNum * sense + strobe;
+		KeyState *state = &Matrix_scanArray[ key ];
+
+		// If first scan, reset state
+		if ( decide )
+		{
+			// Set previous state, and reset current state
+			state->prevState = state->curState;
+			state->curState  = KeyState_Invalid;
+		}
+
+		uint8_t signal = senseWord & (1 << sense) ? 1 : 0;
+
+		// Settled keys have saturated counters, counting the same signal would not change them
+		if ( sampled && Matrix_senseUnsettled[ strobe ] & (1 << sense) )
+		{
+			Matrix_keyCount( state, signal );
+#if LatencyStats_define == 1
+			Matrix_latencyTrack( key, state, signal, scanTime );
+#endif
+
+			// Once the opposing count has decayed, the key is settled
+			// Saturate the count so the key debounces like any other steady state key on the next change
+			if ( signal ? state->inactiveCount == 0 : state->activeCount == 0 )
+			{
+				if ( signal )
+					state->activeCount = DebounceDivThreshold_define;
+				else
+					state->inactiveCount = DebounceDivThreshold_define;
+
+				Matrix_senseUnsettled[ strobe ] &= ~(1 << sense);
+			}
+		}
+
+		// Decide key state, if not already done since the first scan
+		Matrix_keyDecision( key, state, currentTime, signal );
+	}
+}
+#endif
+
+
+#if defined(Matrix_DmaScan)
+// Debounces the frames captured since the previous scan, oldest first
+// decide - first scan since the previous decision, made with the newest frame
+void Matrix_dmaScan( uint8_t decide, uint8_t currentTime, uint32_t scanTime )
+{
+	uint32_t frames  = Matrix_dmaCaptured() / ( Matrix_colsNum );
+	uint32_t pending = frames - Matrix_dmaFramesDone;
+
+	// The frame being captured has replaced the oldest one in the ring, frames before the others are lost
+	if ( pending > Matrix_dmaFrames - 1 )
+	{
+		Matrix_dmaOverruns  += pending - ( Matrix_dmaFrames - 1 );
+		Matrix_dmaFramesDone = frames - ( Matrix_dmaFrames - 1 );
+		pending = Matrix_dmaFrames - 1;
+	}
+
+	// No new frame, the keys still need their state decision
+	if ( !pending )
+	{
+		if ( decide )
+		{
+			for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+				Matrix_senseDebounce( strobe, Matrix_senseState[ strobe ], 0, 1, currentTime, scanTime );
+		}
+		return;
+	}
+
+	for ( ; pending; pending-- )
+	{
+		const uint32_t *frame = &Matrix_dmaRing[ ( Matrix_dmaFramesDone % Matrix_dmaFrames ) * Matrix_colsNum * Matrix_dmaWords ];
+
+		for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+		{
+			const uint32_t *ports = &frame[ strobe * Matrix_dmaWords ];
+
+			uint32_t senseWord = 0;
+			for ( uint8_t port = 0; port < Matrix_sensePortsNum; port++ )
+			{
+				GPIO_SensePort *sensePort = &Matrix_sensePorts[ port ];
+				senseWord |= Matrix_sensePortMap( sensePort, ports[ sensePort->port - Matrix_dmaFirstPort ] );
+			}
+
+			Matrix_senseDebounce( strobe, senseWord, 1, decide && pending == 1, currentTime, scanTime );
+		}
+
+		Matrix_dmaFramesDone++;
+	}
+}
+#endif
+#endif
+
+
+// Scan the matrix for keypresses
+// NOTE: scanNum should be reset to 0 after a USB send (to reset all the counters)
+void Matrix_scan( uint16_t scanNum )
+{
+#if defined(Matrix_IdleScan)
+	// Nothing to scan until a sense pin changes
+	if ( Matrix_idle != MatrixIdle_Scanning && Matrix_idleSleep() )
+		return;
+#endif
+
+#if ( DebounceThrottleDiv_define > 0 )
+	// Scan-rate throttling
+	// By scanning using a divider, the scan rate slowed down
+	// DebounceThrottleDiv_define == 1 means -> /2 or half scan rate
+	// This helps with bouncy switches on fast uCs
+	if ( !( Matrix_divCounter++ & (1 << ( DebounceThrottleDiv_define - 1 )) ) )
+		return;
+#endif
+
+	// Increment stats counters
+	if ( scanNum > matrixMaxScans ) matrixMaxScans = scanNum;
+	if ( scanNum == 0 )
+	{
+		matrixPrevScans = matrixCurScans;
+		matrixCurScans = 0;
+	}
+	else
+	{
+		matrixCurScans++;
+	}
+
+#if LatencyStats_define == 1
+	// Sense pin changes are timestamped with the start of the scan
+	uint32_t scanTime = micros();
+#else
+	uint32_t scanTime = 0;
+#endif
+
+#if DebounceBitPlane_define
+	// Sample every sense pin once per ms, debounce time is counted in samples
+	if ( systick_millis_count != Matrix_sampleTime )
+	{
+		Matrix_sampleTime = systick_millis_count;
+
+		for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+			Matrix_debounceSample( strobe, Matrix_strobeRead( strobe ), scanTime );
+	}
+
+	// Decide key states on the first scan
+	if ( scanNum == 0 )
+	{
+		for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+			Matrix_keyDecisionWord( strobe );
+	}
+#else
 	// Read systick for event scheduling
 	uint8_t currentTime = (uint8_t)systick_millis_count;
 
+#if defined(Matrix_DmaScan)
+	// Strobing is done by the DMA, only the captured frames are left to debounce
+	if ( Matrix_dmaActive )
+	{
+		Matrix_dmaScan( scanNum == 0, currentTime, scanTime );
+	}
+	else
+#endif
 	// For each strobe, scan each of the sense pins
 	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
 	{
@@ -374,13 +1546,22 @@ void Matrix_scan( uint16_t scanNum )
 		#endif
 
 		// Strobe Pin
-		Matrix_pin( Matrix_cols[ strobe ], Type_StrobeOn );
+		Matrix_strobeOn( strobe );
 
 		#ifdef STROBE_DELAY
 		start = micros();
 		while ((micros() - start) < STROBE_DELAY);
 		#endif
 
+#if EventScan_define
+		// Read all of the sense pins at once
+		uint32_t senseWord = Matrix_senseRead();
+
+		// Unstrobe Pin
+		Matrix_strobeOff( strobe );
+
+		Matrix_senseDebounce( strobe, senseWord, 1, scanNum == 0, currentTime, scanTime );
+#else
 		// Scan each of the sense pins
 		for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
 		{
@@ -396,188 +1577,82 @@ void Matrix_scan( uint16_t scanNum )
 				state->curState  = KeyState_Invalid;
 			}
 
-			// Signal Detected
-			// Increment count and right shift opposing count
-			// This means there is a maximum of scan 13 cycles on a perfect off to on transition
-			//  (coming from a steady state 0xFFFF off scans)
-			// Somewhat longer with switch bounciness
-			// The advantage of this is that the count is ongoing and never needs to be reset
-			// State still needs to be kept track of to deal with what to send to the Macro module
-			if ( Matrix_pin( Matrix_rows[ sense ], Type_Sense ) )
-			{
-				// Only update if not going to wrap around
-				if ( state->activeCount < DebounceDivThreshold_define ) state->activeCount += 1;
-				state->inactiveCount >>= 1;
-			}
-			// Signal Not Detected
-			else
-			{
-				// Only update if not going to wrap around
-				if ( state->inactiveCount < DebounceDivThreshold_define ) state->inactiveCount += 1;
-				state->activeCount >>= 1;
-			}
-
-			// Check for state change if it hasn't been set
-			// But only if enough time has passed since last state change
-			// Only check if the minimum number of scans has been met
-			//   the current state is invalid
-			//   and either active or inactive count is over the debounce threshold
-			if ( state->curState == KeyState_Invalid )
-			{
-				// Determine time since last decision
-				uint8_t lastTransition = currentTime - state->prevDecisionTime;
-
-				// Attempt state transition
-				switch ( state->prevState )
-				{
-				case KeyState_Press:
-				case KeyState_Hold:
-					if ( state->activeCount > state->inactiveCount )
-					{
-						state->curState = KeyState_Hold;
-					}
-					else
-					{
-						// If not enough time has passed since Hold
-						// Keep previous state
-						if ( lastTransition < MinDebounceTime_define )
-						{
-							//warn_print("FAST Release stopped");
-							state->curState = state->prevState;
-							continue;
-						}
-
-						state->curState = KeyState_Release;
-					}
-					break;
-
-				case KeyState_Release:
-				case KeyState_Off:
-					if ( state->activeCount > state->inactiveCount )
-					{
-						// If not enough time has passed since Hold
-						// Keep previous state
-						if ( lastTransition < MinDebounceTime_define )
-						{
-							//warn_print("FAST Press stopped");
-							state->curState = state->prevState;
-							continue;
-						}
-
-						state->curState = KeyState_Press;
-					}
-					else
-					{
-						state->curState = KeyState_Off;
-					}
-					break;
-
-				case KeyState_Invalid:
-				default:
-					erro_print("Matrix scan bug!! Report me!");
-					break;
-				}
-
-				// Update decision time
-				state->prevDecisionTime = currentTime;
-
-				// Send keystate to macro module
-				#ifndef GHOSTING_MATRIX
-				Macro_keyState( key, state->curState );
-				#endif
+			uint8_t signal = Matrix_senseGet( sense );
+			Matrix_keyCount( state, signal );
+#if LatencyStats_define == 1
+			Matrix_latencyTrack( key, state, signal, scanTime );
+#endif
 
-				// Matrix Debug, only if there is a state change
-				if ( matrixDebugMode && state->curState != state->prevState )
-				{
-					// Basic debug output
-					if ( matrixDebugMode == 1 && state->curState == KeyState_Press )
-					{
-						printHex( key );
-						print(" ");
-					}
-					// State transition debug output
-					else if ( matrixDebugMode == 2 )
-					{
-						printHex( key );
-						Matrix_keyPositionDebug( state->curState );
-						print(" ");
-					}
-				}
-			}
+			// Decide key state, if not already done since the first scan
+			Matrix_keyDecision( key, state, currentTime, signal );
 		}
 
 		// Unstrobe Pin
-		Matrix_pin( Matrix_cols[ strobe ], Type_StrobeOff );
+		Matrix_strobeOff( strobe );
+#endif
 	}
+#endif
 
 
 	// Matrix ghosting check and elimination
 	// . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . . .
 #ifdef GHOSTING_MATRIX
 	// strobe = column, sense = row
+	// Each column is a bit mask of rows
 
-	// Count (rows) use for columns
+	// Pressed keys of each column
+	// Rows used by any column, and rows used by at least two columns
+	uint32_t col_keys[Matrix_colsNum];
+	uint32_t row_used = 0;
+	uint32_t row_shared = 0;
 	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
 	{
-		uint8_t used = 0;
+#if DebounceBitPlane_define
+		// Already kept as a mask, the keys on at the last decision
+		uint32_t keys = Matrix_decided[ col ];
+#else
+		uint32_t keys = 0;
 		for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
 		{
 			uint8_t key = Matrix_colsNum * row + col;
-			KeyState *state = &Matrix_scanArray[ key ];
-			if ( keyOn(state->curState) )
-				used++;
-		}
-		col_use[col] = used;
-		col_ghost_old[col] = col_ghost[col];
-		col_ghost[col] = 0;  // clear
-	}
-
-	// Count (columns) use for rows
-	for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
-	{
-		uint8_t used = 0;
-		for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
-		{
-			uint8_t key = Matrix_colsNum * row + col;
-			KeyState *state = &Matrix_scanArray[ key ];
-			if ( keyOn(state->curState) )
-				used++;
+			if ( keyOn(Matrix_scanArray[ key ].curState) )
+				keys |= 1 << row;
 		}
-		row_use[row] = used;
-		row_ghost_old[row] = row_ghost[row];
-		row_ghost[row] = 0;  // clear
+#endif
+		col_keys[col] = keys;
+		row_shared |= row_used & keys;
+		row_used |= keys;
 	}
 
 	// Check if matrix has ghost
 	// Happens when key is pressed and some other key is pressed in same row and another in same column
+	// i.e. a column with at least two keys, on the rows shared with another column
+	row_ghost_old = row_ghost;
+	row_ghost = 0;
 	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
 	{
-		for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
-		{
-			uint8_t key = Matrix_colsNum * row + col;
-			KeyState *state = &Matrix_scanArray[ key ];
-			if ( keyOn(state->curState) && col_use[col] >= 2 && row_use[row] >= 2 )
-			{
-				// mark col and row as having ghost
-				col_ghost[col] = 1;
-				row_ghost[row] = 1;
-			}
-		}
+		uint32_t keys = col_keys[col];
+		uint32_t ghosted = keys & ( keys - 1 ) ? keys & row_shared : 0;
+
+		// mark col and rows as having ghost
+		col_ghost_old[col] = col_ghost[col];
+		col_ghost[col] = ghosted ? 1 : 0;
+		row_ghost |= ghosted;
 	}
 
 	// Send keys
 	for ( uint8_t col = 0; col < Matrix_colsNum; col++ )
 	{
+		// col or row is ghosting (crossed), now or on the previous scan
+		uint32_t ghost_rows = col_ghost[col] || col_ghost_old[col] ? 0xFFFFFFFF : row_ghost | row_ghost_old;
+
 		for ( uint8_t row = 0; row < Matrix_rowsNum; row++ )
 		{
 			uint8_t key = Matrix_colsNum * row + col;
 			KeyState *state = &Matrix_scanArray[ key ];
 			KeyGhost *st = &Matrix_ghostArray[ key ];
 
-			// col or row is ghosting (crossed)
-			uint8_t ghost = (col_ghost[col] > 0 || row_ghost[row] > 0) ? 1 : 0;
-			uint8_t ghost_old = (col_ghost_old[col] > 0 || row_ghost_old[row] > 0) ? 1 : 0;
-			ghost = ghost || ghost_old ? 1 : 0;
+			uint8_t ghost = ghost_rows & (1 << row) ? 1 : 0;
 
 			st->prev = st->cur;  // previous
 			// save state if no ghost or outside ghosted area
@@ -619,7 +1694,11 @@ void Matrix_scan( uint16_t scanNum )
 		print( NL );
 
 		// Display the state info for each key
+#if DebounceBitPlane_define
+		print("<key>:<previous state><current state> <disagreeing samples>");
+#else
 		print("<key>:<previous state><current state> <active count> <inactive count>");
+#endif
 		for ( uint8_t key = 0; key < Matrix_maxKeys; key++ )
 		{
 			// Every 4 keys, put a newline
@@ -632,15 +1711,32 @@ void Matrix_scan( uint16_t scanNum )
 			print(":");
 			Matrix_keyPositionDebug( Matrix_scanArray[ key ].prevState );
 			Matrix_keyPositionDebug( Matrix_scanArray[ key ].curState );
+#if DebounceBitPlane_define
+			print(" 0x");
+			printHex_op( Matrix_debounceCountGet( key ), 2 );
+#else
 			print(" 0x");
 			printHex_op( Matrix_scanArray[ key ].activeCount, 4 );
 			print(" 0x");
 			printHex_op( Matrix_scanArray[ key ].inactiveCount, 4 );
+#endif
 			print(" ");
 		}
 
 		print( NL );
 	}
+
+#if defined(Matrix_IdleScan)
+	// Every key has been off long enough, sleep until one is touched
+	// Only checked on the first scan, once the keys have their state decision
+	if ( scanNum == 0 && systick_millis_count - Matrix_idleActiveTime > Matrix_idleTime )
+	{
+#if defined(Matrix_DmaScan)
+		if ( !Matrix_dmaActive )
+#endif
+		Matrix_idleEnter();
+	}
+#endif
 }
 
 
@@ -648,7 +1744,10 @@ void Matrix_scan( uint16_t scanNum )
 // current - mA
 void Matrix_currentChange( unsigned int current )
 {
-	// TODO - Any potential power savings?
+#if defined(Matrix_IdleScan)
+	// Little current (USB suspend), sleep as soon as every key is off
+	Matrix_idleTime = current <= Matrix_idleLowCurrent ? 0 : IdleScanTime_define;
+#endif
 }
 
 
@@ -668,6 +1767,39 @@ void cliFunc_matrixInfo( char* args )
 	print( NL );
 	info_msg("Max Keys: ");
 	printHex( Matrix_maxKeys );
+
+#if defined(Matrix_DmaScan)
+	print( NL );
+	info_msg("DMA Scan: ");
+	if ( Matrix_dmaActive )
+	{
+		printInt32( Matrix_dmaFramesDone );
+		print(" frames, ");
+		printInt32( Matrix_dmaOverruns );
+		print(" overruns");
+	}
+	else
+	{
+		print("Off");
+	}
+#endif
+
+#if defined(Matrix_IdleScan)
+	print( NL );
+	info_msg("Idle Scan: ");
+	printInt32( Matrix_idleSleeps );
+	print(" sleeps, ");
+	printInt32( Matrix_idleWakes - Matrix_idleLatencyCount );
+	print(" wakes without a press");
+	print( NL );
+	info_msg("Wake to press: last ");
+	printInt32( Matrix_idleLatencyLast );
+	print(" us, avg ");
+	printInt32( Matrix_idleLatencyCount ? Matrix_idleLatencySum / Matrix_idleLatencyCount : 0 );
+	print(" us, max ");
+	printInt32( Matrix_idleLatencyMax );
+	print(" us");
+#endif
 }
 
 void cliFunc_matrixDebug( char* args )
@@ -720,4 +1852,257 @@ void cliFunc_matrixState( char* args )
 		matrixDebugStateCounter = (uint16_t)numToInt( arg1Ptr );
 	}
 }
+
+#if defined(_host_)
+void cliFunc_matrixBench( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Number of passes (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	unsigned int passes = arg1Ptr[0] == '\0' ? 1000 : numToInt( arg1Ptr );
+
+	print( NL );
+#if defined(Matrix_DmaScan)
+	if ( Matrix_dmaActive )
+	{
+		warn_msg("The DMA is driving the strobes");
+		return;
+	}
+#endif
+
+	// Time the register accesses only, the GPIO simulation would hide the difference
+	Host_gpioHold = 1;
+
+	for ( unsigned int pass = 0; pass < passes; pass++ )
+	{
+		// Register offsets computed from GPIO_Pin on every access (before Matrix_colsAccess)
+		Perf_start( cycles );
+		for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+		{
+			Matrix_pin( Matrix_cols[ strobe ], Type_StrobeOn );
+			for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+			{
+				Matrix_pin( Matrix_rows[ sense ], Type_Sense );
+			}
+			Matrix_pin( Matrix_cols[ strobe ], Type_StrobeOff );
+		}
+		Perf_lap( &Matrix_benchPerf[0], cycles );
+
+		// Cached register blocks and masks
+		for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
+		{
+			Matrix_strobeOn( strobe );
+			for ( uint8_t sense = 0; sense < Matrix_rowsNum; sense++ )
+			{
+				Matrix_senseGet( sense );
+			}
+			Matrix_strobeOff( strobe );
+		}
+		Perf_stop( &Matrix_benchPerf[1], cycles );
+	}
+
+	Host_gpioHold = 0;
+
+	info_msg("Matrix_pin ");
+	printInt32( Matrix_benchPerf[0].count ? Matrix_benchPerf[0].total / Matrix_benchPerf[0].count : 0 );
+	print(" cycles/pass, accessors ");
+	printInt32( Matrix_benchPerf[1].count ? Matrix_benchPerf[1].total / Matrix_benchPerf[1].count : 0 );
+	print(" cycles/pass");
+}
+
+// Replays one press or release on switch 0:0, scanning every period us for duration us
+// Presses and releases decided for key 0 are counted, returns the us from the first edge to the expected one
+// 0xFFFFFFFF if the expected transition was not decided
+uint32_t Matrix_bouncePhase( const uint16_t *edges, uint8_t num, uint8_t release, uint32_t duration, uint32_t period, uint16_t *presses, uint16_t *releases )
+{
+	GPIO_Pin strobe = Matrix_cols[0];
+	GPIO_Pin sense  = Matrix_rows[0];
+	uint32_t latency = 0xFFFFFFFF;
+
+	uint32_t phaseStart = micros();
+	for ( uint32_t elapsed = 0; elapsed < duration; elapsed = micros() - phaseStart )
+	{
+		uint32_t scanStart = micros();
+
+		// Contact level at this scan, each edge toggles it
+		uint8_t toggles = 0;
+		for ( uint8_t edge = 0; edge < num && edges[ edge ] <= elapsed; edge++ )
+			toggles++;
+		Host_switch( strobe.port, strobe.pin, sense.port, sense.pin, ( toggles & 1 ) != release );
+
+		// Same order as the main loop, the macro module consumes the key states
+		Matrix_scan( 0 );
+		Macro_process();
+
+		// Only transitions given to the macro module
+		// A transition blocked by the debounce window keeps the previous state, i.e. Press stays Press
+		KeyState *state = &Matrix_scanArray[0];
+		if ( state->curState != state->prevState )
+		{
+			switch ( state->curState )
+			{
+			case KeyState_Press:
+				(*presses)++;
+				if ( !release && latency == 0xFFFFFFFF )
+					latency = elapsed;
+				break;
+
+			case KeyState_Release:
+				(*releases)++;
+				if ( release && latency == 0xFFFFFFFF )
+					latency = elapsed;
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		while ( micros() - scanStart < period );
+	}
+
+	return latency;
+}
+
+void cliFunc_matrixBounce( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Scan period (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	uint32_t period = arg1Ptr[0] == '\0' ? 500 : numToInt( arg1Ptr );
+
+	// Number of keystrokes per waveform (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	uint16_t keystrokes = arg1Ptr[0] == '\0' ? 20 : numToInt( arg1Ptr );
+
+	print( NL );
+#if defined(Matrix_DmaScan)
+	if ( Matrix_dmaActive )
+	{
+		warn_msg("The DMA is driving the strobes");
+		return;
+	}
+#endif
+
+	// Held and released for longer than any debounce window
+	const uint32_t settle = 30000;
+
+	uint8_t failed = 0;
+	for ( uint8_t wave = 0; wave < sizeof( Matrix_bounceWaves ) / sizeof( Matrix_BounceWave ); wave++ )
+	{
+		const Matrix_BounceWave *bounce = &Matrix_bounceWaves[ wave ];
+		uint16_t presses = 0;
+		uint16_t releases = 0;
+		uint16_t missed = 0;
+		uint32_t pressTotal = 0;
+		uint32_t pressMax = 0;
+		uint32_t releaseTotal = 0;
+		uint32_t releaseMax = 0;
+
+		for ( uint16_t keystroke = 0; keystroke < keystrokes; keystroke++ )
+		{
+			uint32_t press = Matrix_bouncePhase(
+				bounce->press, bounce->pressEdges, 0,
+				bounce->press[ bounce->pressEdges - 1 ] + settle, period, &presses, &releases
+			);
+			uint32_t release = Matrix_bouncePhase(
+				bounce->release, bounce->releaseEdges, 1,
+				bounce->release[ bounce->releaseEdges - 1 ] + settle, period, &presses, &releases
+			);
+
+			if ( press == 0xFFFFFFFF || release == 0xFFFFFFFF )
+			{
+				missed++;
+				continue;
+			}
+			pressTotal += press;
+			releaseTotal += release;
+			if ( press > pressMax )
+				pressMax = press;
+			if ( release > releaseMax )
+				releaseMax = release;
+		}
+
+		// Exactly one press and one release per keystroke
+		uint16_t decided = keystrokes - missed;
+		if ( presses != keystrokes || releases != keystrokes || missed )
+			failed = 1;
+
+		info_msg("");
+		_print( bounce->name );
+		print(": presses ");
+		printInt16( presses );
+		print(", releases ");
+		printInt16( releases );
+		print(" of ");
+		printInt16( keystrokes );
+		print(" keystrokes, latency us press ");
+		printInt32( decided ? pressTotal / decided : 0 );
+		print("/");
+		printInt32( pressMax );
+		print(" release ");
+		printInt32( decided ? releaseTotal / decided : 0 );
+		print("/");
+		printInt32( releaseMax );
+		print(" (avg/max)" NL );
+	}
+
+	if ( failed )
+		erro_msg("Bounce replay failed");
+	else
+		info_msg("Bounce replay passed");
+}
+
+void cliFunc_matrixSwitch( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Column
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	if ( arg1Ptr[0] == '\0' )
+		return;
+	unsigned int col = numToInt( arg1Ptr );
+
+	// Row
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	if ( arg1Ptr[0] == '\0' )
+		return;
+	unsigned int row = numToInt( arg1Ptr );
+
+	// State (optional)
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	uint8_t closed = arg1Ptr[0] == '\0' ? 1 : numToInt( arg1Ptr ) != 0;
+
+	print( NL );
+	if ( col >= Matrix_colsNum || row >= Matrix_rowsNum )
+	{
+		warn_msg("Invalid switch position");
+		return;
+	}
+
+	GPIO_Pin strobe = Matrix_cols[ col ];
+	GPIO_Pin sense  = Matrix_rows[ row ];
+	Host_switch( strobe.port, strobe.pin, sense.port, sense.pin, closed );
+
+	info_msg("Switch ");
+	printInt8( col );
+	print(":");
+	printInt8( row );
+	print( closed ? " closed" : " open" );
+}
+#endif
 // vim:ts=8:sts=8:sw=8:noet
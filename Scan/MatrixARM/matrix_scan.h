@@ -46,6 +46,21 @@
 #error "MinDebounceTime is a minimum 0 ms"
 #endif
 
+// 1 if the list is empty, its first element is pasted onto Matrix_windowsEmpty__
+// Otherwise the result is an undefined identifier, which is 0 in #if (elements are numbers)
+#define Matrix_windowsEmpty( ... ) Matrix_windowsEmpty_( __VA_ARGS__, )
+#define Matrix_windowsEmpty_( first, ... ) Matrix_windowsEmpty__ ## first
+#define Matrix_windowsEmpty__ 1
+
+#if !Matrix_windowsEmpty( DebounceKeyWindows_define )
+// Per-key debounce times are kept in KeyState, see Matrix_debounceWindows
+#define Matrix_KeyWindows
+
+#if DebounceBitPlane_define
+#error "DebounceKeyWindows is not supported by DebounceBitPlane"
+#endif
+#endif
+
 
 
 // ----- Enums -----
@@ -122,6 +137,13 @@ typedef enum KeyPosition {
 	KeyState_Invalid,
 } KeyPosition;
 
+// Idle Scan states
+typedef enum MatrixIdle {
+	MatrixIdle_Scanning, // Keys are being scanned
+	MatrixIdle_Sleeping, // Every strobe is driven, waiting for a sense pin interrupt
+	MatrixIdle_Woken,    // Sense pin interrupt seen, scanning resumes on the next scan
+} MatrixIdle;
+
 
 
 // ----- Structs -----
@@ -132,13 +154,49 @@ typedef struct GPIO_Pin {
 	Pin  pin;
 } GPIO_Pin;
 
+// GPIO port register block (see Lib/mk20dx.h)
+typedef struct GPIO_Regs {
+	volatile unsigned int pdor;
+	volatile unsigned int psor;
+	volatile unsigned int pcor;
+	volatile unsigned int ptor;
+	volatile unsigned int pdir;
+	volatile unsigned int pddr;
+} GPIO_Regs;
+
+// Resolved register block and bit of a strobe/sense pin
+typedef struct GPIO_Access {
+	GPIO_Regs   *regs;
+	unsigned int mask;
+} GPIO_Access;
+
+// Sense pins sharing a GPIO port
+// If the pins are contiguous and in the same order as Matrix_rows, shift maps them straight to sense bits
+// Otherwise shift is GPIO_SenseGather and each sense pin is read separately
+typedef struct GPIO_SensePort {
+	GPIO_Regs   *regs;
+	unsigned int mask;
+	int8_t       shift;
+	uint8_t      port;
+} GPIO_SensePort;
+
+#define GPIO_SenseGather 0x7F
+
 // Debounce Element
+// With DebounceBitPlane the debounce counters are kept per strobe instead (see Matrix_debounceSample)
 typedef struct KeyState {
+#if !DebounceBitPlane_define
 	DebounceCounter activeCount;
 	DebounceCounter inactiveCount;
+#endif
 	KeyPosition     prevState;
 	KeyPosition     curState;
+#if !DebounceBitPlane_define
 	uint8_t         prevDecisionTime;
+#endif
+#if defined(Matrix_KeyWindows)
+	uint8_t         debounceTime; // ms, MinDebounceTime or a DebounceKeyWindows override
+#endif
 } __attribute__((packed)) KeyState;
 
 // Ghost Element, after ghost detection/cancelation
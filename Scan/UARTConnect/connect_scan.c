@@ -38,40 +38,46 @@
 #define UART_Slave  0
 #define UART_Buffer_Size UARTConnectBufSize_define
 
+// SYN + STX + Length + CRC-16
+#define UART_Frame_Overhead 5
+#define UART_Frame_MaxLength ( UART_Buffer_Size - UART_Frame_Overhead )
+
+// Max number of queued packets per Tx queue
+#define UART_Tx_Packets 16
+
+// Queued ScanCode packets are merged, the TriggerGuide count is the last header byte
+#if UARTConnectFramed_define
+#define UART_ScanCode_HeaderLength 6 // SYN STX <length> ScanCode <id> <count>
+#define UART_ScanCode_TrailerLength 2 // CRC-16
+#else
+#define UART_ScanCode_HeaderLength 5 // SYN SOH ScanCode <id> <count>
+#define UART_ScanCode_TrailerLength 0
+#endif
+#define UART_ScanCode_MaxGuides ( ( UART_Buffer_Size - UART_ScanCode_HeaderLength - UART_ScanCode_TrailerLength ) / sizeof( TriggerGuide ) )
+
+// Longest CableCheck pattern that fits into a packet, after the CableCheck <patternLen> header
+#if UARTConnectFramed_define
+#define UART_CableCheck_MaxPattern ( UART_Frame_MaxLength - 2 )
+#else
+#define UART_CableCheck_MaxPattern ( UART_Buffer_Size - 4 ) // SYN SOH CableCheck <patternLen>
+#endif
+
 
 
 // ----- Macros -----
 
-// Macro for popping from Tx ring buffer
-#define uart_fillTxFifo( uartNum ) \
-{ \
-	uint8_t fifoSize = ( ( UART##uartNum##_PFIFO & UART_PFIFO_TXFIFOSIZE ) >> 2 ); \
-	if ( fifoSize == 0 ) \
-		fifoSize = 1; \
-	if ( Connect_debug ) \
-	{ \
-		print( "TxFIFO " #uartNum " - " ); \
-		printHex( fifoSize ); \
-		print("/"); \
-		printHex( UART##uartNum##_TCFIFO ); \
-		print("/"); \
-		printHex( uart_tx_buf[ uartNum ].items ); \
-		print( NL ); \
-	} \
-	/* XXX Doesn't work well */ \
-	/* while ( UART##uartNum##_TCFIFO < fifoSize ) */ \
-	/* More reliable, albeit slower */ \
-	fifoSize -= UART##uartNum##_TCFIFO; \
-	while ( fifoSize-- != 0 ) \
-	{ \
-		if ( uart_tx_buf[ uartNum ].items == 0 ) \
-			break; \
-		UART##uartNum##_D = uart_tx_buf[ uartNum ].buffer[ uart_tx_buf[ uartNum ].head++ ]; \
-		uart_tx_buf[ uartNum ].items--; \
-		if ( uart_tx_buf[ uartNum ].head >= UART_Buffer_Size ) \
-			uart_tx_buf[ uartNum ].head = 0; \
-	} \
-}
+// TCD address registers are 32 bit, host pointers are not (host builds are linked below 4 GB)
+#define Connect_dmaAddr( reg, addr ) ( *(volatile uint32_t*)&(reg) = (uint32_t)(uintptr_t)(addr) )
+
+// Macro for starting a Tx DMA transfer (UART0 uses DMA channel 2, UART1 uses DMA channel 3)
+#define DMA_TX_START( x, ch, src, count ) \
+	case x: \
+		Connect_dmaAddr( DMA_TCD##ch##_SADDR, src ); \
+		DMA_TCD##ch##_CITER_ELINKNO = count; \
+		DMA_TCD##ch##_BITER_ELINKNO = count; \
+		DMA_TCD##ch##_CSR = DMA_TCD_CSR_INTMAJOR | DMA_TCD_CSR_DREQ; \
+		DMA_SERQ = ch; \
+		break
 
 // Macros for locking/unlock Tx buffers
 #define uart_lockTx( uartNum ) \
@@ -116,6 +122,9 @@ void cliFunc_connectLst ( char *args );
 void cliFunc_connectMst ( char *args );
 void cliFunc_connectRst ( char *args );
 void cliFunc_connectSts ( char *args );
+#if defined(_host_)
+void cliFunc_connectLpb ( char *args );
+#endif
 
 
 
@@ -140,10 +149,30 @@ typedef struct UARTStatusRx {
 } UARTStatusRx;
 
 typedef struct UARTStatusTx {
-	UARTStatus status;
-	uint8_t    lock;
+	UARTStatus       status;
+	uint8_t          lock;
+	uint8_t          queue; // Queue of the packet currently being sent
+	uint8_t          sent;  // Bytes of the current packet already sent
+	volatile uint8_t dma;   // Bytes in the active Tx DMA transfer, 0 if idle
 } UARTStatusTx;
 
+// Tx queues, ScanCodes and link management preempt everything else
+// Preemption happens between packets, a started packet is always finished first
+typedef enum UARTTxPriority {
+	UARTTxPriority_High, // CableCheck, Id*, ScanCode and Idles
+	UARTTxPriority_Low,  // Animation, RemoteCapability, RemoteOutput and RemoteInput
+	UARTTxPriority_Num,
+} UARTTxPriority;
+
+typedef struct UARTTxQueue {
+	UARTRingBuf ring;
+	uint8_t     packets[UART_Tx_Packets]; // Length of each queued packet
+	uint8_t     packetHead;
+	uint8_t     packetItems;
+	uint8_t     mergeId;    // Id of the last queued packet if it is a ScanCode packet, 0xFF otherwise
+	uint8_t     mergeStart; // Ring position of the last queued packet
+} UARTTxQueue;
+
 
 
 // ----- Variables -----
@@ -156,6 +185,9 @@ CLIDict_Entry( connectLst,  "Lists available UARTConnect commands and index id"
 CLIDict_Entry( connectMst,  "Sets the device as master. Use argument of s to set as slave." );
 CLIDict_Entry( connectRst,  "Resets both Rx and Tx connect buffers and state variables." );
 CLIDict_Entry( connectSts,  "UARTConnect status." );
+#if defined(_host_)
+CLIDict_Entry( connectLpb,  "Loops master bound Tx into slave bound Rx, then checks N bursts of ScanCode packets." NL "\t\tDefaults to 100 bursts. Host builds only." );
+#endif
 CLIDict_Def( uartConnectCLIDict, "UARTConnect Module Commands" ) = {
 	CLIDict_Item( connectCmd ),
 	CLIDict_Item( connectDbg ),
@@ -164,6 +196,9 @@ CLIDict_Def( uartConnectCLIDict, "UARTConnect Module Commands" ) = {
 	CLIDict_Item( connectMst ),
 	CLIDict_Item( connectRst ),
 	CLIDict_Item( connectSts ),
+#if defined(_host_)
+	CLIDict_Item( connectLpb ),
+#endif
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
@@ -182,6 +217,12 @@ uint8_t Connect_override = 0;   // Prevents master from automatically being set
 volatile uint8_t uarts_configured = 0;
 
 
+// -- Frame Counters --
+uint32_t Connect_framesReceived[UART_Num_Interfaces]; // Valid frames
+uint32_t Connect_framesCorrupt [UART_Num_Interfaces]; // CRC mismatch
+uint32_t Connect_framesDropped [UART_Num_Interfaces]; // Invalid length, command or contents
+
+
 // -- Rx Variables --
 
 volatile UARTDMABuf   uart_rx_buf[UART_Num_Interfaces];
@@ -190,58 +231,292 @@ volatile UARTStatusRx uart_rx_status[UART_Num_Interfaces];
 
 // -- Tx Variables --
 
-UARTRingBuf  uart_tx_buf   [UART_Num_Interfaces];
+UARTTxQueue  uart_tx_queue [UART_Num_Interfaces][UARTTxPriority_Num];
 UARTStatusTx uart_tx_status[UART_Num_Interfaces];
 
 
-// -- Ring Buffer Convenience Functions --
+// -- Tx Counters --
+uint32_t Connect_txPackets[UART_Num_Interfaces][UARTTxPriority_Num]; // Queued
+uint32_t Connect_txDropped[UART_Num_Interfaces][UARTTxPriority_Num]; // Queue full
+uint32_t Connect_txMerged [UART_Num_Interfaces];                     // ScanCodes merged into a queued packet
+
+
+// -- Loopback Check Variables --
+#if defined(_host_)
+// Set while connectLpb runs, received ScanCodes are checked against the sent sequence instead of being sent to the macro module
+uint8_t  Connect_loopActive = 0;
+uint16_t Connect_loopSent;
+uint16_t Connect_loopReceived;
+uint16_t Connect_loopErrors;
+#endif
+
+
+// -- Tx Queue Functions --
+
+inline UARTTxPriority Connect_txPriority( uint8_t command )
+{
+	switch ( command )
+	{
+	case CableCheck:
+	case IdRequest:
+	case IdEnumeration:
+	case IdReport:
+	case ScanCode:
+		return UARTTxPriority_High;
+
+	default:
+		return UARTTxPriority_Low;
+	}
+}
+
+// Starts a Tx DMA transfer of the next queued bytes, unless one is already active
+// Interrupts must be disabled (or called from the Tx DMA ISR)
+void Connect_tx_start( uint8_t uart )
+{
+	UARTStatusTx *status = &uart_tx_status[ uart ];
+
+	// Tx DMA busy, or not setup yet
+	if ( status->dma || !uarts_configured )
+		return;
+
+	// Select the next packet, unless in the middle of one
+	if ( status->sent == 0 )
+	{
+		if ( uart_tx_queue[ uart ][ UARTTxPriority_High ].packetItems > 0 )
+			status->queue = UARTTxPriority_High;
+		else if ( uart_tx_queue[ uart ][ UARTTxPriority_Low ].packetItems > 0 )
+			status->queue = UARTTxPriority_Low;
+		else
+			return;
+	}
+
+	UARTTxQueue *queue = &uart_tx_queue[ uart ][ status->queue ];
+
+	// A single transfer cannot wrap around the end of the ring
+	uint8_t count = queue->packets[ queue->packetHead ] - status->sent;
+	if ( count > UART_Buffer_Size - queue->ring.head )
+		count = UART_Buffer_Size - queue->ring.head;
+
+	status->dma = count;
+	uint8_t *src = &queue->ring.buffer[ queue->ring.head ];
+	switch ( uart )
+	{
+	DMA_TX_START( 0, 2, src, count );
+	DMA_TX_START( 1, 3, src, count );
+	}
+}
+
+// Tx DMA transfer finished, release the sent bytes and start the next transfer
+void Connect_tx_complete( uint8_t uart )
+{
+	UARTStatusTx *status = &uart_tx_status[ uart ];
+	UARTTxQueue *queue = &uart_tx_queue[ uart ][ status->queue ];
+
+	queue->ring.head += status->dma;
+	if ( queue->ring.head >= UART_Buffer_Size )
+		queue->ring.head -= UART_Buffer_Size;
+	queue->ring.items -= status->dma;
+	status->sent += status->dma;
+	status->dma = 0;
+
+	// Packet finished
+	if ( status->sent >= queue->packets[ queue->packetHead ] )
+	{
+		status->sent = 0;
+		queue->packetItems--;
+		if ( ++queue->packetHead >= UART_Tx_Packets )
+			queue->packetHead = 0;
+	}
+
+	Connect_tx_start( uart );
+}
+
+void dma_ch2_isr()
+{
+	DMA_CINT = 2;
+	Connect_tx_complete( 0 );
+}
+
+void dma_ch3_isr()
+{
+	DMA_CINT = 3;
+	Connect_tx_complete( 1 );
+}
 
-void Connect_addBytes( uint8_t *buffer, uint8_t count, uint8_t uart )
+// Queues a complete packet, never waits for space
+// If the queue is full the packet is dropped (and counted), returns 0
+uint8_t Connect_txQueue( uint8_t *buffer, uint8_t count, uint8_t uart, UARTTxPriority priority )
 {
 	// Too big to fit into buffer
 	if ( count > UART_Buffer_Size )
 	{
 		erro_msg("Too big of a command to fit into the buffer...");
-		return;
+		return 0;
 	}
 
 	// Invalid UART
 	if ( uart >= UART_Num_Interfaces )
 	{
 		erro_print("Invalid UART to send from...");
-		return;
-	}
-
-	// Delay UART copy until there's some space left
-	while ( uart_tx_buf[ uart ].items + count > UART_Buffer_Size )
-	{
-		warn_msg("Too much data to send on UART");
-		printInt8( uart );
-		print( ", waiting..." NL );
-		delay( 1 );
-		// FIXME Buffer will not drain here....
+		return 0;
 	}
 
-	// Append data to ring buffer
-	for ( uint8_t c = 0; c < count; c++ )
+	if ( Connect_debug )
 	{
-		if ( Connect_debug )
+		for ( uint8_t c = 0; c < count; c++ )
 		{
 			printHex( buffer[ c ] );
 			print(" +");
 			printInt8( uart );
 			print( NL );
 		}
+	}
+
+	UARTTxQueue *queue = &uart_tx_queue[ uart ][ priority ];
 
-		uart_tx_buf[ uart ].buffer[ uart_tx_buf[ uart ].tail++ ] = buffer[ c ];
-		uart_tx_buf[ uart ].items++;
-		if ( uart_tx_buf[ uart ].tail >= UART_Buffer_Size )
-			uart_tx_buf[ uart ].tail = 0;
-		if ( uart_tx_buf[ uart ].head == uart_tx_buf[ uart ].tail )
-			uart_tx_buf[ uart ].head++;
-		if ( uart_tx_buf[ uart ].head >= UART_Buffer_Size )
-			uart_tx_buf[ uart ].head = 0;
+	__disable_irq();
+
+	// Not enough space, the other side is not keeping up (or the link is down)
+	if ( queue->packetItems >= UART_Tx_Packets || queue->ring.items + count > UART_Buffer_Size )
+	{
+		__enable_irq();
+		Connect_txDropped[ uart ][ priority ]++;
+		return 0;
+	}
+
+	// Append packet to ring buffer
+	queue->mergeId = 0xFF;
+	queue->mergeStart = queue->ring.tail;
+	for ( uint8_t c = 0; c < count; c++ )
+	{
+		queue->ring.buffer[ queue->ring.tail++ ] = buffer[ c ];
+		if ( queue->ring.tail >= UART_Buffer_Size )
+			queue->ring.tail = 0;
 	}
+	queue->ring.items += count;
+	queue->packets[ ( queue->packetHead + queue->packetItems ) % UART_Tx_Packets ] = count;
+	queue->packetItems++;
+
+	// Start sending if the Tx DMA is idle
+	Connect_tx_start( uart );
+
+	__enable_irq();
+
+	Connect_txPackets[ uart ][ priority ]++;
+	return 1;
+}
+
+// Removes the last queued packet if it is a ScanCode packet from the same id that has not started sending
+// Only if extraBytes more would still fit into the ring
+// Its TriggerGuides are copied into guides, returns the number removed
+uint8_t Connect_txUnqueueScanCode( uint8_t uart, uint8_t id, TriggerGuide *guides, uint8_t maxGuides, uint8_t extraBytes )
+{
+	UARTTxQueue *queue = &uart_tx_queue[ uart ][ UARTTxPriority_High ];
+	UARTStatusTx *status = &uart_tx_status[ uart ];
+	uint8_t count = 0;
+
+	__disable_irq();
+
+	// Sending always starts with the oldest packet
+	uint8_t sending = status->queue == UARTTxPriority_High && ( status->dma || status->sent );
+
+	if ( queue->mergeId == id
+		&& queue->packetItems > ( sending ? 1 : 0 )
+		&& queue->ring.items + extraBytes <= UART_Buffer_Size
+	)
+	{
+		uint8_t pos = ( queue->mergeStart + UART_ScanCode_HeaderLength - 1 ) % UART_Buffer_Size;
+		count = queue->ring.buffer[ pos ];
+
+		if ( count > maxGuides )
+		{
+			count = 0;
+		}
+		else
+		{
+			for ( uint8_t byte = 0; byte < count * sizeof( TriggerGuide ); byte++ )
+			{
+				pos = pos + 1 < UART_Buffer_Size ? pos + 1 : 0;
+				((uint8_t*)guides)[ byte ] = queue->ring.buffer[ pos ];
+			}
+
+			// Rewind the ring to the start of the packet
+			uint8_t last = ( queue->packetHead + queue->packetItems - 1 ) % UART_Tx_Packets;
+			queue->ring.items -= queue->packets[ last ];
+			queue->ring.tail = queue->mergeStart;
+			queue->packetItems--;
+			queue->mergeId = 0xFF;
+		}
+	}
+
+	__enable_irq();
+
+	return count;
+}
+
+
+// CRC-16 (CCITT, 0x1021 polynomial), one nibble at a time
+const uint16_t Connect_crc16Table[] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t Connect_crc16( uint16_t crc, uint8_t *buffer, uint8_t count )
+{
+	for ( uint8_t c = 0; c < count; c++ )
+	{
+		crc = ( crc << 4 ) ^ Connect_crc16Table[ ( crc >> 12 ) ^ ( buffer[ c ] >> 4 ) ];
+		crc = ( crc << 4 ) ^ Connect_crc16Table[ ( crc >> 12 ) ^ ( buffer[ c ] & 0x0F ) ];
+	}
+
+	return crc;
+}
+
+// Queues a command packet, header must start with SYN SOH (0x16 0x01) followed by the command
+// If framing is enabled, the SYN SOH is replaced by a frame (SYN STX <length>, header, data, CRC-16)
+// Returns 0 if the packet was dropped
+// Tx buffer must already be locked
+uint8_t Connect_addPacket( uint8_t *header, uint8_t headerLen, uint8_t *data, uint8_t dataLen, uint8_t uart )
+{
+	UARTTxPriority priority = Connect_txPriority( header[2] );
+	uint8_t packet[ UART_Buffer_Size ];
+
+#if UARTConnectFramed_define
+	// Skip SYN SOH
+	header += 2;
+	headerLen -= 2;
+
+	uint8_t length = headerLen + dataLen;
+	if ( headerLen + dataLen > UART_Frame_MaxLength )
+	{
+		erro_msg("Too big of a command to fit into a frame...");
+		return 0;
+	}
+
+	packet[0] = 0x16;
+	packet[1] = 0x02;
+	packet[2] = length;
+	memcpy( &packet[3], header, headerLen );
+	memcpy( &packet[3 + headerLen], data, dataLen );
+
+	// CRC covers the length, command and arguments
+	uint16_t crc = Connect_crc16( 0xFFFF, &packet[2], length + 1 );
+	packet[3 + length] = (uint8_t)crc;
+	packet[4 + length] = (uint8_t)(crc >> 8);
+
+	return Connect_txQueue( packet, length + UART_Frame_Overhead, uart, priority );
+#else
+	if ( headerLen + dataLen > UART_Buffer_Size )
+	{
+		erro_msg("Too big of a command to fit into the buffer...");
+		return 0;
+	}
+
+	memcpy( packet, header, headerLen );
+	memcpy( &packet[ headerLen ], data, dataLen );
+
+	return Connect_txQueue( packet, headerLen + dataLen, uart, priority );
+#endif
 }
 
 
@@ -253,20 +528,20 @@ void Connect_send_CableCheck( uint8_t patternLen )
 	// Wait until the Tx buffers are ready, then lock them
 	uart_lockBothTx( UART_Master, UART_Slave );
 
+	// Pattern must fit into the packet buffer
+	if ( patternLen > UART_CableCheck_MaxPattern )
+		patternLen = UART_CableCheck_MaxPattern;
+
 	// Prepare header
 	uint8_t header[] = { 0x16, 0x01, CableCheck, patternLen };
 
-	// Send header
-	Connect_addBytes( header, sizeof( header ), UART_Master );
-	Connect_addBytes( header, sizeof( header ), UART_Slave );
-
 	// Send 0xD2 (11010010) for each argument
-	uint8_t value = 0xD2;
-	for ( uint8_t c = 0; c < patternLen; c++ )
-	{
-		Connect_addBytes( &value, 1, UART_Master );
-		Connect_addBytes( &value, 1, UART_Slave );
-	}
+	uint8_t pattern[ UART_Buffer_Size ];
+	memset( pattern, 0xD2, patternLen );
+
+	// Send packet
+	Connect_addPacket( header, sizeof( header ), pattern, patternLen, UART_Master );
+	Connect_addPacket( header, sizeof( header ), pattern, patternLen, UART_Slave );
 
 	// Release Tx buffers
 	uart_unlockTx( UART_Master );
@@ -282,7 +557,7 @@ void Connect_send_IdRequest()
 	uint8_t header[] = { 0x16, 0x01, IdRequest };
 
 	// Send header
-	Connect_addBytes( header, sizeof( header ), UART_Master );
+	Connect_addPacket( header, sizeof( header ), 0, 0, UART_Master );
 
 	// Unlock Tx
 	uart_unlockTx( UART_Master );
@@ -298,7 +573,7 @@ void Connect_send_IdEnumeration( uint8_t id )
 	uint8_t header[] = { 0x16, 0x01, IdEnumeration, id };
 
 	// Send header
-	Connect_addBytes( header, sizeof( header ), UART_Slave );
+	Connect_addPacket( header, sizeof( header ), 0, 0, UART_Slave );
 
 	// Unlock Tx
 	uart_unlockTx( UART_Slave );
@@ -314,7 +589,7 @@ void Connect_send_IdReport( uint8_t id )
 	uint8_t header[] = { 0x16, 0x01, IdReport, id };
 
 	// Send header
-	Connect_addBytes( header, sizeof( header ), UART_Master );
+	Connect_addPacket( header, sizeof( header ), 0, 0, UART_Master );
 
 	// Unlock Tx
 	uart_unlockTx( UART_Master );
@@ -328,14 +603,32 @@ void Connect_send_ScanCode( uint8_t id, TriggerGuide *scanCodeStateList, uint8_t
 	// Lock master bound Tx
 	uart_lockTx( UART_Master );
 
+	// Merge into the last queued ScanCode packet if it hasn't started sending yet
+	TriggerGuide guides[ UART_ScanCode_MaxGuides ];
+	if ( numScanCodes < UART_ScanCode_MaxGuides )
+	{
+		uint8_t queued = Connect_txUnqueueScanCode(
+			UART_Master,
+			id,
+			guides,
+			UART_ScanCode_MaxGuides - numScanCodes,
+			numScanCodes * TriggerGuideSize
+		);
+		if ( queued > 0 )
+		{
+			memcpy( &guides[ queued ], scanCodeStateList, numScanCodes * TriggerGuideSize );
+			scanCodeStateList = guides;
+			numScanCodes += queued;
+			Connect_txMerged[ UART_Master ]++;
+		}
+	}
+
 	// Prepare header
 	uint8_t header[] = { 0x16, 0x01, ScanCode, id, numScanCodes };
 
-	// Send header
-	Connect_addBytes( header, sizeof( header ), UART_Master );
-
-	// Send each of the scan codes
-	Connect_addBytes( (uint8_t*)scanCodeStateList, numScanCodes * TriggerGuideSize, UART_Master );
+	// Send header and each of the scan codes
+	if ( Connect_addPacket( header, sizeof( header ), (uint8_t*)scanCodeStateList, numScanCodes * TriggerGuideSize, UART_Master ) )
+		uart_tx_queue[ UART_Master ][ UARTTxPriority_High ].mergeId = id;
 
 	// Unlock Tx
 	uart_unlockTx( UART_Master );
@@ -352,11 +645,8 @@ void Connect_send_Animation( uint8_t id, uint8_t *paramList, uint8_t numParams )
 	// Prepare header
 	uint8_t header[] = { 0x16, 0x01, Animation, id, numParams };
 
-	// Send header
-	Connect_addBytes( header, sizeof( header ), UART_Slave );
-
-	// Send each of the scan codes
-	Connect_addBytes( paramList, numParams, UART_Slave );
+	// Send header and each of the params
+	Connect_addPacket( header, sizeof( header ), paramList, numParams, UART_Slave );
 
 	// Unlock Tx
 	uart_unlockTx( UART_Slave );
@@ -380,11 +670,8 @@ void Connect_send_RemoteCapability( uint8_t id, uint8_t capabilityIndex, uint8_t
 		// Lock slave bound Tx
 		uart_lockTx( UART_Slave );
 
-		// Send header
-		Connect_addBytes( header, sizeof( header ), UART_Slave );
-
-		// Send arguments
-		Connect_addBytes( args, numArgs, UART_Slave );
+		// Send header and arguments
+		Connect_addPacket( header, sizeof( header ), args, numArgs, UART_Slave );
 
 		// Unlock Tx
 		uart_unlockTx( UART_Slave );
@@ -396,11 +683,8 @@ void Connect_send_RemoteCapability( uint8_t id, uint8_t capabilityIndex, uint8_t
 		// Lock slave bound Tx
 		uart_lockTx( UART_Master );
 
-		// Send header
-		Connect_addBytes( header, sizeof( header ), UART_Master );
-
-		// Send arguments
-		Connect_addBytes( args, numArgs, UART_Master );
+		// Send header and arguments
+		Connect_addPacket( header, sizeof( header ), args, numArgs, UART_Master );
 
 		// Unlock Tx
 		uart_unlockTx( UART_Master );
@@ -413,12 +697,13 @@ void Connect_send_Idle( uint8_t num )
 	uart_lockBothTx( UART_Slave, UART_Master );
 
 	// Send n number of idles to reset link status (if in a bad state)
-	uint8_t value = 0x16;
-	for ( uint8_t c = 0; c < num; c++ )
-	{
-		Connect_addBytes( &value, 1, UART_Master );
-		Connect_addBytes( &value, 1, UART_Slave );
-	}
+	if ( num > UART_Buffer_Size )
+		num = UART_Buffer_Size;
+
+	uint8_t idles[ UART_Buffer_Size ];
+	memset( idles, 0x16, num );
+	Connect_txQueue( idles, num, UART_Master, UARTTxPriority_High );
+	Connect_txQueue( idles, num, UART_Slave, UARTTxPriority_High );
 
 	// Release Tx buffers
 	uart_unlockTx( UART_Master );
@@ -626,6 +911,55 @@ uint8_t Connect_receive_IdReport( uint8_t id, uint16_t *pending_bytes, uint8_t u
 TriggerGuide Connect_receive_ScanCodeBuffer;
 uint8_t Connect_receive_ScanCodeBufferPos;
 uint8_t Connect_receive_ScanCodeDeviceId;
+TriggerGuide Connect_receive_ScanCodeForward[UART_ScanCode_MaxGuides];
+uint8_t Connect_receive_ScanCodeForwardNum;
+
+// Sends a received TriggerGuide to the Macro Module (master only)
+void Connect_receive_ScanCodeAdd( uint8_t id, TriggerGuide *guide )
+{
+#if defined(_host_)
+	// Loopback check, see cliFunc_connectLpb
+	if ( Connect_loopActive )
+	{
+		if ( guide->scanCode != (uint8_t)Connect_loopReceived || guide->state != 1 + Connect_loopReceived % 3 )
+			Connect_loopErrors++;
+		Connect_loopReceived++;
+		return;
+	}
+#endif
+
+	// Adjust ScanCode offset
+	if ( id > 0 )
+	{
+		// Check if this node is too large
+		if ( id >= InterconnectNodeMax )
+		{
+			warn_msg("Not enough interconnect layout nodes configured: ");
+			printHex( id );
+			print( NL );
+			return;
+		}
+
+		// This variable is in generatedKeymaps.h
+		extern uint8_t InterconnectOffsetList[];
+		guide->scanCode = guide->scanCode + InterconnectOffsetList[ id - 1 ];
+	}
+
+	// ScanCode receive debug
+	if ( Connect_debug )
+	{
+		dbug_msg("");
+		printHex( guide->type );
+		print(" ");
+		printHex( guide->state );
+		print(" ");
+		printHex( guide->scanCode );
+		print( NL );
+	}
+
+	// Send ScanCode to macro module
+	Macro_pressReleaseAdd( guide );
+}
 
 uint8_t Connect_receive_ScanCode( uint8_t byte, uint16_t *pending_bytes, uint8_t uart_num )
 {
@@ -657,75 +991,42 @@ uint8_t Connect_receive_ScanCode( uint8_t byte, uint16_t *pending_bytes, uint8_t
 		if ( Connect_receive_ScanCodeBufferPos >= sizeof( TriggerGuide ) )
 		{
 			Connect_receive_ScanCodeBufferPos = 0;
-
-			// Adjust ScanCode offset
-			if ( Connect_receive_ScanCodeDeviceId > 0 )
-			{
-				// Check if this node is too large
-				if ( Connect_receive_ScanCodeDeviceId >= InterconnectNodeMax )
-				{
-					warn_msg("Not enough interconnect layout nodes configured: ");
-					printHex( Connect_receive_ScanCodeDeviceId );
-					print( NL );
-					break;
-				}
-
-				// This variable is in generatedKeymaps.h
-				extern uint8_t InterconnectOffsetList[];
-				Connect_receive_ScanCodeBuffer.scanCode = Connect_receive_ScanCodeBuffer.scanCode + InterconnectOffsetList[ Connect_receive_ScanCodeDeviceId - 1 ];
-			}
-
-			// ScanCode receive debug
-			if ( Connect_debug )
-			{
-				dbug_msg("");
-				printHex( Connect_receive_ScanCodeBuffer.type );
-				print(" ");
-				printHex( Connect_receive_ScanCodeBuffer.state );
-				print(" ");
-				printHex( Connect_receive_ScanCodeBuffer.scanCode );
-				print( NL );
-			}
-
-			// Send ScanCode to macro module
-			Macro_pressReleaseAdd( &Connect_receive_ScanCodeBuffer );
+			Connect_receive_ScanCodeAdd( Connect_receive_ScanCodeDeviceId, &Connect_receive_ScanCodeBuffer );
 		}
 
 		break;
 	}
 	// Propagate ScanCode packet
-	// XXX It would be safer to buffer the scancodes first, before transmitting the packet -Jacob
-	//     The current method is the more efficient/aggressive, but could cause issues if there were errors during transmission
+	// The scancodes are buffered first, then queued as a single packet
 	else switch ( (*pending_bytes)-- )
 	{
 	// Byte count always starts at 0xFFFF
 	case 0xFFFF: // Device Id
-	{
 		Connect_receive_ScanCodeDeviceId = byte;
-
-		// Lock the master Tx buffer
-		uart_lockTx( UART_Master );
-
-		// Send header + Id byte
-		uint8_t header[] = { 0x16, 0x01, ScanCode, byte };
-		Connect_addBytes( header, sizeof( header ), UART_Master );
 		break;
-	}
+
 	case 0xFFFE: // Number of TriggerGuides in bytes
 		*pending_bytes = byte * sizeof( TriggerGuide );
 		Connect_receive_ScanCodeBufferPos = 0;
-
-		// Pass through byte
-		Connect_addBytes( &byte, 1, UART_Master );
+		Connect_receive_ScanCodeForwardNum = byte;
 		break;
 
 	default:
-		// Pass through byte
-		Connect_addBytes( &byte, 1, UART_Master );
+		// Packets that are too large to forward are dropped
+		if ( Connect_receive_ScanCodeBufferPos < sizeof( Connect_receive_ScanCodeForward ) )
+		{
+			((uint8_t*)Connect_receive_ScanCodeForward)[ Connect_receive_ScanCodeBufferPos++ ] = byte;
+		}
 
-		// Unlock Tx Buffer after sending last byte
-		if ( *pending_bytes == 0 )
-			uart_unlockTx( UART_Master );
+		// Send after receiving the last byte
+		if ( *pending_bytes == 0 && Connect_receive_ScanCodeForwardNum <= UART_ScanCode_MaxGuides )
+		{
+			Connect_send_ScanCode(
+				Connect_receive_ScanCodeDeviceId,
+				Connect_receive_ScanCodeForward,
+				Connect_receive_ScanCodeForwardNum
+			);
+		}
 		break;
 	}
 
@@ -744,6 +1045,63 @@ uint8_t Connect_receive_Animation( uint8_t byte, uint16_t *pending_bytes, uint8_
 RemoteCapabilityCommand Connect_receive_RemoteCapabilityBuffer;
 uint8_t Connect_receive_RemoteCapabilityArgs[Connect_receive_RemoteCapabilityMaxArgs];
 
+// Runs and/or forwards a fully received Remote Capability
+// Arguments start at Connect_receive_RemoteCapabilityArgs[2]
+void Connect_receive_RemoteCapabilityDispatch( uint8_t uart_num )
+{
+	// Determine if this is the node to run the capability on
+	// Conditions: Matches or broadcast (0xFF)
+	if ( Connect_receive_RemoteCapabilityBuffer.id == 0xFF
+		|| Connect_receive_RemoteCapabilityBuffer.id == Connect_id )
+	{
+		extern const Capability CapabilitiesList[]; // See generatedKeymap.h
+		void (*capability)(uint8_t, uint8_t, uint8_t*) = (void(*)(uint8_t, uint8_t, uint8_t*))(
+			CapabilitiesList[ Connect_receive_RemoteCapabilityBuffer.capabilityIndex ].func
+		);
+		capability(
+			Connect_receive_RemoteCapabilityBuffer.state,
+			Connect_receive_RemoteCapabilityBuffer.stateType,
+			&Connect_receive_RemoteCapabilityArgs[2]
+		);
+	}
+
+	// If this is not the correct node, keep sending it in the same direction (doesn't matter if more nodes exist)
+	// or if this is a broadcast
+	if ( Connect_receive_RemoteCapabilityBuffer.id == 0xFF
+		|| Connect_receive_RemoteCapabilityBuffer.id != Connect_id )
+	{
+		// Prepare outgoing packet
+		uint8_t header[] = {
+			0x16, 0x01, RemoteCapability,
+			Connect_receive_RemoteCapabilityBuffer.id,
+			Connect_receive_RemoteCapabilityBuffer.capabilityIndex,
+			Connect_receive_RemoteCapabilityBuffer.state,
+			Connect_receive_RemoteCapabilityBuffer.stateType,
+			Connect_receive_RemoteCapabilityBuffer.numArgs,
+		};
+
+		// Send to the other UART (not the one receiving the packet from
+		uint8_t uart_direction = uart_num == UART_Master ? UART_Slave : UART_Master;
+
+		// Lock Tx UART
+		switch ( uart_direction )
+		{
+		case UART_Master: uart_lockTx( UART_Master ); break;
+		case UART_Slave:  uart_lockTx( UART_Slave );  break;
+		}
+
+		// Send Remote Capability and arguments
+		Connect_addPacket( header, sizeof( header ), &Connect_receive_RemoteCapabilityArgs[2], Connect_receive_RemoteCapabilityBuffer.numArgs, uart_direction );
+
+		// Unlock Tx UART
+		switch ( uart_direction )
+		{
+		case UART_Master: uart_unlockTx( UART_Master ); break;
+		case UART_Slave:  uart_unlockTx( UART_Slave );  break;
+		}
+	}
+}
+
 uint8_t Connect_receive_RemoteCapability( uint8_t byte, uint16_t *pending_bytes, uint8_t uart_num )
 {
 	// Check which byte in the packet we are at
@@ -779,55 +1137,7 @@ uint8_t Connect_receive_RemoteCapability( uint8_t byte, uint16_t *pending_bytes,
 		// If entire packet has been fully received
 		if ( *pending_bytes == 0 )
 		{
-			// Determine if this is the node to run the capability on
-			// Conditions: Matches or broadcast (0xFF)
-			if ( Connect_receive_RemoteCapabilityBuffer.id == 0xFF
-				|| Connect_receive_RemoteCapabilityBuffer.id == Connect_id )
-			{
-				extern const Capability CapabilitiesList[]; // See generatedKeymap.h
-				void (*capability)(uint8_t, uint8_t, uint8_t*) = (void(*)(uint8_t, uint8_t, uint8_t*))(
-					CapabilitiesList[ Connect_receive_RemoteCapabilityBuffer.capabilityIndex ].func
-				);
-				capability(
-					Connect_receive_RemoteCapabilityBuffer.state,
-					Connect_receive_RemoteCapabilityBuffer.stateType,
-					&Connect_receive_RemoteCapabilityArgs[2]
-				);
-			}
-
-			// If this is not the correct node, keep sending it in the same direction (doesn't matter if more nodes exist)
-			// or if this is a broadcast
-			if ( Connect_receive_RemoteCapabilityBuffer.id == 0xFF
-				|| Connect_receive_RemoteCapabilityBuffer.id != Connect_id )
-			{
-				// Prepare outgoing packet
-				Connect_receive_RemoteCapabilityBuffer.command = RemoteCapability;
-
-				// Send to the other UART (not the one receiving the packet from
-				uint8_t uart_direction = uart_num == UART_Master ? UART_Slave : UART_Master;
-
-				// Lock Tx UART
-				switch ( uart_direction )
-				{
-				case UART_Master: uart_lockTx( UART_Master ); break;
-				case UART_Slave:  uart_lockTx( UART_Slave );  break;
-				}
-
-				// Send header
-				uint8_t header[] = { 0x16, 0x01 };
-				Connect_addBytes( header, sizeof( header ), uart_direction );
-
-				// Send Remote Capability and arguments
-				Connect_addBytes( (uint8_t*)&Connect_receive_RemoteCapabilityBuffer, sizeof( RemoteCapabilityCommand ), uart_direction );
-				Connect_addBytes( Connect_receive_RemoteCapabilityArgs, Connect_receive_RemoteCapabilityBuffer.numArgs, uart_direction );
-
-				// Unlock Tx UART
-				switch ( uart_direction )
-				{
-				case UART_Master: uart_unlockTx( UART_Master ); break;
-				case UART_Slave:  uart_unlockTx( UART_Slave );  break;
-				}
-			}
+			Connect_receive_RemoteCapabilityDispatch( uart_num );
 		}
 		break;
 	}
@@ -854,6 +1164,124 @@ void *Connect_receiveFunctions[] = {
 };
 
 
+// -- Connect frame receive functions --
+// Called with the arguments of a complete, CRC validated frame
+// Return 0 if the arguments are not valid for the command
+
+uint8_t Connect_receiveFrame_ScanCode( uint8_t *args, uint8_t length, uint8_t uart_num )
+{
+	// Id + Number of TriggerGuides + TriggerGuides
+	if ( length < 2 || length != 2 + args[1] * sizeof( TriggerGuide ) )
+		return 0;
+
+	// Check the directionality
+	if ( uart_num == UART_Master )
+	{
+		erro_print("Invalid ScanCode direction...");
+	}
+
+	uint8_t id = args[0];
+	TriggerGuide *guides = (TriggerGuide*)&args[2];
+
+	// Master node, trigger scan codes
+	if ( Connect_master )
+	{
+		for ( uint8_t guide = 0; guide < args[1]; guide++ )
+		{
+			Connect_receive_ScanCodeAdd( id, &guides[ guide ] );
+		}
+	}
+	// Propagate ScanCode packet
+	else
+	{
+		Connect_send_ScanCode( id, guides, args[1] );
+	}
+
+	return 1;
+}
+
+uint8_t Connect_receiveFrame_RemoteCapability( uint8_t *args, uint8_t length, uint8_t uart_num )
+{
+	// Id + Capability Index + State + StateType + Number of args + args
+	if ( length < 5 || length != 5 + args[4] || args[4] > Connect_receive_RemoteCapabilityMaxArgs - 2 )
+		return 0;
+
+	Connect_receive_RemoteCapabilityBuffer.id              = args[0];
+	Connect_receive_RemoteCapabilityBuffer.capabilityIndex = args[1];
+	Connect_receive_RemoteCapabilityBuffer.state           = args[2];
+	Connect_receive_RemoteCapabilityBuffer.stateType       = args[3];
+	Connect_receive_RemoteCapabilityBuffer.numArgs         = args[4];
+	memcpy( &Connect_receive_RemoteCapabilityArgs[2], &args[5], args[4] );
+
+	Connect_receive_RemoteCapabilityDispatch( uart_num );
+	return 1;
+}
+
+// Connect frame receive function lookup
+// Commands without a frame receive function are given the frame a byte at a time
+void *Connect_receiveFrameFunctions[] = {
+	0, // CableCheck
+	0, // IdRequest
+	0, // IdEnumeration
+	0, // IdReport
+	Connect_receiveFrame_ScanCode,
+	0, // Animation
+	Connect_receiveFrame_RemoteCapability,
+};
+
+// Processes a complete, CRC validated frame
+// frame[0] is the command, followed by the arguments
+void Connect_receive_Frame( uint8_t *frame, uint8_t length, uint8_t uart_num )
+{
+	uint8_t command = frame[0];
+
+	// Invalid packet type, drop
+	if ( command >= sizeof( Connect_receiveFunctions ) / sizeof( void* ) )
+	{
+		Connect_framesDropped[ uart_num ]++;
+		return;
+	}
+
+	if ( Connect_debug )
+	{
+		print(" FRAME ");
+		printHex( command );
+		print(" ");
+		printHex( length );
+	}
+
+	// Whole frame receive function
+	uint8_t (*frameFunc)(uint8_t*, uint8_t, uint8_t) = (uint8_t(*)(uint8_t*, uint8_t, uint8_t))(Connect_receiveFrameFunctions[ command ]);
+	if ( frameFunc )
+	{
+		if ( !frameFunc( &frame[1], length - 1, uart_num ) )
+		{
+			Connect_framesDropped[ uart_num ]++;
+			return;
+		}
+	}
+	// Otherwise use the byte receive function
+	else
+	{
+		uint16_t pending_bytes = 0xFFFF;
+		uint8_t (*rcvFunc)(uint8_t, uint16_t(*), uint8_t) = (uint8_t(*)(uint8_t, uint16_t(*), uint8_t))(Connect_receiveFunctions[ command ]);
+
+		// Commands without arguments (e.g. IdRequest) are only called once
+		if ( length == 1 )
+		{
+			rcvFunc( 0, &pending_bytes, uart_num );
+		}
+		else for ( uint8_t byte = 1; byte < length; byte++ )
+		{
+			if ( rcvFunc( frame[ byte ], &pending_bytes, uart_num ) )
+				break;
+		}
+	}
+
+	Connect_framesReceived[ uart_num ]++;
+}
+
+
 
 // ----- Functions -----
 
@@ -863,14 +1291,25 @@ void Connect_reset()
 	// Reset Rx
 	memset( (void*)uart_rx_status, 0, sizeof( UARTStatusRx ) * UART_Num_Interfaces );
 
-	// Reset Tx
-	memset( (void*)uart_tx_buf,    0, sizeof( UARTRingBuf )  * UART_Num_Interfaces );
+	// Reset Tx, stopping any active Tx DMA transfers first
+	__disable_irq();
+	if ( uarts_configured )
+	{
+		DMA_CERQ = 2;
+		DMA_CERQ = 3;
+		DMA_CINT = 2;
+		DMA_CINT = 3;
+	}
+	memset( (void*)uart_tx_queue,  0, sizeof( uart_tx_queue ) );
 	memset( (void*)uart_tx_status, 0, sizeof( UARTStatusTx ) * UART_Num_Interfaces );
+	__enable_irq();
 
 	// Set Rx/Tx buffers as ready
 	for ( uint8_t inter = 0; inter < UART_Num_Interfaces; inter++ )
 	{
 		uart_tx_status[ inter ].status = UARTStatus_Ready;
+		uart_tx_queue[ inter ][ UARTTxPriority_High ].mergeId = 0xFF;
+		uart_tx_queue[ inter ][ UARTTxPriority_Low ].mergeId = 0xFF;
 		uart_rx_buf[ inter ].last_read = UART_Buffer_Size;
 	}
 }
@@ -931,25 +1370,32 @@ void Connect_setup( uint8_t master )
 	// Start with channels disabled first
 	DMAMUX0_CHCFG0 = 0;
 	DMAMUX0_CHCFG1 = 0;
+	DMAMUX0_CHCFG2 = 0;
+	DMAMUX0_CHCFG3 = 0;
 
 	// Configure DMA channels
 	//DMA_DSR_BCR0 |= DMA_DSR_BCR_DONE_MASK; // TODO What's this?
 	DMA_TCD0_CSR = 0;
 	DMA_TCD1_CSR = 0;
+	DMA_TCD2_CSR = 0;
+	DMA_TCD3_CSR = 0;
 
 	// Default control register
 	DMA_CR = 0;
 
 	// DMA Priority
-	DMA_DCHPRI0 = 0; // Ch 0, priority 0
-	DMA_DCHPRI1 = 1; // ch 1, priority 1
+	// Rx must win, a late Rx byte is lost while a late Tx byte just waits
+	DMA_DCHPRI0 = 2; // Ch 0, priority 2
+	DMA_DCHPRI1 = 3; // Ch 1, priority 3
+	DMA_DCHPRI2 = 0; // Ch 2, priority 0
+	DMA_DCHPRI3 = 1; // Ch 3, priority 1
 
 	// Clear error interrupts
 	DMA_EEI = 0;
 
 	// Setup TCD
-	DMA_TCD0_SADDR = (uint32_t*)&UART0_D;
-	DMA_TCD1_SADDR = (uint32_t*)&UART1_D;
+	Connect_dmaAddr( DMA_TCD0_SADDR, &UART0_D );
+	Connect_dmaAddr( DMA_TCD1_SADDR, &UART1_D );
 	DMA_TCD0_SOFF = 0;
 	DMA_TCD1_SOFF = 0;
 
@@ -966,8 +1412,8 @@ void Connect_setup( uint8_t master )
 	DMA_TCD1_SLAST = 0;
 
 	// Destination buffer
-	DMA_TCD0_DADDR = (uint32_t*)uart_rx_buf[0].buffer;
-	DMA_TCD1_DADDR = (uint32_t*)uart_rx_buf[1].buffer;
+	Connect_dmaAddr( DMA_TCD0_DADDR, uart_rx_buf[0].buffer );
+	Connect_dmaAddr( DMA_TCD1_DADDR, uart_rx_buf[1].buffer );
 
 	// Incoming byte, increment by 1 in the rx buffer
 	DMA_TCD0_DOFF = 1;
@@ -986,21 +1432,42 @@ void Connect_setup( uint8_t master )
 	// Enable DMA channels
 	DMA_ERQ |= DMA_ERQ_ERQ0 | DMA_ERQ_ERQ1;
 
+	// Tx DMA channels
+	// Source address and count are set for each transfer (see Connect_tx_start)
+	DMA_TCD2_ATTR = DMA_TCD_ATTR_SMOD(0) | DMA_TCD_ATTR_SSIZE(0) | DMA_TCD_ATTR_DMOD(0) | DMA_TCD_ATTR_DSIZE(0);
+	DMA_TCD3_ATTR = DMA_TCD_ATTR_SMOD(0) | DMA_TCD_ATTR_SSIZE(0) | DMA_TCD_ATTR_DMOD(0) | DMA_TCD_ATTR_DSIZE(0);
+	DMA_TCD2_NBYTES_MLNO = 1;
+	DMA_TCD3_NBYTES_MLNO = 1;
+	DMA_TCD2_SOFF = 1;
+	DMA_TCD3_SOFF = 1;
+	DMA_TCD2_SLAST = 0;
+	DMA_TCD3_SLAST = 0;
+	Connect_dmaAddr( DMA_TCD2_DADDR, &UART0_D );
+	Connect_dmaAddr( DMA_TCD3_DADDR, &UART1_D );
+	DMA_TCD2_DOFF = 0;
+	DMA_TCD3_DOFF = 0;
+	DMA_TCD2_DLASTSGA = 0;
+	DMA_TCD3_DLASTSGA = 0;
+
 	// Setup DMA channel routing
 	DMAMUX0_CHCFG0 = DMAMUX_ENABLE | DMAMUX_SOURCE_UART0_RX;
 	DMAMUX0_CHCFG1 = DMAMUX_ENABLE | DMAMUX_SOURCE_UART1_RX;
+	DMAMUX0_CHCFG2 = DMAMUX_ENABLE | DMAMUX_SOURCE_UART0_TX;
+	DMAMUX0_CHCFG3 = DMAMUX_ENABLE | DMAMUX_SOURCE_UART1_TX;
 
-	// Enable DMA requests (requires Rx interrupts)
-	UART0_C5 = UART_C5_RDMAS;
-	UART1_C5 = UART_C5_RDMAS;
+	// Enable DMA requests (requires Rx/Tx interrupts)
+	UART0_C5 = UART_C5_RDMAS | UART_C5_TDMAS;
+	UART1_C5 = UART_C5_RDMAS | UART_C5_TDMAS;
 
-	// TX Enabled, RX Enabled, RX Interrupt Enabled
-	UART0_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE;
-	UART1_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE;
+	// TX Enabled, RX Enabled, RX/TX Interrupt Enabled
+	UART0_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE | UART_C2_TIE;
+	UART1_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE | UART_C2_TIE;
 
 	// Add interrupts to the vector table
 	NVIC_ENABLE_IRQ( IRQ_UART0_STATUS );
 	NVIC_ENABLE_IRQ( IRQ_UART1_STATUS );
+	NVIC_ENABLE_IRQ( IRQ_DMA_CH2 );
+	NVIC_ENABLE_IRQ( IRQ_DMA_CH3 );
 
 	// UARTs are now ready to go
 	uarts_configured = 1;
@@ -1010,6 +1477,54 @@ void Connect_setup( uint8_t master )
 }
 
 
+// Validates and processes a frame once it is completely in the Rx DMA buffer
+// Returns 0 if still waiting for the rest of the frame
+uint8_t Connect_rx_frame( uint8_t uartNum, uint16_t bufpos )
+{
+	uint8_t length = uart_rx_status[ uartNum ].bytes_waiting;
+
+	// Both the DMA position and last_read count down from the buffer size
+	uint16_t read  = ( UART_Buffer_Size - uart_rx_buf[ uartNum ].last_read ) % UART_Buffer_Size;
+	uint16_t write = ( UART_Buffer_Size - bufpos ) % UART_Buffer_Size;
+	uint16_t available = ( write + UART_Buffer_Size - read ) % UART_Buffer_Size;
+
+	// Frame contents + CRC-16
+	if ( available < length + 2 )
+		return 0;
+
+	// Copy frame out of the Rx DMA buffer
+	uint8_t frame[ UART_Frame_MaxLength + 2 ];
+	for ( uint8_t byte = 0; byte < length + 2; byte++ )
+	{
+		frame[ byte ] = uart_rx_buf[ uartNum ].buffer[ ( read + byte ) % UART_Buffer_Size ];
+	}
+	uart_rx_buf[ uartNum ].last_read = UART_Buffer_Size - ( read + length + 2 ) % UART_Buffer_Size;
+	uart_rx_status[ uartNum ].status = UARTStatus_Wait;
+
+	// Validate CRC, covers the length and frame contents
+	uint16_t crc = Connect_crc16( 0xFFFF, &length, 1 );
+	crc = Connect_crc16( crc, frame, length );
+	if ( crc != ( frame[ length ] | ( frame[ length + 1 ] << 8 ) ) )
+	{
+		warn_msg("Corrupt frame on ");
+		print( uartNum == UART_Slave ? "Slave" : "Master" );
+		print( NL );
+
+		// Cable is not reliable until the next successful cable check
+		if ( uartNum == UART_Slave )
+			Connect_cableOkSlave = 0;
+		else
+			Connect_cableOkMaster = 0;
+
+		Connect_framesCorrupt[ uartNum ]++;
+		return 1;
+	}
+
+	Connect_receive_Frame( frame, length, uartNum );
+	return 1;
+}
+
+
 #define DMA_BUF_POS( x, pos ) \
 	case x: \
 		pos = DMA_TCD##x##_CITER_ELINKNO; \
@@ -1038,6 +1553,14 @@ void Connect_rx_process( uint8_t uartNum )
 				break;
 		}
 
+		// Frames are processed all at once, after all of the frame has been received
+		if ( uart_rx_status[ uartNum ].status == UARTStatus_Frame )
+		{
+			if ( !Connect_rx_frame( uartNum, bufpos ) )
+				break;
+			continue;
+		}
+
 		// Read the byte out of Rx DMA buffer
 		uint8_t byte = uart_rx_buf[ uartNum ].buffer[ UART_Buffer_Size - uart_rx_buf[ uartNum ].last_read-- ];
 
@@ -1065,7 +1588,39 @@ void Connect_rx_process( uint8_t uartNum )
 			{
 				print(" SYN ");
 			}
-			uart_rx_status[ uartNum ].status = byte == 0x01 ? UARTStatus_SOH : UARTStatus_Wait;
+			switch ( byte )
+			{
+			case 0x01: // SOH
+				uart_rx_status[ uartNum ].status = UARTStatus_SOH;
+				break;
+
+			case 0x02: // STX
+				uart_rx_status[ uartNum ].status = UARTStatus_STX;
+				break;
+
+			default:
+				uart_rx_status[ uartNum ].status = UARTStatus_Wait;
+				break;
+			}
+			break;
+
+		// After a STX, the length of the frame (command + arguments)
+		case UARTStatus_STX:
+			if ( Connect_debug )
+			{
+				print(" STX ");
+			}
+
+			// Frame must fit into the Rx buffer
+			if ( byte == 0 || byte > UART_Frame_MaxLength )
+			{
+				Connect_framesDropped[ uartNum ]++;
+				uart_rx_status[ uartNum ].status = UARTStatus_Wait;
+				break;
+			}
+
+			uart_rx_status[ uartNum ].status = UARTStatus_Frame;
+			uart_rx_status[ uartNum ].bytes_waiting = byte;
 			break;
 
 		// After a SOH the packet structure may diverge a bit
@@ -1186,12 +1741,12 @@ void Connect_scan()
 	// Only process commands if uarts have been configured
 	if ( uarts_configured )
 	{
-		// Check if Tx Buffers are empty and the Tx Ring buffers have data to send
-		// This happens if there was previously nothing to send
-		if ( uart_tx_buf[ 0 ].items > 0 && UART0_TCFIFO == 0 )
-			uart_fillTxFifo( 0 );
-		if ( uart_tx_buf[ 1 ].items > 0 && UART1_TCFIFO == 0 )
-			uart_fillTxFifo( 1 );
+		// Start Tx DMA if there is queued data and nothing is being sent
+		// Normally started when queueing, this also covers data queued before the UARTs were configured
+		__disable_irq();
+		Connect_tx_start( 0 );
+		Connect_tx_start( 1 );
+		__enable_irq();
 
 		// Process Rx Buffers
 		Connect_rx_process( 0 );
@@ -1377,19 +1932,140 @@ void cliFunc_connectSts( char* args )
 	printHex32( Connect_cableFaultsMaster );
 	print("/");
 	printHex32( Connect_cableChecksMaster );
+	print( NL "\tFrames:\t");
+	printHex32( Connect_framesReceived[UART_Master] );
+	print(" Corrupt ");
+	printHex32( Connect_framesCorrupt[UART_Master] );
+	print(" Dropped ");
+	printHex32( Connect_framesDropped[UART_Master] );
 	print( NL "\tRx:\t");
 	printHex( uart_rx_status[UART_Master].status );
 	print( NL "\tTx:\t");
 	printHex( uart_tx_status[UART_Master].status );
+	print( NL "\tQueued:\t");
+	printHex32( Connect_txPackets[UART_Master][UARTTxPriority_High] );
+	print("/");
+	printHex32( Connect_txPackets[UART_Master][UARTTxPriority_Low] );
+	print(" Dropped ");
+	printHex32( Connect_txDropped[UART_Master][UARTTxPriority_High] );
+	print("/");
+	printHex32( Connect_txDropped[UART_Master][UARTTxPriority_Low] );
+	print(" Merged ");
+	printHex32( Connect_txMerged[UART_Master] );
 	print( NL "Slave <=" NL "\tStatus:\t");
 	printHex( Connect_cableOkSlave );
 	print( NL "\tFaults:\t");
 	printHex32( Connect_cableFaultsSlave );
 	print("/");
 	printHex32( Connect_cableChecksSlave );
+	print( NL "\tFrames:\t");
+	printHex32( Connect_framesReceived[UART_Slave] );
+	print(" Corrupt ");
+	printHex32( Connect_framesCorrupt[UART_Slave] );
+	print(" Dropped ");
+	printHex32( Connect_framesDropped[UART_Slave] );
 	print( NL "\tRx:\t");
 	printHex( uart_rx_status[UART_Slave].status );
 	print( NL "\tTx:\t");
 	printHex( uart_tx_status[UART_Slave].status );
+	print( NL "\tQueued:\t");
+	printHex32( Connect_txPackets[UART_Slave][UARTTxPriority_High] );
+	print("/");
+	printHex32( Connect_txPackets[UART_Slave][UARTTxPriority_Low] );
+	print(" Dropped ");
+	printHex32( Connect_txDropped[UART_Slave][UARTTxPriority_High] );
+	print("/");
+	printHex32( Connect_txDropped[UART_Slave][UARTTxPriority_Low] );
+	print(" Merged ");
+	printHex32( Connect_txMerged[UART_Slave] );
+}
+
+#if defined(_host_)
+void cliFunc_connectLpb( char* args )
+{
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Number of bursts
+	unsigned int bursts = arg1Ptr[0] == '\0' ? 100 : numToInt( arg1Ptr );
+
+	print( NL );
+	if ( !Connect_master || !uarts_configured )
+	{
+		warn_msg("Only a configured master can check the loopback");
+		return;
+	}
+
+	uint32_t merged  = Connect_txMerged[ UART_Master ];
+	uint32_t dropped = Connect_txDropped[ UART_Master ][ UARTTxPriority_High ];
+	uint32_t corrupt = Connect_framesCorrupt[ UART_Slave ] + Connect_framesDropped[ UART_Slave ];
+	uint32_t packets = 0;
+
+	Connect_loopSent     = 0;
+	Connect_loopReceived = 0;
+	Connect_loopErrors   = 0;
+	Connect_loopActive   = 1;
+	Host_uartLoop[ UART_Master ] = UART_Slave;
+
+	for ( unsigned int burst = 0; burst < bursts; burst++ )
+	{
+		// The first packet starts sending right away, the others are merged into the next one (up to 36 guides)
+		for ( uint8_t packet = 0; packet < 1 + burst % 12; packet++ )
+		{
+			TriggerGuide guides[3];
+			uint8_t count = 1 + ( burst + packet ) % 3;
+			for ( uint8_t guide = 0; guide < count; guide++ )
+			{
+				guides[ guide ].type     = 0;
+				guides[ guide ].state    = 1 + Connect_loopSent % 3;
+				guides[ guide ].scanCode = (uint8_t)Connect_loopSent;
+				Connect_loopSent++;
+			}
+			Connect_send_ScanCode( 1, guides, count );
+			packets++;
+		}
+
+		// Complete the Tx DMA transfers, processing the looped bytes before the Rx ring fills up
+		uint16_t sent;
+		do {
+			__disable_irq();
+			sent = Host_uartDeliver( UART_Buffer_Size / 4 );
+			__enable_irq();
+			Connect_rx_process( UART_Slave );
+		} while ( sent > 0 );
+	}
+
+	Host_uartLoop[ UART_Master ] = -1;
+	Connect_loopActive = 0;
+
+	merged  = Connect_txMerged[ UART_Master ] - merged;
+	dropped = Connect_txDropped[ UART_Master ][ UARTTxPriority_High ] - dropped;
+	corrupt = Connect_framesCorrupt[ UART_Slave ] + Connect_framesDropped[ UART_Slave ] - corrupt;
+
+	info_msg("Loopback: ");
+	printInt32( packets );
+	print(" packets, ");
+	printInt32( merged );
+	print(" merged, ");
+	printInt32( dropped );
+	print(" dropped, ");
+	printInt32( corrupt );
+	print(" bad frames");
+	print( NL );
+	info_msg("Guides:   ");
+	printInt32( Connect_loopSent );
+	print(" sent, ");
+	printInt32( Connect_loopReceived );
+	print(" received, ");
+	printInt32( Connect_loopErrors );
+	print(" out of order");
+	print( NL );
+
+	if ( Connect_loopReceived == Connect_loopSent && Connect_loopErrors == 0 && dropped == 0 && corrupt == 0 )
+		info_print("Loopback passed");
+	else
+		erro_print("Loopback failed");
 }
+#endif
 
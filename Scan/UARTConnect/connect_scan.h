@@ -51,6 +51,8 @@ typedef enum UARTStatus {
 	UARTStatus_SOH     = 2, // Rx: SOH Received, waiting for Command
 	UARTStatus_Command = 3, // Rx: Command Received, waiting for data
 	UARTStatus_Ready   = 4, // Tx: Ready to send commands
+	UARTStatus_STX     = 5, // Rx: STX Received, waiting for frame length
+	UARTStatus_Frame   = 6, // Rx: Frame length received, waiting for the rest of the frame
 } UARTStatus;
 
 
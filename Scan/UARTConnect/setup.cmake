@@ -26,5 +26,6 @@ set ( Module_SRCS
 #
 set ( ModuleCompatibility
 	arm
+	host
 )
 
@@ -0,0 +1,122 @@
+/* Copyright (C) 2026 by agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Decodes the output of the trace command
+// Usage: trace-decode [capture file], reads stdin if no file is given
+// Records are lines of the form @<time:8><id:2><arg0:2><arg1:4> (hex), everything else is ignored.
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// ----- Variables -----
+
+// Event names and messages, in TraceEventId order
+static const struct {
+	const char *name;
+	const char *message;
+} events[] = {
+#define TraceEvent( name, message ) { #name, message },
+#include "trace_events.h"
+#undef TraceEvent
+};
+
+#define EventsNum ( sizeof( events ) / sizeof( events[0] ) )
+
+
+
+// ----- Functions -----
+
+// Parses len hex digits, returns -1 if any is invalid
+static long parseHex( const char *str, int len )
+{
+	long value = 0;
+	for ( int pos = 0; pos < len; pos++ )
+	{
+		char c = str[ pos ];
+		int digit;
+		if ( c >= '0' && c <= '9' )
+			digit = c - '0';
+		else if ( c >= 'A' && c <= 'F' )
+			digit = c - 'A' + 10;
+		else if ( c >= 'a' && c <= 'f' )
+			digit = c - 'a' + 10;
+		else
+			return -1;
+		value = ( value << 4 ) | digit;
+	}
+	return value;
+}
+
+
+int main( int argc, char **argv )
+{
+	FILE *in = stdin;
+	if ( argc > 1 && !( in = fopen( argv[1], "r" ) ) )
+	{
+		perror( argv[1] );
+		return 1;
+	}
+
+	char line[256];
+	unsigned long prevTime = 0;
+	int records = 0;
+	while ( fgets( line, sizeof( line ), in ) )
+	{
+		// Find the record, the line may start with escape codes
+		char *record = strchr( line, '@' );
+		if ( !record || strlen( record + 1 ) < 16 )
+			continue;
+
+		long time = parseHex( record + 1, 8 );
+		long id   = parseHex( record + 9, 2 );
+		long arg0 = parseHex( record + 11, 2 );
+		long arg1 = parseHex( record + 13, 4 );
+		if ( time < 0 || id < 0 || arg0 < 0 || arg1 < 0 )
+			continue;
+
+		// Time in ms, and the time since the previous record
+		printf( "%10lu ms (+%5lu) ", (unsigned long)time, records ? (unsigned long)time - prevTime : 0 );
+		prevTime = time;
+		records++;
+
+		if ( (unsigned long)id >= EventsNum )
+		{
+			printf( "Unknown event 0x%02lX: 0x%02lX 0x%04lX\n", id, arg0, arg1 );
+			continue;
+		}
+
+		printf( "%-20s ", events[ id ].name );
+		printf( events[ id ].message, (unsigned int)arg0, (unsigned int)arg1 );
+		printf( "\n" );
+	}
+
+	if ( in != stdin )
+		fclose( in );
+
+	return 0;
+}
+
@@ -31,7 +31,19 @@
 
 #include <cli.h>
 #include <led.h>
+#include <perf.h>
 #include <print.h>
+#include <trace.h>
+
+
+
+// ----- Variables -----
+
+#if defined(Perf_Enabled)
+// Main loop stages, see the perf command
+PerfCounter Main_perf[4];
+const char *const Main_perfLabels[] = { "CLI", "Scan", "Macro", "Output" };
+#endif
 
 
 
@@ -48,6 +60,15 @@ int main()
 	// Enable CLI
 	CLI_init();
 
+	// Enable profiling, modules may register counters during setup
+	Perf_setup();
+#if defined(Perf_Enabled)
+	Perf_registerGroup( "Main Loop", Main_perfLabels, Main_perf, 4 );
+#endif
+
+	// Enable binary trace log
+	Trace_setup();
+
 	// Setup Modules
 	Output_setup();
 	Macro_setup();
@@ -56,20 +77,29 @@ int main()
 	// Main Detection Loop
 	while ( 1 )
 	{
+		Perf_start( cycles );
+
 		// Process CLI
 		CLI_process();
+		Perf_lap( &Main_perf[0], cycles );
 
 		// Acquire Key Indices
 		// Loop continuously until scan_loop returns 0
 		cli();
 		while ( Scan_loop() );
 		sei();
+		Perf_lap( &Main_perf[1], cycles );
 
 		// Run Macros over Key Indices and convert to USB Keys
 		Macro_process();
+		Perf_lap( &Main_perf[2], cycles );
 
 		// Sends USB data only if changed
 		Output_send();
+		Perf_stop( &Main_perf[3], cycles );
+
+		// Hand buffered debug output to the Output Module
+		printFlush();
 	}
 }
 